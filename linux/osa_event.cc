@@ -0,0 +1,634 @@
+#include "osa.h"
+#include "errno.h"
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <sched.h>
+#include <pthread.h>
+
+/********************************************************
+*			E V E N T    L O O P
+*********************************************************/
+
+/* The loop which is running in the current thread. Used to skip the eventfd wake up when a callback queues packets on
+   a socket of its own loop (the flush happens before runOnce returns anyway) */
+static thread_local osa_eventLoop * o_curLoop = NULL;
+
+osa_eventLoop :: osa_eventLoop()
+{
+	epFd = -1;
+	wakeFd = -1;
+	isAlive = 0;
+	stopReq.store(0, std::memory_order_relaxed);
+	backend = OSA_EVLOOP_EPOLL;
+	uring = NULL;
+	socks = NULL;
+	socksNext = NULL;
+	pendOverflow.store(0, std::memory_order_relaxed);
+	curSock = NULL;
+	curEvents = NULL;
+	curNext = curNum = 0;
+}
+
+osa_eventLoop :: ~osa_eventLoop()
+{
+	destroy();
+}
+
+ret_e osa_eventLoop :: create(osa_evLoopBackend_e backend)
+{
+	char * func = "osa_eventLoop::create";
+	struct epoll_event ev;
+
+	if(1 == isAlive)
+	{
+		osa_loge("%s:error: loop %p is already created", func, this);
+		return OSA_ERR_BADPARAM;
+	}
+
+	if(OSA_SUCCESS != pendQ.create(OSA_EVLOOP_PEND_Q_SIZE))
+	{
+		osa_loge("%s:error: pending queue could not be created", func);
+		return OSA_ERR_INSUFFMEM;
+	}
+
+	wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(-1 == wakeFd)
+	{
+		osa_loge("%s:error: eventfd failed. errno=%s (%d)", func, strerror(errno), errno);
+		pendQ.destroy();
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	this->backend = backend;
+	if(OSA_EVLOOP_IOURING == backend)
+	{
+		if(OSA_SUCCESS != uringCreate())
+		{
+			::close(wakeFd);
+			wakeFd = -1;
+			pendQ.destroy();
+			return OSA_ERR_COREFUNCFAIL;
+		}
+
+		stopReq.store(0, std::memory_order_relaxed);
+		pendOverflow.store(0, std::memory_order_relaxed);
+		isAlive = 1;
+
+		osa_logi("%s: loop %p created (io_uring). wakeFd=%d", func, this, wakeFd);
+		return OSA_SUCCESS;
+	}
+
+	epFd = epoll_create1(EPOLL_CLOEXEC);
+	if(-1 == epFd)
+	{
+		osa_loge("%s:error: epoll_create1 failed. errno=%s (%d)", func, strerror(errno), errno);
+		::close(wakeFd);
+		wakeFd = -1;
+		pendQ.destroy();
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	/* Sockets carry their osa_socket pointer, the wake up fd carries NULL */
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLET;
+	ev.data.ptr = NULL;
+	if(0 != epoll_ctl(epFd, EPOLL_CTL_ADD, wakeFd, &ev))
+	{
+		osa_loge("%s:error: epoll_ctl(wakeFd) failed. errno=%s (%d)", func, strerror(errno), errno);
+		::close(wakeFd);
+		::close(epFd);
+		wakeFd = epFd = -1;
+		pendQ.destroy();
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	stopReq.store(0, std::memory_order_relaxed);
+	pendOverflow.store(0, std::memory_order_relaxed);
+	isAlive = 1;
+
+	osa_logi("%s: loop %p created. epFd=%d, wakeFd=%d", func, this, epFd, wakeFd);
+	return OSA_SUCCESS;
+}
+
+ret_e osa_eventLoop :: destroy()
+{
+	if(1 == isAlive)
+	{
+		if(OSA_EVLOOP_IOURING == backend)
+			uringDestroy();
+		else
+			::close(epFd);
+
+		/* Nothing of the loop may be left in the sockets: their destroy() would call remove() on a dead loop */
+		while(NULL != socks)
+		{
+			osa_socket *sock = socks;
+
+			socks = sock->evNext;
+			sock->evPrev = sock->evNext = NULL;
+			sock->evLoop = NULL;
+			sock->ioCtx = NULL;
+			sock->txScheduled.store(0, std::memory_order_relaxed);
+			sock->dropSendQ(0);
+		}
+
+		::close(wakeFd);
+		wakeFd = epFd = -1;
+		pendQ.destroy();
+		isAlive = 0;
+		osa_logi("osa_eventLoop::destroy: loop %p destroyed", this);
+	}
+
+	return OSA_SUCCESS;
+}
+
+osa_evLoopBackend_e osa_eventLoop :: getBackend()
+{
+	return backend;
+}
+
+ret_e osa_eventLoop :: add(osa_socket &sock)
+{
+	char * func = "osa_eventLoop::add";
+	struct epoll_event ev;
+
+	if(1 != isAlive || 1 != sock.isAsync || NULL != sock.evLoop)
+	{
+		osa_loge("%s:error: loop %p (isAlive=%d), sockFd=%d (isAsync=%d, evLoop=%p). Socket must be asynchronous and not in"
+			" a loop already", func, this, isAlive, sock.sockFd, sock.isAsync, sock.evLoop);
+		return OSA_ERR_BADPARAM;
+	}
+
+	sock.evLoop = this;
+	if(OSA_EVLOOP_IOURING == backend)
+	{
+		if(OSA_SUCCESS != uringAdd(sock))
+		{
+			sock.evLoop = NULL;
+			return OSA_ERR_COREFUNCFAIL;
+		}
+		link(sock);
+
+		/* Packets queued before the socket was added */
+		if(0 < sock.sockQ.curSize())
+			scheduleFlush(sock);
+
+		osa_logd("%s: loop %p, sockFd=%d added", func, this, sock.sockFd);
+		return OSA_SUCCESS;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	ev.data.ptr = &sock;
+
+	if(0 != epoll_ctl(epFd, EPOLL_CTL_ADD, sock.sockFd, &ev))
+	{
+		osa_loge("%s:error: epoll_ctl ADD failed. sockFd=%d, errno=%s (%d)", func, sock.sockFd, strerror(errno), errno);
+		sock.evLoop = NULL;
+		return OSA_ERR_COREFUNCFAIL;
+	}
+	link(sock);
+
+	/* Packets queued before the socket was added are sent on the first EPOLLOUT, which edge triggered epoll reports
+	   right after ADD for a writable socket */
+	osa_logd("%s: loop %p, sockFd=%d added", func, this, sock.sockFd);
+	return OSA_SUCCESS;
+}
+
+/* link/unlink : Keep the list of the sockets in the loop, so that destroy() can detach them */
+void osa_eventLoop :: link(osa_socket &sock)
+{
+	sock.evPrev = NULL;
+	sock.evNext = socks;
+	if(NULL != socks)
+		socks->evPrev = &sock;
+	socks = &sock;
+}
+
+void osa_eventLoop :: unlink(osa_socket &sock)
+{
+	if(NULL != sock.evPrev)
+		sock.evPrev->evNext = sock.evNext;
+	else
+		socks = sock.evNext;
+	if(NULL != sock.evNext)
+		sock.evNext->evPrev = sock.evPrev;
+	if(&sock == socksNext)
+		socksNext = sock.evNext;
+	sock.evPrev = sock.evNext = NULL;
+}
+
+ret_e osa_eventLoop :: remove(osa_socket &sock)
+{
+	char * func = "osa_eventLoop::remove";
+	q_data_t qObj;
+	i32_t n;
+
+	if(this != sock.evLoop)
+	{
+		osa_loge("%s:error: sockFd=%d is not in loop %p", func, sock.sockFd, this);
+		return OSA_ERR_BADPARAM;
+	}
+
+	if(OSA_EVLOOP_IOURING == backend)
+	{
+		uringRemove(sock);
+	}
+	else if(0 != epoll_ctl(epFd, EPOLL_CTL_DEL, sock.sockFd, NULL))
+	{
+		osa_loge("%s:error: epoll_ctl DEL failed. sockFd=%d, errno=%s (%d)", func, sock.sockFd, strerror(errno), errno);
+	}
+
+	/* The socket may still be waiting in pendQ. Rotate the queue once and leave it out, so that the loop never touches
+	   it after this call returns */
+	if(0 != sock.txScheduled.load(std::memory_order_acquire))
+	{
+		n = pendQ.curSize();
+		while(0 < n-- && OSA_SUCCESS == pendQ.pop(qObj))
+		{
+			if(qObj.obj != (void *)&sock && OSA_SUCCESS != pendQ.push(qObj))
+				osa_loge("%s:error: pending queue overflow while removing sockFd=%d", func, sock.sockFd);
+		}
+		sock.txScheduled.store(0, std::memory_order_release);
+	}
+
+	/* Events of this socket not yet processed in the current batch */
+	if(&sock == curSock)
+		curSock = NULL;
+	for(i32_t i = curNext; i < curNum; i++)
+	{
+		if(curEvents[i].data.ptr == (void *)&sock)
+			curEvents[i].events = 0;
+	}
+
+	unlink(sock);
+	sock.evLoop = NULL;
+
+	osa_logd("%s: loop %p, sockFd=%d removed", func, this, sock.sockFd);
+	return OSA_SUCCESS;
+}
+
+/* scheduleFlush : Called by send/sendto (any thread) after a packet was queued on 'sock' */
+void osa_eventLoop :: scheduleFlush(osa_socket &sock)
+{
+	q_data_t qObj;
+	u64_t one = 1;
+
+	/* Already queued for a flush which hasn't started yet. It will pick this packet up too */
+	if(0 != sock.txScheduled.exchange(1, std::memory_order_acq_rel))
+		return;
+
+	qObj.obj = &sock;
+	qObj.size = sizeof(osa_socket *);
+	if(OSA_SUCCESS != pendQ.push(qObj))
+	{
+		/* txScheduled stays set. handlePending looks for such sockets in the whole loop. An edge triggered EPOLLOUT
+		   would never come for an idle socket */
+		osa_logd("osa_eventLoop::scheduleFlush: pending queue full. sockFd=%d is flushed in the next sweep", sock.sockFd);
+		pendOverflow.store(1, std::memory_order_release);
+	}
+
+	if(this != o_curLoop)
+	{
+		if(sizeof(one) != ::write(wakeFd, &one, sizeof(one)))
+			osa_loge("osa_eventLoop::scheduleFlush:error: eventfd write failed. errno=%s (%d)", strerror(errno), errno);
+	}
+}
+
+/* handlePending : Flush the sockets that got new packets from other threads.
+				   Sockets are taken out one by one: a callback called during a flush may remove any socket from the loop,
+				   and remove() can only purge what is still in pendQ */
+void osa_eventLoop :: handlePending()
+{
+	q_data_t qObj;
+
+	while(OSA_SUCCESS == pendQ.pop(qObj))
+	{
+		osa_socket *sock = (osa_socket *)qObj.obj;
+
+		/* Clear first: packets queued while we flush schedule the socket again */
+		sock->txScheduled.store(0, std::memory_order_release);
+		curSock = sock;
+		if(OSA_EVLOOP_IOURING == backend)
+			uringFlush(*sock);
+		else
+			sock->flushSendQ();
+		curSock = NULL;
+	}
+
+	if(0 == pendOverflow.exchange(0, std::memory_order_acq_rel))
+		return;
+
+	/* Some sockets didn't fit in pendQ. Flush every socket still marked. A flush may remove any socket: socksNext is
+	   moved on by unlink() */
+	for(osa_socket *sock = socks; NULL != sock; sock = socksNext)
+	{
+		socksNext = sock->evNext;
+		if(0 == sock->txScheduled.exchange(0, std::memory_order_acq_rel))
+			continue;
+
+		curSock = sock;
+		if(OSA_EVLOOP_IOURING == backend)
+			uringFlush(*sock);
+		else
+			sock->flushSendQ();
+		curSock = NULL;
+	}
+	socksNext = NULL;
+}
+
+/* isCurrent : false once the socket whose callbacks are running was removed from the loop (and maybe freed) by one of
+			   them. Lets socket code that calls several callbacks in a row stop without touching the socket */
+bool osa_eventLoop :: isCurrent(osa_socket &sock)
+{
+	return &sock == curSock;
+}
+
+/* o_sockErrPending : The socket has an error (or an unread error queue entry). Doesn't clear it, unlike SO_ERROR */
+static bool o_sockErrPending(int fd)
+{
+	struct pollfd pfd;
+
+	pfd.fd = fd;
+	pfd.events = 0;
+	pfd.revents = 0;
+	return 1 == ::poll(&pfd, 1, 0) && (pfd.revents & POLLERR);
+}
+
+ret_e osa_eventLoop :: runOnce(i32_t timeoutMs)
+{
+	char * func = "osa_eventLoop::runOnce";
+	struct epoll_event events[OSA_EVLOOP_MAX_EVENTS];
+	osa_eventLoop * prevLoop = o_curLoop;
+	ret_e ret;
+	int n, i;
+
+	if(1 != isAlive)
+	{
+		osa_loge("%s:error: loop %p is not created", func, this);
+		return OSA_ERR_BADPARAM;
+	}
+
+	if(OSA_EVLOOP_IOURING == backend)
+	{
+		o_curLoop = this;
+		ret = uringRunOnce(timeoutMs);
+		if(OSA_SUCCESS == ret)
+			handlePending();
+		o_curLoop = prevLoop;
+		return ret;
+	}
+
+	n = epoll_wait(epFd, events, OSA_EVLOOP_MAX_EVENTS, timeoutMs);
+	if(-1 == n)
+	{
+		if(EINTR == errno)
+			return OSA_SUCCESS;
+
+		osa_loge("%s:error: epoll_wait failed. errno=%s (%d)", func, strerror(errno), errno);
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	o_curLoop = this;
+	curEvents = events;
+	curNum = n;
+
+	for(i=0; i<n; i++)
+	{
+		osa_socket *sock = (osa_socket *)events[i].data.ptr;
+		u32_t ev = events[i].events;
+
+		curNext = i + 1;
+		if(NULL == sock)
+		{
+			u64_t cnt;
+			while(sizeof(cnt) == ::read(wakeFd, &cnt, sizeof(cnt)))
+				;
+			continue;
+		}
+
+		/* Socket was removed by a callback of an earlier event */
+		if(0 == ev)
+			continue;
+
+		/* After every callback the socket may be removed and freed. Then curSock is NULL */
+		curSock = sock;
+
+		/* Zero copy completions wait in the error queue and raise EPOLLERR. That alone is no reason to read. But a real
+		   error (RST, timeout) may come in the same edge: once the queue is read, poll tells if one is pending */
+		if((ev & EPOLLERR) && sock->zcSeq != sock->zcDone)
+		{
+			sock->zcReap();
+			if(sock == curSock && !o_sockErrPending(sock->sockFd))
+				ev &= ~EPOLLERR;
+		}
+
+		if(sock == curSock && (ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+			sock->onReadable();
+
+		if(sock == curSock && (ev & (EPOLLOUT | EPOLLHUP | EPOLLERR)))
+			sock->flushSendQ();
+	}
+
+	curSock = NULL;
+	curEvents = NULL;
+	curNext = curNum = 0;
+
+	handlePending();
+
+	o_curLoop = prevLoop;
+	return OSA_SUCCESS;
+}
+
+ret_e osa_eventLoop :: run()
+{
+	ret_e ret = OSA_SUCCESS;
+
+	osa_logi("osa_eventLoop::run: loop %p started", this);
+
+	while(0 == stopReq.load(std::memory_order_acquire))
+	{
+		ret = runOnce(-1);
+		if(OSA_SUCCESS != ret)
+			break;
+	}
+
+	stopReq.store(0, std::memory_order_relaxed);
+	osa_logi("osa_eventLoop::run: loop %p stopped", this);
+	return ret;
+}
+
+ret_e osa_eventLoop :: stop()
+{
+	u64_t one = 1;
+
+	if(1 != isAlive)
+		return OSA_ERR_BADPARAM;
+
+	stopReq.store(1, std::memory_order_release);
+	if(sizeof(one) != ::write(wakeFd, &one, sizeof(one)))
+	{
+		osa_loge("osa_eventLoop::stop:error: eventfd write failed. errno=%s (%d)", strerror(errno), errno);
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	return OSA_SUCCESS;
+}
+
+
+/********************************************************
+*		E V E N T    L O O P    G R O U P
+*********************************************************/
+
+osa_eventLoopGroup :: osa_eventLoopGroup()
+{
+	slots = NULL;
+	numLoops = 0;
+}
+
+osa_eventLoopGroup :: ~osa_eventLoopGroup()
+{
+	stop();
+}
+
+/* Listeners never send, but makeAsynchronous wants both callbacks */
+static void o_noSendCb(osa_socket &, void *)
+{
+}
+
+/* loopThread : Entry point of every loop thread. It is created pinned to its cpu and runs the loop till stop() */
+void * osa_eventLoopGroup :: loopThread(void * arg)
+{
+	osa_evLoopSlot_t *slot = (osa_evLoopSlot_t *)arg;
+
+	slot->loop.run();
+	return NULL;
+}
+
+ret_e osa_eventLoopGroup :: start(u32_t numLoops, osa_sockAddrIn_t &lAddr, i32_t maxCon, osa_recvReadyCb acceptCb, 
+	void * appData)
+{
+	char * func = "osa_eventLoopGroup::start";
+	osa_thread_priority_e prio = OSA_THREAD_PRIO_DEFAULT;
+	osa_sockErr_e sockErr;
+	osa_topology_t *topo;
+	osa_cpuSet_t cpus;
+	i32_t order[OSA_CPU_MAX];
+	i32_t numCpu = 0;
+	char thrName[16];
+	u32_t i;
+
+	if(NULL != slots || NULL == acceptCb)
+	{
+		osa_loge("%s:error: group %p already started (slots=%p) or acceptCb=%p is NULL", func, this, slots, acceptCb);
+		return OSA_ERR_BADPARAM;
+	}
+
+	/* One loop per core before any SMT sibling gets a second one. They share nothing, so keep them apart */
+	topo = new osa_topology_t;
+	if(OSA_SUCCESS == osa_topology_get(*topo))
+		numCpu = (i32_t)osa_topology_spread(*topo, order, OSA_CPU_MAX);
+	delete topo;
+	if(0 >= numCpu)
+	{
+		order[0] = 0;
+		numCpu = 1;
+	}
+	if(0 == numLoops)
+		numLoops = (u32_t)numCpu;
+
+	osa_logi("%s: entered. numLoops=%u, numCpu=%d, lAddr=%s:%d", func, numLoops, numCpu, lAddr.addr, lAddr.port);
+
+	slots = new osa_evLoopSlot_t[numLoops];
+	this->numLoops = numLoops;
+
+	for(i=0; i<numLoops; i++)
+	{
+		osa_evLoopSlot_t *slot = &slots[i];
+
+		slot->cpu = order[i % (u32_t)numCpu];
+		slot->thrAlive = 0;
+
+		if(OSA_SUCCESS != slot->loop.create()
+			|| OSA_SUCCESS != slot->listener.create(lAddr.domain, OSA_SOCK_STREAM, 0, sockErr)
+			|| OSA_SUCCESS != slot->listener.setReusePort(sockErr)
+			|| OSA_SUCCESS != slot->listener.bind(lAddr, sockErr)
+			|| OSA_SUCCESS != slot->listener.listen(maxCon, sockErr)
+			|| OSA_SUCCESS != slot->listener.makeAsynchronous(o_noSendCb, acceptCb, appData)
+			|| OSA_SUCCESS != slot->loop.add(slot->listener))
+		{
+			osa_loge("%s:error: loop %u could not be set up", func, i);
+			stop();
+			return OSA_ERR_COREFUNCFAIL;
+		}
+
+		snprintf(thrName, sizeof(thrName), "osa_loop%u", i % 100000);
+		osa_cpuSet_zero(cpus);
+		osa_cpuSet_add(cpus, slot->cpu);
+		if(OSA_SUCCESS != osa_thread_create(slot->thr, loopThread, prio, thrName, slot, NULL, &cpus))
+		{
+			osa_loge("%s: could not pin loop %u to cpu %d, but we will continue", func, i, slot->cpu);
+			slot->cpu = -1;
+		}
+		if(-1 == slot->cpu && OSA_SUCCESS != osa_thread_create(slot->thr, loopThread, prio, thrName, slot, NULL))
+		{
+			osa_loge("%s:error: thread for loop %u could not be created", func, i);
+			stop();
+			return OSA_ERR_COREFUNCFAIL;
+		}
+		slot->thrAlive = 1;
+	}
+
+	osa_logi("%s: %u loops running", func, numLoops);
+	return OSA_SUCCESS;
+}
+
+ret_e osa_eventLoopGroup :: stop()
+{
+	u32_t i;
+
+	if(NULL == slots)
+		return OSA_SUCCESS;
+
+	for(i=0; i<numLoops; i++)
+	{
+		if(1 == slots[i].thrAlive)
+			slots[i].loop.stop();
+	}
+
+	for(i=0; i<numLoops; i++)
+	{
+		if(1 == slots[i].thrAlive)
+		{
+			osa_thread_join(slots[i].thr, NULL);
+			slots[i].thrAlive = 0;
+		}
+
+		/* Detaches the accepted connections too, so none of them points into 'slots' once it is freed */
+		slots[i].listener.destroy();
+		slots[i].loop.destroy();
+	}
+
+	delete [] slots;
+	slots = NULL;
+	numLoops = 0;
+
+	osa_logi("osa_eventLoopGroup::stop: group %p stopped", this);
+	return OSA_SUCCESS;
+}
+
+u32_t osa_eventLoopGroup :: getNumLoops()
+{
+	return numLoops;
+}
+
+osa_eventLoop * osa_eventLoopGroup :: getLoop(u32_t idx)
+{
+	if(idx >= numLoops)
+		return NULL;
+
+	return &slots[idx].loop;
+}
@@ -0,0 +1,487 @@
+#include "osa.h"
+#include "osa_log_internal.h"
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
+#define O_LOG_RING_MASK		(OSA_LOG_RING_SZ - 1)
+
+/* Records of one thread. head is moved by the owner thread only, tail by the background thread only */
+typedef struct o_logRing_t
+{
+	std::atomic<u64_t> head;
+	u64_t tailCache; 					/* Owner's copy of tail. Reloaded only when the ring looks full */
+	std::atomic<int> busy; 				/* Owner is writing a record. osa_logAsyncStop waits for it */
+	char pad0[OSA_CACHELINE_SZ - sizeof(std::atomic<u64_t>) - sizeof(u64_t) - sizeof(std::atomic<int>)];
+	std::atomic<u64_t> tail;
+	char pad1[OSA_CACHELINE_SZ - sizeof(std::atomic<u64_t>)];
+	std::atomic<u32_t> dropped; 		/* Records lost because the ring was full. Reported and reset by the background thread */
+	std::atomic<int> isDead; 			/* Owner thread exited. The ring is freed once drained */
+	int tid;
+	struct o_logRing_t * next;
+	u8_t buf[OSA_LOG_RING_SZ];
+}o_logRing_t;
+
+/* Per thread logging state */
+typedef struct o_logTls_t
+{
+	o_logRing_t * ring;
+	o_logRing_t * curRing; 				/* Ring of the record being written. NULL: synchronous record in 'scratch' */
+	osa_logRec_t * cur;
+	u64_t curPos; 						/* Ring position of 'cur' */
+	int tid;
+	bool isGone; 						/* Thread is exiting. Log synchronously from here on */
+	u64_t scratch[OSA_LOG_REC_MAX / sizeof(u64_t)];
+
+	~o_logTls_t();
+}o_logTls_t;
+
+std::atomic<int> osa_logLevel(LOGLVL_ERROR);
+
+static thread_local o_logTls_t o_logTls;
+static std::atomic<int> o_logAsyncOn(0); 				/* Producers use the rings */
+static std::atomic<int> o_logRun(0); 					/* Background thread keeps running */
+static std::atomic<osa_fileHd_t *> o_logOut(NULL); 		/* File of the async backend */
+static pthread_mutex_t o_logRingsLock = PTHREAD_MUTEX_INITIALIZER;
+static o_logRing_t * o_logRings = NULL; 				/* New rings are added at the head */
+static int o_logThrAlive = 0; 							/* Background thread frees the dead rings. Under o_logRingsLock */
+static osa_threadHd_t o_logThr;
+static std::atomic<int> o_logFormat(OSA_LOG_TEXT); 		/* osa_logFormat_e of the async file */
+
+/* Formats of the call sites, indexed by id. Id 0 is given out when the table is full */
+static const char * o_logFmts[OSA_LOG_FMT_MAX] = { "osa_log: more than OSA_LOG_FMT_MAX formats. Message lost" };
+static u32_t o_logNumFmts = 1;
+static pthread_mutex_t o_logFmtsLock = PTHREAD_MUTEX_INITIALIZER;
+static bool o_logFmtSent[OSA_LOG_FMT_MAX]; 				/* OSA_LOG_BINARY: format already written to the file */
+static u64_t o_logPrevTs; 								/* OSA_LOG_BINARY: timestamp of the last record written */
+
+void osa_logSetLevel(int level)
+{
+	if(level < LOGLVL_ERROR)
+		level = LOGLVL_ERROR;
+	if(level > LOGLVL_VERBOSE)
+		level = LOGLVL_VERBOSE;
+
+	osa_logLevel.store(level, std::memory_order_relaxed);
+}
+
+int osa_logGetLevel()
+{
+	return osa_logLevel.load(std::memory_order_relaxed);
+}
+
+/* Synchronous records are text. They go to the async file only if it is a text log */
+static osa_fileHd_t * o_logSyncFile()
+{
+	osa_fileHd_t * out = o_logOut.load(std::memory_order_acquire);
+
+	return (NULL != out && OSA_LOG_TEXT == o_logFormat.load(std::memory_order_relaxed)) ? out : stdout;
+}
+
+static int o_logTid(o_logTls_t &tls)
+{
+	if(0 == tls.tid)
+		tls.tid = (int)syscall(SYS_gettid);
+	return tls.tid;
+}
+
+static u64_t o_logNow()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (u64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* A call site registers once (static initialization in the osa_log macro). That publishes o_logFmts[id] to every thread
+   that later uses the id */
+u32_t osa_logRegister(const char * fmt)
+{
+	u32_t id = 0;
+
+	pthread_mutex_lock(&o_logFmtsLock);
+	if(o_logNumFmts < OSA_LOG_FMT_MAX)
+	{
+		id = o_logNumFmts++;
+		o_logFmts[id] = fmt;
+	}
+	pthread_mutex_unlock(&o_logFmtsLock);
+
+	return id;
+}
+
+/* The ring of an exiting thread is freed by the background thread once drained, or right here if there is none */
+o_logTls_t :: ~o_logTls_t()
+{
+	isGone = true;
+	if(NULL == ring)
+		return;
+
+	pthread_mutex_lock(&o_logRingsLock);
+	if(0 != o_logThrAlive)
+	{
+		ring->isDead.store(1, std::memory_order_release);
+	}
+	else
+	{
+		o_logRing_t ** prev = &o_logRings;
+		while(*prev != ring)
+			prev = &(*prev)->next;
+		*prev = ring->next;
+		osa_free(ring);
+	}
+	pthread_mutex_unlock(&o_logRingsLock);
+	ring = NULL;
+}
+
+static o_logRing_t * o_logRingAttach(o_logTls_t &tls)
+{
+	o_logRing_t * ring = (o_logRing_t *)osa_calloc(sizeof(o_logRing_t));
+
+	if(NULL == ring)
+		return NULL;
+
+	ring->tid = o_logTid(tls);
+
+	pthread_mutex_lock(&o_logRingsLock);
+	ring->next = o_logRings;
+	o_logRings = ring;
+	pthread_mutex_unlock(&o_logRingsLock);
+
+	tls.ring = ring;
+	return ring;
+}
+
+u8_t * osa_logBegin(int level, u32_t fmtId, u8_t *&end)
+{
+	o_logTls_t &tls = o_logTls;
+	o_logRing_t * ring = NULL;
+	osa_logRec_t * rec;
+	u64_t head, pad = 0;
+	u32_t idx;
+
+	if(0 != o_logAsyncOn.load(std::memory_order_relaxed) && !tls.isGone)
+	{
+		ring = (NULL != tls.ring) ? tls.ring : o_logRingAttach(tls);
+
+		/* Pairs with osa_logAsyncStop: either it waits for this record, or we see async logging is off */
+		if(NULL != ring)
+		{
+			ring->busy.store(1, std::memory_order_seq_cst);
+			if(0 == o_logAsyncOn.load(std::memory_order_seq_cst))
+			{
+				ring->busy.store(0, std::memory_order_release);
+				ring = NULL;
+			}
+		}
+	}
+
+	if(NULL == ring)
+	{
+		rec = (osa_logRec_t *)tls.scratch;
+		end = (u8_t *)tls.scratch + OSA_LOG_REC_MAX;
+	}
+	else
+	{
+		/* A record never wraps. If the space left till the end of the buffer may be too small, it is padded */
+		head = ring->head.load(std::memory_order_relaxed);
+		idx = head & O_LOG_RING_MASK;
+		if(OSA_LOG_RING_SZ - idx < OSA_LOG_REC_MAX)
+			pad = OSA_LOG_RING_SZ - idx;
+
+		if(head + pad + OSA_LOG_REC_MAX - ring->tailCache > OSA_LOG_RING_SZ)
+		{
+			ring->tailCache = ring->tail.load(std::memory_order_acquire);
+			if(head + pad + OSA_LOG_REC_MAX - ring->tailCache > OSA_LOG_RING_SZ)
+			{
+				ring->dropped.fetch_add(1, std::memory_order_relaxed);
+				ring->busy.store(0, std::memory_order_release);
+				return NULL;
+			}
+		}
+
+		if(0 != pad)
+		{
+			rec = (osa_logRec_t *)(ring->buf + idx);
+			rec->size = pad;
+			rec->isPad = 1;
+			idx = 0;
+		}
+
+		rec = (osa_logRec_t *)(ring->buf + idx);
+		end = ring->buf + idx + OSA_LOG_REC_MAX;
+		tls.curPos = head + pad;
+	}
+
+	rec->level = level;
+	rec->isPad = 0;
+	rec->fmtId = (fmtId < OSA_LOG_FMT_MAX) ? fmtId : 0;
+	rec->tid = o_logTid(tls);
+	rec->ts = o_logNow();
+	tls.cur = rec;
+	tls.curRing = ring;
+
+	return (u8_t *)(rec + 1);
+}
+
+void osa_logEnd(u8_t * argEnd)
+{
+	o_logTls_t &tls = o_logTls;
+	osa_logRec_t * rec = tls.cur;
+	char line[OSA_LOG_LINE_SZ];
+	int len;
+
+	rec->argSz = argEnd - (u8_t *)(rec + 1);
+	rec->size = (sizeof(osa_logRec_t) + rec->argSz + 7) & ~7u;
+
+	if(NULL == tls.curRing)
+	{
+		len = osa_logLine(line, sizeof(line), rec, o_logFmts[rec->fmtId]);
+		fwrite(line, 1, len, o_logSyncFile());
+		return;
+	}
+
+	tls.curRing->head.store(tls.curPos + rec->size, std::memory_order_release);
+	tls.curRing->busy.store(0, std::memory_order_release);
+}
+
+void osa_logPrint(int level, const char * fmt, ...)
+{
+	static const u32_t fmtId = osa_logRegister("%s");
+	char msg[OSA_LOG_LINE_SZ];
+	u8_t * p, * end = NULL;
+	va_list ap;
+
+	if(level > osa_logLevel.load(std::memory_order_relaxed))
+		return;
+
+	va_start(ap, fmt);
+	vsnprintf(msg, sizeof(msg), fmt, ap);
+	va_end(ap);
+
+	p = osa_logBegin(level, fmtId, end);
+	if(NULL == p)
+		return;
+
+	osa_logArgStr(p, end, msg, sizeof(msg));
+	osa_logEnd(p);
+}
+
+/* o_logBinWrite : OSA_LOG_BINARY. Write the record, preceded by its format if the file does not have it yet */
+static void o_logBinWrite(osa_fileHd_t * out, const osa_logRec_t * rec)
+{
+	static u8_t buf[16 + OSA_LOGBIN_BODY_MAX];
+	const char * fmt = o_logFmts[rec->fmtId];
+	u8_t * p = buf;
+	u32_t len;
+
+	if(!o_logFmtSent[rec->fmtId])
+	{
+		len = strlen(fmt);
+		*p++ = OSA_LOGBIN_FMT;
+		osa_logVarPut(p, rec->fmtId);
+		osa_logVarPut(p, len);
+		fwrite(buf, 1, p - buf, out);
+		fwrite(fmt, 1, len, out);
+		o_logFmtSent[rec->fmtId] = true;
+		p = buf;
+	}
+
+	/* The body is encoded after room for its length, which takes at most 2 bytes */
+	len = osa_logBinEncode(buf + 4, rec, o_logPrevTs);
+	*p++ = OSA_LOGBIN_REC;
+	*p++ = rec->level;
+	osa_logVarPut(p, len);
+	if(p != buf + 4)
+		memmove(p, buf + 4, len);
+	fwrite(buf, 1, p - buf + len, out);
+}
+
+static void o_logDropWrite(osa_fileHd_t * out, i32_t tid, u32_t dropped)
+{
+	u8_t buf[16], * p = buf;
+
+	if(OSA_LOG_TEXT == o_logFormat.load(std::memory_order_relaxed))
+	{
+		fprintf(out, "osa_log: thread %d dropped %u records. Its ring buffer was full\n", tid, dropped);
+		return;
+	}
+
+	*p++ = OSA_LOGBIN_DROP;
+	osa_logVarPut(p, (u32_t)tid);
+	osa_logVarPut(p, dropped);
+	fwrite(buf, 1, p - buf, out);
+}
+
+/* o_logDrain : Write out the records of all the rings. Returns the number of records written.
+				Runs in the background thread only. The lock is not held while formatting, so threads logging for the
+				first time are not held up. Rings are added at the head only and only this thread removes them */
+static u32_t o_logDrain(osa_fileHd_t * out)
+{
+	char line[OSA_LOG_LINE_SZ];
+	o_logRing_t * ring, ** prev;
+	osa_logRec_t * rec;
+	u64_t head, tail;
+	u32_t count = 0, dropped;
+	int len;
+
+	pthread_mutex_lock(&o_logRingsLock);
+	ring = o_logRings;
+	pthread_mutex_unlock(&o_logRingsLock);
+
+	for(; NULL != ring; ring = ring->next)
+	{
+		head = ring->head.load(std::memory_order_acquire);
+		tail = ring->tail.load(std::memory_order_relaxed);
+
+		while(tail != head)
+		{
+			rec = (osa_logRec_t *)(ring->buf + (tail & O_LOG_RING_MASK));
+			if(!rec->isPad)
+			{
+				if(OSA_LOG_TEXT == o_logFormat.load(std::memory_order_relaxed))
+				{
+					len = osa_logLine(line, sizeof(line), rec, o_logFmts[rec->fmtId]);
+					fwrite(line, 1, len, out);
+				}
+				else
+				{
+					o_logBinWrite(out, rec);
+				}
+				count++;
+			}
+			tail += rec->size;
+		}
+		ring->tail.store(tail, std::memory_order_release);
+
+		dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+		if(0 != dropped)
+			o_logDropWrite(out, ring->tid, dropped);
+	}
+
+	if(0 != count)
+		fflush(out);
+
+	/* Free the rings of exited threads. isDead is read before head so that the last records of the thread are seen */
+	pthread_mutex_lock(&o_logRingsLock);
+	prev = &o_logRings;
+	while(NULL != (ring = *prev))
+	{
+		if(0 != ring->isDead.load(std::memory_order_acquire)
+			&& ring->head.load(std::memory_order_acquire) == ring->tail.load(std::memory_order_relaxed))
+		{
+			*prev = ring->next;
+			osa_free(ring);
+			continue;
+		}
+		prev = &ring->next;
+	}
+	pthread_mutex_unlock(&o_logRingsLock);
+
+	return count;
+}
+
+static void * o_logThread(void *)
+{
+	osa_fileHd_t * out = o_logOut.load(std::memory_order_acquire);
+
+	while(0 != o_logRun.load(std::memory_order_acquire))
+	{
+		if(0 == o_logDrain(out))
+			usleep(OSA_LOG_FLUSH_US);
+	}
+
+	o_logDrain(out);
+	return NULL;
+}
+
+ret_e osa_logAsyncStart(osa_fileHd_t * out, osa_logFormat_e format)
+{
+	char * func = "osa_logAsyncStart";
+	osa_thread_priority_e prio = OSA_THREAD_PRIO_DEFAULT;
+	char thrName[15] = "osa_log";
+
+	if(0 != o_logRun.load(std::memory_order_acquire))
+	{
+		osa_loge("%s:error: async logging is already running", func);
+		return OSA_ERR_BADPARAM;
+	}
+
+	if(NULL == out)
+		out = stdout;
+	if(OSA_LOG_BINARY == format)
+	{
+		memset(o_logFmtSent, 0, sizeof(o_logFmtSent));
+		o_logPrevTs = 0;
+		fwrite(OSA_LOGBIN_MAGIC, 1, sizeof(OSA_LOGBIN_MAGIC), out);
+	}
+	o_logFormat.store(format, std::memory_order_relaxed);
+	o_logOut.store(out, std::memory_order_release);
+
+	pthread_mutex_lock(&o_logRingsLock);
+	o_logThrAlive = 1;
+	pthread_mutex_unlock(&o_logRingsLock);
+
+	o_logRun.store(1, std::memory_order_release);
+	if(OSA_SUCCESS != osa_thread_create(o_logThr, o_logThread, prio, thrName, NULL, NULL))
+	{
+		o_logRun.store(0, std::memory_order_release);
+		pthread_mutex_lock(&o_logRingsLock);
+		o_logThrAlive = 0;
+		pthread_mutex_unlock(&o_logRingsLock);
+		osa_loge("%s:error: log thread could not be created", func);
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	o_logAsyncOn.store(1, std::memory_order_release);
+	return OSA_SUCCESS;
+}
+
+ret_e osa_logAsyncStop()
+{
+	char * func = "osa_logAsyncStop";
+	o_logRing_t * ring, ** prev;
+
+	if(0 == o_logRun.load(std::memory_order_acquire))
+	{
+		osa_loge("%s:error: async logging is not running", func);
+		return OSA_ERR_BADPARAM;
+	}
+
+	/* New records are written synchronously from here on. Records being written to a ring right now are waited for, then
+	   the thread drains the rings once more before exiting. The lock keeps the thread from freeing rings meanwhile */
+	o_logAsyncOn.store(0, std::memory_order_seq_cst);
+	pthread_mutex_lock(&o_logRingsLock);
+	for(ring = o_logRings; NULL != ring; ring = ring->next)
+	{
+		while(0 != ring->busy.load(std::memory_order_seq_cst))
+			sched_yield();
+	}
+	pthread_mutex_unlock(&o_logRingsLock);
+
+	o_logRun.store(0, std::memory_order_release);
+	osa_thread_join(o_logThr, NULL);
+
+	/* Free the rings of the threads which exited since the last drain. Threads exiting from now on free their own */
+	pthread_mutex_lock(&o_logRingsLock);
+	o_logThrAlive = 0;
+	prev = &o_logRings;
+	while(NULL != (ring = *prev))
+	{
+		if(0 != ring->isDead.load(std::memory_order_acquire))
+		{
+			*prev = ring->next;
+			osa_free(ring);
+			continue;
+		}
+		prev = &ring->next;
+	}
+	pthread_mutex_unlock(&o_logRingsLock);
+
+	o_logOut.store(NULL, std::memory_order_release);
+	return OSA_SUCCESS;
+}
@@ -0,0 +1,356 @@
+#include "osa.h"
+#include "osa_log_internal.h"
+#include <string.h>
+#include <time.h>
+
+/* Formatting and binary encoding of log records. Kept apart from the logging backend (osa_log.cc) so that
+   tools/osa_logdecode needs only this file */
+
+/* o_logArgGet : Take the next argument of a record. Returns false if there is none left */
+static bool o_logArgGet(const u8_t *&p, const u8_t * end, u8_t &tag, u64_t &val, const char *&str, u32_t &strLen)
+{
+	if(p >= end)
+		return false;
+
+	tag = *p++;
+	if(OSA_LOGARG_STR == tag)
+	{
+		if(end - p < 2)
+			return false;
+		strLen = p[0] | (p[1] << 8);
+		p += 2;
+		if((u32_t)(end - p) < strLen)
+			return false;
+		str = (const char *)p;
+		p += strLen;
+		return true;
+	}
+
+	if(end - p < 8)
+		return false;
+	memcpy(&val, p, 8);
+	p += 8;
+	return true;
+}
+
+int osa_logFmt(char * out, int outSz, const char * fmt, const u8_t * args, u32_t argSz)
+{
+	const u8_t * p = args, * end = args + argSz;
+	const char * spec0, * str = NULL;
+	char spec[48];
+	int len = 0, n, sLen, precAt, prec;
+	u32_t strLen = 0;
+	u64_t val = 0;
+	u8_t tag = 0;
+	bool isWide, known, ok;
+	double d;
+
+	if(outSz <= 0)
+		return 0;
+
+	while('\0' != *fmt && len < outSz - 1)
+	{
+		if('%' != *fmt || '%' == fmt[1])
+		{
+			out[len++] = *fmt;
+			fmt += ('%' == *fmt) ? 2 : 1;
+			continue;
+		}
+
+		/* Rebuild the conversion with our own length modifier: integers are passed to snprintf as 64 bit */
+		spec0 = fmt++;
+		sLen = 0;
+		precAt = -1;
+		spec[sLen++] = '%';
+		while('\0' != *fmt && NULL != strchr("-+ #0'", *fmt))
+		{
+			if(sLen < 8)
+				spec[sLen++] = *fmt;
+			fmt++;
+		}
+		for(int part = 0; part < 2; part++)
+		{
+			if(1 == part)
+			{
+				if('.' != *fmt)
+					break;
+				precAt = sLen;
+				spec[sLen++] = *fmt++;
+			}
+			if('*' == *fmt)
+			{
+				fmt++;
+				if(o_logArgGet(p, end, tag, val, str, strLen) && OSA_LOGARG_STR != tag && sLen < 24)
+					sLen += snprintf(spec + sLen, 12, "%d", (int)val);
+			}
+			while(*fmt >= '0' && *fmt <= '9')
+			{
+				if(sLen < 24)
+					spec[sLen++] = *fmt;
+				fmt++;
+			}
+		}
+		while('\0' != *fmt && NULL != strchr("hlLqjzt", *fmt))
+			fmt++;
+		if('\0' == *fmt)
+			break;
+
+		known = (NULL != strchr("diouxXcpseEfFgGaAn", *fmt));
+		ok = known && o_logArgGet(p, end, tag, val, str, strLen);
+		isWide = (OSA_LOGARG_I64 == tag || OSA_LOGARG_U64 == tag || OSA_LOGARG_PTR == tag);
+		n = 0;
+		if(!known)
+		{
+			/* Not a conversion we know. Copy it as it is */
+			n = snprintf(out + len, outSz - len, "%.*s", (int)(fmt + 1 - spec0), spec0);
+		}
+		else if(!ok || (OSA_LOGARG_STR == tag && 's' != *fmt) || (OSA_LOGARG_STR != tag && 's' == *fmt))
+		{
+			n = snprintf(out + len, outSz - len, "<?>");
+		}
+		else
+		{
+			switch(*fmt)
+			{
+				case 'd':
+				case 'i':
+					spec[sLen++] = 'l';
+					spec[sLen++] = 'l';
+					spec[sLen++] = *fmt;
+					spec[sLen] = '\0';
+					n = snprintf(out + len, outSz - len, spec, isWide ? (long long)val : (long long)(i32_t)val);
+				break;
+				case 'o':
+				case 'u':
+				case 'x':
+				case 'X':
+					spec[sLen++] = 'l';
+					spec[sLen++] = 'l';
+					spec[sLen++] = *fmt;
+					spec[sLen] = '\0';
+					n = snprintf(out + len, outSz - len, spec, isWide ? (unsigned long long)val : (unsigned long long)(u32_t)val);
+				break;
+				case 'c':
+					spec[sLen++] = 'c';
+					spec[sLen] = '\0';
+					n = snprintf(out + len, outSz - len, spec, (int)val);
+				break;
+				case 'p':
+					spec[sLen++] = 'p';
+					spec[sLen] = '\0';
+					n = snprintf(out + len, outSz - len, spec, (void *)(uintptr_t)val);
+				break;
+				case 's':
+					/* The string is not terminated in the record. Print it with a precision, the user's one if smaller */
+					prec = (int)strLen;
+					if(0 <= precAt)
+					{
+						spec[sLen] = '\0';
+						n = atoi(spec + precAt + 1);
+						if(0 <= n && n < prec)
+							prec = n;
+						sLen = precAt;
+					}
+					spec[sLen++] = '.';
+					spec[sLen++] = '*';
+					spec[sLen++] = 's';
+					spec[sLen] = '\0';
+					n = snprintf(out + len, outSz - len, spec, prec, str);
+				break;
+				case 'e': case 'E': case 'f': case 'F':
+				case 'g': case 'G': case 'a': case 'A':
+					if(OSA_LOGARG_DBL == tag)
+						memcpy(&d, &val, 8);
+					else
+						d = (double)(i64_t)val;
+					spec[sLen++] = *fmt;
+					spec[sLen] = '\0';
+					n = snprintf(out + len, outSz - len, spec, d);
+				break;
+				default: 	/* %n : nothing is printed */
+				break;
+			}
+		}
+		fmt++;
+
+		if(n > 0)
+			len += (n < outSz - len) ? n : outSz - 1 - len;
+	}
+
+	out[len] = '\0';
+	return len;
+}
+
+int osa_logLine(char * line, int sz, const osa_logRec_t * rec, const char * fmt)
+{
+	static const char lvlTag[] = "EIDV";
+	static thread_local time_t lastSec = -1;
+	static thread_local char secStr[24];
+	time_t sec = rec->ts / 1000000000ull;
+	struct tm tm;
+	int len;
+
+	/* localtime_r takes a libc lock. Call it once a second */
+	if(sec != lastSec)
+	{
+		localtime_r(&sec, &tm);
+		strftime(secStr, sizeof(secStr), "%Y-%m-%d %H:%M:%S", &tm);
+		lastSec = sec;
+	}
+
+	len = snprintf(line, sz, "%s.%06u %c %d ", secStr, (u32_t)(rec->ts % 1000000000ull / 1000),
+				lvlTag[rec->level <= LOGLVL_VERBOSE ? rec->level : LOGLVL_VERBOSE], rec->tid);
+	if(len >= sz - 1)
+		len = sz - 2;
+
+	len += osa_logFmt(line + len, sz - len - 1, fmt, (const u8_t *)(rec + 1), rec->argSz);
+	if('\n' != line[len - 1])
+		line[len++] = '\n';
+
+	return len;
+}
+
+void osa_logVarPut(u8_t *&p, u64_t val)
+{
+	while(val >= 0x80)
+	{
+		*p++ = (u8_t)val | 0x80;
+		val >>= 7;
+	}
+	*p++ = (u8_t)val;
+}
+
+static bool o_logVarGet(const u8_t *&p, const u8_t * end, u64_t &val)
+{
+	u8_t b;
+
+	val = 0;
+	for(int shift = 0; p < end && shift < 64; shift += 7)
+	{
+		b = *p++;
+		val |= (u64_t)(b & 0x7f) << shift;
+		if(0 == (b & 0x80))
+			return true;
+	}
+	return false;
+}
+
+static u64_t o_logZig(i64_t val)
+{
+	return ((u64_t)val << 1) ^ (u64_t)(val >> 63);
+}
+
+static i64_t o_logUnzig(u64_t val)
+{
+	return (i64_t)(val >> 1) ^ -(i64_t)(val & 1);
+}
+
+u32_t osa_logBinEncode(u8_t * out, const osa_logRec_t * rec, u64_t &prevTs)
+{
+	const u8_t * a = (const u8_t *)(rec + 1), * end = a + rec->argSz;
+	u8_t * p = out;
+	u32_t strLen;
+	u64_t val;
+	u8_t tag;
+
+	osa_logVarPut(p, rec->fmtId);
+	osa_logVarPut(p, o_logZig((i64_t)(rec->ts - prevTs)));
+	osa_logVarPut(p, (u32_t)rec->tid);
+	prevTs = rec->ts;
+
+	/* An argument that did not fit in the record may have left a few unused bytes at the end. They are not copied */
+	while(a < end)
+	{
+		tag = *a++;
+		if(OSA_LOGARG_STR == tag)
+		{
+			if(end - a < 2 || (u32_t)(end - a - 2) < (strLen = a[0] | (a[1] << 8)))
+				break;
+			*p++ = tag;
+			osa_logVarPut(p, strLen);
+			memcpy(p, a + 2, strLen);
+			p += strLen;
+			a += 2 + strLen;
+			continue;
+		}
+
+		if(end - a < 8 || tag > OSA_LOGARG_STR)
+			break;
+		memcpy(&val, a, 8);
+		a += 8;
+		*p++ = tag;
+		if(OSA_LOGARG_DBL == tag)
+		{
+			memcpy(p, &val, 8);
+			p += 8;
+		}
+		else if(OSA_LOGARG_I32 == tag || OSA_LOGARG_I64 == tag)
+		{
+			osa_logVarPut(p, o_logZig((i64_t)val));
+		}
+		else
+		{
+			osa_logVarPut(p, val);
+		}
+	}
+
+	return p - out;
+}
+
+bool osa_logBinDecode(const u8_t * in, u32_t len, osa_logRec_t * rec, u64_t &prevTs)
+{
+	const u8_t * end = in + len;
+	u8_t * a = (u8_t *)(rec + 1), * aEnd = a + OSA_LOG_REC_MAX;
+	u64_t val, fmtId, tid;
+	u8_t tag;
+
+	if(!o_logVarGet(in, end, fmtId) || !o_logVarGet(in, end, val) || !o_logVarGet(in, end, tid))
+		return false;
+
+	rec->fmtId = (u32_t)fmtId;
+	rec->tid = (i32_t)tid;
+	rec->ts = prevTs + o_logUnzig(val);
+	prevTs = rec->ts;
+
+	while(in < end)
+	{
+		tag = *in++;
+		if(OSA_LOGARG_STR == tag)
+		{
+			if(!o_logVarGet(in, end, val) || val > (u64_t)(end - in) || val > 0xffff || aEnd - a < 3 + (i64_t)val)
+				return false;
+			*a++ = tag;
+			*a++ = val & 0xff;
+			*a++ = val >> 8;
+			memcpy(a, in, val);
+			a += val;
+			in += val;
+			continue;
+		}
+
+		if(aEnd - a < 9 || tag > OSA_LOGARG_STR)
+			return false;
+		if(OSA_LOGARG_DBL == tag)
+		{
+			if(end - in < 8)
+				return false;
+			memcpy(&val, in, 8);
+			in += 8;
+		}
+		else if(!o_logVarGet(in, end, val))
+		{
+			return false;
+		}
+		else if(OSA_LOGARG_I32 == tag || OSA_LOGARG_I64 == tag)
+		{
+			val = (u64_t)o_logUnzig(val);
+		}
+		*a++ = tag;
+		memcpy(a, &val, 8);
+		a += 8;
+	}
+
+	rec->argSz = a - (u8_t *)(rec + 1);
+	rec->size = (sizeof(osa_logRec_t) + rec->argSz + 7) & ~7u;
+	return true;
+}
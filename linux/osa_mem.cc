@@ -1,5 +1,11 @@
 #include "osa.h"
 #include <stdlib.h>
+#include <string.h>
+#include "osa_threads_internal.h"
+#include <sys/mman.h>
+#include <linux/mempolicy.h>
+
+#ifndef OSA_MEM_STATS
 
 void * osa_malloc(u32_t sz)
 {
@@ -19,4 +25,1325 @@ void * osa_realloc(void * buf, u32_t sz)
 void osa_free(void * buf)
 {
 	return free(buf);
-}
\ No newline at end of file
+}
+
+ret_e osa_memGetStats(osa_memStats_t &stats)
+{
+	char * func = "osa_memGetStats";
+
+	memset(&stats, 0, sizeof(stats));
+	osa_loge("%s:error: osa is built without OSA_MEM_STATS", func);
+	return OSA_ERR_BADPARAM;
+}
+
+void osa_memReport(FILE * out, u32_t)
+{
+	fprintf((NULL != out) ? out : stdout, "osa_mem: no statistics. Build osa with -DOSA_MEM_STATS\n");
+}
+
+#else
+
+/********************************************************
+*					S T A T I S T I C S
+*********************************************************/
+
+#include <dlfcn.h>
+
+#define O_MEM_MAGIC		0x05A4E44Au
+
+/* Header of every block. 16 bytes, so the memory handed out keeps the alignment of malloc */
+typedef struct o_memHdr_t
+{
+	u32_t size;
+	u32_t site; 						/* Index in o_memSites */
+	u32_t magic; 						/* O_MEM_MAGIC while allocated */
+	u32_t pad;
+}o_memHdr_t;
+
+/* Counters of one thread. Only the owner writes them (plain load + store, no locked instruction). The report reads
+   them from any thread. The per site counts of a thread can go below zero when other threads free its blocks, only
+   the sum over the threads means something */
+typedef struct o_memThr_t
+{
+	std::atomic<u64_t> allocs;
+	std::atomic<u64_t> frees;
+	std::atomic<u64_t> reallocs;
+	std::atomic<u64_t> bytesAlloc;
+	std::atomic<i64_t> delta; 					/* Bytes in use not added to o_memInUse yet */
+	std::atomic<u64_t> classAllocs[OSA_MEM_CLASSES];
+	std::atomic<u64_t> classBytes[OSA_MEM_CLASSES];
+	std::atomic<u64_t> siteAllocs[OSA_MEM_SITES];
+	std::atomic<u64_t> siteLive[OSA_MEM_SITES]; 		/* Blocks outstanding */
+	std::atomic<u64_t> siteLiveBytes[OSA_MEM_SITES];
+	o_memThr_t * next;
+}o_memThr_t;
+
+static std::atomic<uintptr_t> o_memSites[OSA_MEM_SITES]; 	/* Return address of the call site. Slot 0: table full */
+static std::atomic<i64_t> o_memInUse(0);
+static std::atomic<i64_t> o_memPeak(0);
+static std::atomic<u32_t> o_memLock(0); 					/* Protects the two below */
+static o_memThr_t * o_memThrs = NULL; 						/* Threads alive */
+static o_memThr_t o_memDead; 								/* Counts of the threads gone, and of the ones without counters */
+
+/* Per thread state. Its counters are folded into o_memDead when the thread exits */
+typedef struct o_memTls_t
+{
+	o_memThr_t * thr;
+	bool isGone;
+
+	~o_memTls_t();
+}o_memTls_t;
+
+static thread_local o_memTls_t o_memTls;
+
+static inline void o_memAdd(std::atomic<u64_t> &cnt, u64_t val)
+{
+	cnt.store(cnt.load(std::memory_order_relaxed) + val, std::memory_order_relaxed);
+}
+
+static inline u64_t o_memTake(std::atomic<u64_t> &cnt, bool clear)
+{
+	return clear ? cnt.exchange(0, std::memory_order_relaxed) : cnt.load(std::memory_order_relaxed);
+}
+
+/* o_memFold : Add the counters of 'src' to 'dst'. With 'clear' they are moved: 'src' is zeroed and its pending bytes
+			   in use go to o_memInUse. Call with o_memLock held */
+static void o_memFold(o_memThr_t * dst, o_memThr_t * src, bool clear)
+{
+	i64_t delta;
+
+	o_memAdd(dst->allocs, o_memTake(src->allocs, clear));
+	o_memAdd(dst->frees, o_memTake(src->frees, clear));
+	o_memAdd(dst->reallocs, o_memTake(src->reallocs, clear));
+	o_memAdd(dst->bytesAlloc, o_memTake(src->bytesAlloc, clear));
+	for(int i = 0; i < OSA_MEM_CLASSES; i++)
+	{
+		o_memAdd(dst->classAllocs[i], o_memTake(src->classAllocs[i], clear));
+		o_memAdd(dst->classBytes[i], o_memTake(src->classBytes[i], clear));
+	}
+	for(int i = 0; i < OSA_MEM_SITES; i++)
+	{
+		o_memAdd(dst->siteAllocs[i], o_memTake(src->siteAllocs[i], clear));
+		o_memAdd(dst->siteLive[i], o_memTake(src->siteLive[i], clear));
+		o_memAdd(dst->siteLiveBytes[i], o_memTake(src->siteLiveBytes[i], clear));
+	}
+
+	if(clear)
+		o_memInUse.fetch_add(src->delta.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+	else
+	{
+		delta = dst->delta.load(std::memory_order_relaxed) + src->delta.load(std::memory_order_relaxed);
+		dst->delta.store(delta, std::memory_order_relaxed);
+	}
+}
+
+o_memTls_t :: ~o_memTls_t()
+{
+	o_memThr_t ** pp;
+
+	isGone = true;
+	if(NULL == thr)
+		return;
+
+	o_lock(o_memLock);
+	for(pp = &o_memThrs; *pp != thr; pp = &(*pp)->next)
+		;
+	*pp = thr->next;
+	o_memFold(&o_memDead, thr, true);
+	o_unlock(o_memLock);
+
+	free(thr);
+	thr = NULL;
+}
+
+/* o_memThr : Counters of the calling thread. NULL if the thread is exiting or they could not be allocated. Those
+			  allocations go straight to o_memDead under the lock */
+static o_memThr_t * o_memThr()
+{
+	o_memThr_t * thr = o_memTls.thr;
+
+	if(NULL != thr || o_memTls.isGone)
+		return thr;
+
+	thr = (o_memThr_t *)calloc(1, sizeof(o_memThr_t)); 		/* Not osa_calloc. It would count itself */
+	if(NULL == thr)
+		return NULL;
+
+	o_lock(o_memLock);
+	thr->next = o_memThrs;
+	o_memThrs = thr;
+	o_unlock(o_memLock);
+
+	o_memTls.thr = thr;
+	return thr;
+}
+
+static u32_t o_memClass(u64_t sz)
+{
+	u32_t c;
+
+	if(sz <= 16)
+		return 0;
+
+	c = 64 - __builtin_clzll(sz - 1) - 4;
+	return (c < OSA_MEM_CLASSES) ? c : OSA_MEM_CLASSES - 1;
+}
+
+/* o_memSite : Slot of a call site. Sites are never removed, a new one takes a free slot with a compare-and-swap */
+static u32_t o_memSite(uintptr_t addr)
+{
+	u32_t i = (u32_t)(((u64_t)addr * 0x9E3779B97F4A7C15ull) >> 54) % OSA_MEM_SITES;
+	uintptr_t cur;
+
+	for(u32_t n = 0; n < OSA_MEM_SITES; n++, i = (i + 1) % OSA_MEM_SITES)
+	{
+		if(0 == i)
+			continue;
+
+		cur = o_memSites[i].load(std::memory_order_acquire);
+		if(cur == addr)
+			return i;
+		if(0 == cur && (o_memSites[i].compare_exchange_strong(cur, addr, std::memory_order_acq_rel) || cur == addr))
+			return i;
+	}
+	return 0;
+}
+
+/* o_memCount : Count an allocation (sz > 0) or a free (sz < 0) of 'site' */
+static void o_memCount(i64_t sz, u32_t site, bool isRealloc)
+{
+	o_memThr_t * thr = o_memThr();
+	bool locked = (NULL == thr);
+	u32_t c;
+	i64_t delta, inUse, peak;
+
+	if(locked)
+	{
+		o_lock(o_memLock);
+		thr = &o_memDead;
+	}
+
+	if(0 <= sz)
+	{
+		c = o_memClass(sz);
+		o_memAdd(isRealloc ? thr->reallocs : thr->allocs, 1);
+		o_memAdd(thr->bytesAlloc, sz);
+		o_memAdd(thr->classAllocs[c], 1);
+		o_memAdd(thr->classBytes[c], sz);
+		o_memAdd(thr->siteAllocs[site], 1);
+		o_memAdd(thr->siteLive[site], 1);
+		o_memAdd(thr->siteLiveBytes[site], sz);
+	}
+	else
+	{
+		if(!isRealloc)
+			o_memAdd(thr->frees, 1);
+		o_memAdd(thr->siteLive[site], (u64_t)-1);
+		o_memAdd(thr->siteLiveBytes[site], (u64_t)sz);
+	}
+
+	delta = thr->delta.load(std::memory_order_relaxed) + sz;
+	if(delta < OSA_MEM_PEAK_STEP && delta > -OSA_MEM_PEAK_STEP)
+		thr->delta.store(delta, std::memory_order_relaxed);
+	else
+	{
+		thr->delta.store(0, std::memory_order_relaxed);
+		inUse = o_memInUse.fetch_add(delta, std::memory_order_relaxed) + delta;
+		peak = o_memPeak.load(std::memory_order_relaxed);
+		while(inUse > peak && !o_memPeak.compare_exchange_weak(peak, inUse, std::memory_order_relaxed))
+			;
+	}
+
+	if(locked)
+		o_unlock(o_memLock);
+}
+
+static void * o_memAlloc(u32_t sz, bool zero, uintptr_t caller)
+{
+	o_memHdr_t * hdr;
+
+	hdr = (o_memHdr_t *)(zero ? calloc(1, sizeof(o_memHdr_t) + (size_t)sz) : malloc(sizeof(o_memHdr_t) + (size_t)sz));
+	if(NULL == hdr)
+		return NULL;
+
+	hdr->size = sz;
+	hdr->site = o_memSite(caller);
+	hdr->magic = O_MEM_MAGIC;
+	o_memCount(sz, hdr->site, false);
+	return hdr + 1;
+}
+
+/* o_memHdr : Header of a block handed out by osa_malloc. NULL (and an error) if it is not one */
+static o_memHdr_t * o_memHdr(void * buf, char * func)
+{
+	o_memHdr_t * hdr = (o_memHdr_t *)buf - 1;
+
+	if(O_MEM_MAGIC == hdr->magic)
+		return hdr;
+
+	osa_loge("%s:error: %p is freed already or is not from osa_malloc", func, buf);
+	return NULL;
+}
+
+void * osa_malloc(u32_t sz)
+{
+	return o_memAlloc(sz, false, (uintptr_t)__builtin_return_address(0));
+}
+
+void * osa_calloc(u32_t sz)
+{
+	return o_memAlloc(sz, true, (uintptr_t)__builtin_return_address(0));
+}
+
+void * osa_realloc(void * buf, u32_t sz)
+{
+	char * func = "osa_realloc";
+	o_memHdr_t * hdr, * newHdr;
+	u32_t oldSz, oldSite;
+
+	if(NULL == buf)
+		return o_memAlloc(sz, false, (uintptr_t)__builtin_return_address(0));
+
+	if(NULL == (hdr = o_memHdr(buf, func)))
+		return NULL;
+
+	if(0 == sz) 			/* Same as realloc(): frees the buffer */
+	{
+		osa_free(buf);
+		return NULL;
+	}
+
+	oldSz = hdr->size;
+	oldSite = hdr->site;
+	newHdr = (o_memHdr_t *)realloc(hdr, sizeof(o_memHdr_t) + (size_t)sz);
+	if(NULL == newHdr)
+		return NULL;
+
+	newHdr->size = sz;
+	newHdr->site = o_memSite((uintptr_t)__builtin_return_address(0));
+	o_memCount(-(i64_t)oldSz, oldSite, true);
+	o_memCount(sz, newHdr->site, true);
+	return newHdr + 1;
+}
+
+void osa_free(void * buf)
+{
+	char * func = "osa_free";
+	o_memHdr_t * hdr;
+
+	if(NULL == buf || NULL == (hdr = o_memHdr(buf, func)))
+		return;
+
+	hdr->magic = 0;
+	o_memCount(-(i64_t)hdr->size, hdr->site, false);
+	free(hdr);
+}
+
+/* o_memSum : Counters of all the threads added up. Freed by the caller */
+static o_memThr_t * o_memSum()
+{
+	o_memThr_t * sum = (o_memThr_t *)calloc(1, sizeof(o_memThr_t));
+
+	if(NULL == sum)
+		return NULL;
+
+	o_lock(o_memLock);
+	o_memFold(sum, &o_memDead, false);
+	for(o_memThr_t * thr = o_memThrs; NULL != thr; thr = thr->next)
+		o_memFold(sum, thr, false);
+	o_unlock(o_memLock);
+
+	return sum;
+}
+
+ret_e osa_memGetStats(osa_memStats_t &stats)
+{
+	char * func = "osa_memGetStats";
+	o_memThr_t * sum = o_memSum();
+	i64_t inUse;
+
+	memset(&stats, 0, sizeof(stats));
+	if(NULL == sum)
+	{
+		osa_loge("%s:error: no memory to add up the counters", func);
+		return OSA_ERR_INSUFFMEM;
+	}
+
+	stats.allocs = sum->allocs.load(std::memory_order_relaxed);
+	stats.frees = sum->frees.load(std::memory_order_relaxed);
+	stats.reallocs = sum->reallocs.load(std::memory_order_relaxed);
+	stats.bytesAlloc = sum->bytesAlloc.load(std::memory_order_relaxed);
+	for(int i = 0; i < OSA_MEM_CLASSES; i++)
+	{
+		stats.classAllocs[i] = sum->classAllocs[i].load(std::memory_order_relaxed);
+		stats.classBytes[i] = sum->classBytes[i].load(std::memory_order_relaxed);
+	}
+
+	inUse = o_memInUse.load(std::memory_order_relaxed) + sum->delta.load(std::memory_order_relaxed);
+	stats.bytesInUse = (0 < inUse) ? inUse : 0;
+	stats.peakInUse = o_memPeak.load(std::memory_order_relaxed);
+	if(stats.peakInUse < stats.bytesInUse)
+		stats.peakInUse = stats.bytesInUse;
+
+	free(sum);
+	return OSA_SUCCESS;
+}
+
+/* o_memSiteName : "<binary>+0x<offset>" of a call site, or its address if it is in no loaded object */
+static void o_memSiteName(uintptr_t addr, char * name, u32_t sz)
+{
+	Dl_info info;
+
+	/* The return address points after the call. One byte back is inside the call instruction */
+	if(0 != dladdr((void *)(addr - 1), &info) && NULL != info.dli_fname)
+		snprintf(name, sz, "%s+0x%lx%s%s", info.dli_fname, (unsigned long)(addr - 1 - (uintptr_t)info.dli_fbase),
+					(NULL != info.dli_sname) ? " " : "", (NULL != info.dli_sname) ? info.dli_sname : "");
+	else
+		snprintf(name, sz, "%p", (void *)addr);
+}
+
+void osa_memReport(FILE * out, u32_t maxSites)
+{
+	o_memThr_t * sum;
+	osa_memStats_t st;
+	char name[512];
+	u32_t best;
+	u64_t bestBytes, bytes;
+	bool done[OSA_MEM_SITES] = { false };
+
+	if(NULL == out)
+		out = stdout;
+
+	if(OSA_SUCCESS != osa_memGetStats(st) || NULL == (sum = o_memSum()))
+	{
+		fprintf(out, "osa_mem: no memory for the report\n");
+		return;
+	}
+
+	fprintf(out, "osa_mem: allocs=%llu frees=%llu reallocs=%llu outstanding=%lld bytesAlloc=%llu inUse=%llu peak=%llu\n",
+			(unsigned long long)st.allocs, (unsigned long long)st.frees, (unsigned long long)st.reallocs,
+			(long long)(st.allocs - st.frees), (unsigned long long)st.bytesAlloc, (unsigned long long)st.bytesInUse,
+			(unsigned long long)st.peakInUse);
+
+	fprintf(out, "osa_mem: %12s %14s %16s\n", "size <=", "allocs", "bytes");
+	for(int i = 0; i < OSA_MEM_CLASSES; i++)
+	{
+		if(0 == st.classAllocs[i])
+			continue;
+		if(OSA_MEM_CLASSES - 1 == i)
+			fprintf(out, "osa_mem: %12s %14llu %16llu\n", "bigger", (unsigned long long)st.classAllocs[i],
+					(unsigned long long)st.classBytes[i]);
+		else
+			fprintf(out, "osa_mem: %12llu %14llu %16llu\n", 16ull << i, (unsigned long long)st.classAllocs[i],
+					(unsigned long long)st.classBytes[i]);
+	}
+
+	/* Sites with the most bytes outstanding first. A simple selection, the report is not on any fast path */
+	fprintf(out, "osa_mem: %14s %16s %14s  site\n", "live", "liveBytes", "allocs");
+	for(u32_t n = 0; n < maxSites; n++)
+	{
+		best = OSA_MEM_SITES;
+		bestBytes = 0;
+		for(u32_t i = 0; i < OSA_MEM_SITES; i++)
+		{
+			bytes = sum->siteLiveBytes[i].load(std::memory_order_relaxed);
+			if(!done[i] && 0 != sum->siteAllocs[i].load(std::memory_order_relaxed) && (i64_t)bytes >= (i64_t)bestBytes)
+			{
+				best = i;
+				bestBytes = bytes;
+			}
+		}
+		if(OSA_MEM_SITES == best || 0 == sum->siteLive[best].load(std::memory_order_relaxed))
+			break;
+
+		done[best] = true;
+		if(0 == best)
+			snprintf(name, sizeof(name), "(more than OSA_MEM_SITES sites)");
+		else
+			o_memSiteName(o_memSites[best].load(std::memory_order_acquire), name, sizeof(name));
+		fprintf(out, "osa_mem: %14lld %16lld %14llu  %s\n", (long long)sum->siteLive[best].load(std::memory_order_relaxed),
+				(long long)bestBytes, (unsigned long long)sum->siteAllocs[best].load(std::memory_order_relaxed), name);
+	}
+	fflush(out);
+
+	free(sum);
+}
+
+#endif
+
+/********************************************************
+*					L A R G E   B U F F E R S
+*********************************************************/
+
+#define O_MEM_MAX_NODES		1024		/* Nodes in the mask given to mbind */
+
+/* Mapping of a buffer from osa_mallocLarge. osa_freeLarge needs its length */
+typedef struct o_memLarge_t
+{
+	void * buf;
+	u64_t len;
+	o_memLarge_t * next;
+}o_memLarge_t;
+
+static o_memLarge_t * o_memLarges = NULL;
+static std::atomic<u32_t> o_memLargesLock(0);
+
+/* o_memMapAligned : Anonymous mapping of 'len' bytes starting at a multiple of 'align'. The kernel only gives huge
+					 pages to the parts of a mapping that are aligned to the huge page size */
+static void * o_memMapAligned(u64_t len, u64_t align)
+{
+	u8_t * p, * start;
+
+	p = (u8_t *)mmap(NULL, len + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(MAP_FAILED == p)
+		return MAP_FAILED;
+
+	start = (u8_t *)(((uintptr_t)p + align - 1) & ~(uintptr_t)(align - 1));
+	if(start != p)
+		munmap(p, start - p);
+	if(start + len != p + len + align)
+		munmap(start + len, (p + len + align) - (start + len));
+
+	return start;
+}
+
+void * osa_mallocLarge(u64_t sz, u32_t flags, int numaNode)
+{
+	char * func = "osa_mallocLarge";
+	u64_t pageSz = (u64_t)sysconf(_SC_PAGESIZE), len;
+	unsigned long mask[O_MEM_MAX_NODES / (8 * sizeof(unsigned long))] = { 0 };
+	void * buf = MAP_FAILED;
+	o_memLarge_t * rec;
+
+	if(0 == sz || numaNode < OSA_MEM_NODE_ANY || numaNode >= O_MEM_MAX_NODES)
+	{
+		osa_loge("%s:error: sz=%llu, numaNode=%d is not valid", func, (unsigned long long)sz, numaNode);
+		return NULL;
+	}
+
+	if(0 != (flags & (OSA_MEM_THP | OSA_MEM_HUGETLB)))
+		pageSz = OSA_MEM_HUGE_PAGE_SZ;
+	len = (sz + pageSz - 1) & ~(pageSz - 1);
+
+	rec = (o_memLarge_t *)osa_malloc(sizeof(o_memLarge_t));
+	if(NULL == rec)
+	{
+		osa_loge("%s:error: no memory for the record of the buffer", func);
+		return NULL;
+	}
+
+	if(0 != (flags & OSA_MEM_HUGETLB))
+	{
+		buf = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if(MAP_FAILED == buf)
+		{
+			osa_logd("%s: no %llu bytes in the huge page pool (errno %d). Using transparent huge pages", func,
+						(unsigned long long)len, errno);
+			flags |= OSA_MEM_THP;
+		}
+	}
+
+	if(MAP_FAILED == buf)
+	{
+		buf = o_memMapAligned(len, pageSz);
+		if(MAP_FAILED == buf)
+		{
+			osa_loge("%s:error: mmap of %llu bytes failed. errno=%d", func, (unsigned long long)len, errno);
+			osa_free(rec);
+			return NULL;
+		}
+
+		if(0 != (flags & OSA_MEM_THP) && 0 != madvise(buf, len, MADV_HUGEPAGE))
+			osa_logd("%s: transparent huge pages not available (errno %d)", func, errno);
+	}
+
+	if(OSA_MEM_NODE_ANY != numaNode)
+	{
+		mask[numaNode / (8 * sizeof(unsigned long))] = 1ul << (numaNode % (8 * sizeof(unsigned long)));
+		if(0 != syscall(SYS_mbind, buf, len, (0 != (flags & OSA_MEM_NODE_STRICT)) ? MPOL_BIND : MPOL_PREFERRED,
+						mask, O_MEM_MAX_NODES + 1, 0))
+		{
+			if(0 != (flags & OSA_MEM_NODE_STRICT))
+			{
+				osa_loge("%s:error: memory can't be bound to node %d. errno=%d", func, numaNode, errno);
+				munmap(buf, len);
+				osa_free(rec);
+				return NULL;
+			}
+			osa_logd("%s: node %d not set as preferred (errno %d)", func, numaNode, errno);
+		}
+	}
+
+	/* Pages are zero already. Writing one byte per page makes the kernel allocate it */
+	if(0 != (flags & OSA_MEM_POPULATE))
+	{
+		for(u64_t off = 0; off < len; off += (u64_t)sysconf(_SC_PAGESIZE))
+			((volatile u8_t *)buf)[off] = 0;
+	}
+
+	rec->buf = buf;
+	rec->len = len;
+	o_lock(o_memLargesLock);
+	rec->next = o_memLarges;
+	o_memLarges = rec;
+	o_unlock(o_memLargesLock);
+
+	osa_logd("%s: %p, %llu bytes, flags=0x%x, numaNode=%d", func, buf, (unsigned long long)len, flags, numaNode);
+	return buf;
+}
+
+void osa_freeLarge(void * buf)
+{
+	char * func = "osa_freeLarge";
+	o_memLarge_t ** pp, * rec;
+
+	if(NULL == buf)
+		return;
+
+	o_lock(o_memLargesLock);
+	for(pp = &o_memLarges; NULL != *pp && (*pp)->buf != buf; pp = &(*pp)->next)
+		;
+	rec = *pp;
+	if(NULL != rec)
+		*pp = rec->next;
+	o_unlock(o_memLargesLock);
+
+	if(NULL == rec)
+	{
+		osa_loge("%s:error: %p is not from osa_mallocLarge", func, buf);
+		return;
+	}
+
+	munmap(rec->buf, rec->len);
+	osa_free(rec);
+}
+
+int osa_memNumaNode()
+{
+	unsigned cpu, node;
+
+	if(0 != syscall(SYS_getcpu, &cpu, &node, NULL))
+		return 0;
+
+	return (int)node;
+}
+
+/********************************************************
+*					A R E N A
+*********************************************************/
+
+/* Chunk header. The memory handed out follows it (16 byte aligned like the header itself) */
+struct osa_arenaChunk_t
+{
+	osa_arenaChunk_t * next;
+	u64_t size; 					/* Bytes after the header */
+};
+
+#define O_ARENA_DATA(chunk)		((u8_t *)((chunk) + 1))
+
+static osa_arenaChunk_t * o_arenaChunkNew(u64_t size)
+{
+	osa_arenaChunk_t * chunk;
+
+	if(size + sizeof(osa_arenaChunk_t) > 0xFFFFFFFFull)		/* osa_malloc takes a 32 bit size */
+		return NULL;
+
+	chunk = (osa_arenaChunk_t *)osa_malloc((u32_t)(size + sizeof(osa_arenaChunk_t)));
+	if(NULL == chunk)
+		return NULL;
+
+	chunk->next = NULL;
+	chunk->size = size;
+	return chunk;
+}
+
+osa_arena :: osa_arena()
+{
+	cur = NULL;
+	end = NULL;
+	chunks = NULL;
+	spare = NULL;
+	chunkSz = 0;
+	mode = OSA_ARENA_GROW;
+	isAlive = 0;
+	usedDone = 0;
+	reservedSz = 0;
+}
+
+osa_arena :: ~osa_arena()
+{
+	if(1 == isAlive)
+		destroy();
+}
+
+ret_e osa_arena :: create(u32_t chunkSz, osa_arena_mode_e mode)
+{
+	char * func = "osa_arena::create";
+
+	if(0 == chunkSz || (OSA_ARENA_GROW != mode && OSA_ARENA_FIXED != mode))
+	{
+		osa_loge("%s:error: chunkSz=%u, mode=%d is not valid", func, chunkSz, mode);
+		return OSA_ERR_BADPARAM;
+	}
+
+	if(1 == isAlive)
+	{
+		osa_loge("%s:error: arena %p is already created", func, this);
+		return OSA_ERR_BADPARAM;
+	}
+
+	chunks = o_arenaChunkNew(chunkSz);
+	if(NULL == chunks)
+	{
+		osa_loge("%s:error: first chunk (%u bytes) could not be allocated", func, chunkSz);
+		return OSA_ERR_INSUFFMEM;
+	}
+
+	this->chunkSz = chunkSz;
+	this->mode = mode;
+	cur = O_ARENA_DATA(chunks);
+	end = cur + chunkSz;
+	spare = NULL;
+	usedDone = 0;
+	reservedSz = chunkSz;
+	isAlive = 1;
+
+	osa_logd("%s: arena %p created. chunkSz=%u, mode=%d", func, this, chunkSz, mode);
+	return OSA_SUCCESS;
+}
+
+ret_e osa_arena :: destroy()
+{
+	char * func = "osa_arena::destroy";
+	osa_arenaChunk_t * chunk;
+
+	if(1 != isAlive)
+	{
+		osa_loge("%s:error: arena %p is not created", func, this);
+		return OSA_ERR_BADPARAM;
+	}
+
+	while(NULL != (chunk = chunks))
+	{
+		chunks = chunk->next;
+		osa_free(chunk);
+	}
+	while(NULL != (chunk = spare))
+	{
+		spare = chunk->next;
+		osa_free(chunk);
+	}
+
+	cur = NULL;
+	end = NULL;
+	usedDone = 0;
+	reservedSz = 0;
+	isAlive = 0;
+	return OSA_SUCCESS;
+}
+
+void * osa_arena :: allocSlow(u32_t sz, u32_t align)
+{
+	char * func = "osa_arena::alloc";
+	osa_arenaChunk_t * chunk;
+	uintptr_t p;
+
+	if(1 != isAlive || 0 == align || 0 != (align & (align - 1)))
+	{
+		osa_loge("%s:error: arena %p, isAlive=%d, align=%u. Not created or align is not a power of 2", func, this, isAlive, align);
+		return NULL;
+	}
+
+	if(OSA_ARENA_FIXED == mode)
+		return NULL;
+
+	/* Big allocation: a chunk of its own. It goes behind the current chunk so that the space left in that one is still used */
+	if((u64_t)sz + align > chunkSz)
+	{
+		chunk = o_arenaChunkNew((u64_t)sz + align);
+		if(NULL == chunk)
+		{
+			osa_loge("%s:error: chunk for %u bytes could not be allocated", func, sz);
+			return NULL;
+		}
+		chunk->next = chunks->next;
+		chunks->next = chunk;
+		reservedSz += chunk->size;
+		usedDone += chunk->size;
+
+		p = ((uintptr_t)O_ARENA_DATA(chunk) + align - 1) & ~(uintptr_t)(align - 1);
+		return (void *)p;
+	}
+
+	if(NULL != spare)
+	{
+		chunk = spare;
+		spare = chunk->next;
+	}
+	else
+	{
+		chunk = o_arenaChunkNew(chunkSz);
+		if(NULL == chunk)
+		{
+			osa_loge("%s:error: new chunk (%u bytes) could not be allocated", func, chunkSz);
+			return NULL;
+		}
+		reservedSz += chunkSz;
+	}
+
+	usedDone += cur - O_ARENA_DATA(chunks);
+	chunk->next = chunks;
+	chunks = chunk;
+	cur = O_ARENA_DATA(chunk);
+	end = cur + chunkSz;
+
+	return alloc(sz, align);
+}
+
+void * osa_arena :: calloc(u32_t sz, u32_t align)
+{
+	void * p = alloc(sz, align);
+
+	if(NULL != p)
+		memset(p, 0, sz);
+	return p;
+}
+
+void osa_arena :: reset()
+{
+	osa_arenaChunk_t * chunk;
+
+	if(1 != isAlive)
+		return;
+
+	/* All the regular chunks go to 'spare', the big ones are freed. Then one spare becomes the current chunk */
+	while(NULL != (chunk = chunks))
+	{
+		chunks = chunk->next;
+		if(chunk->size == chunkSz)
+		{
+			chunk->next = spare;
+			spare = chunk;
+		}
+		else
+		{
+			reservedSz -= chunk->size;
+			osa_free(chunk);
+		}
+	}
+
+	chunks = spare;
+	spare = spare->next;
+	chunks->next = NULL;
+	cur = O_ARENA_DATA(chunks);
+	end = cur + chunkSz;
+	usedDone = 0;
+}
+
+void osa_arena :: release()
+{
+	osa_arenaChunk_t * chunk;
+
+	if(1 != isAlive)
+		return;
+
+	reset();
+	while(NULL != (chunk = spare))
+	{
+		spare = chunk->next;
+		reservedSz -= chunk->size;
+		osa_free(chunk);
+	}
+}
+
+u64_t osa_arena :: used()
+{
+	return (1 == isAlive) ? usedDone + (cur - O_ARENA_DATA(chunks)) : 0;
+}
+
+u64_t osa_arena :: reserved()
+{
+	return reservedSz;
+}
+
+/********************************************************
+*					P O O L
+*********************************************************/
+
+struct osa_poolMag_t
+{
+	osa_poolMag_t * next;				/* Link in the depot */
+	u32_t cnt;
+	void * objs[OSA_POOL_MAG_SZ];
+};
+
+/* Cache of one pool in one thread. alloc() pops from 'loaded', free() pushes to it. 'prev' is the other magazine, kept
+   so a thread that allocates and frees around a magazine boundary does not go to the depot every time */
+struct osa_poolCache_t
+{
+	osa_poolMag_t * loaded;
+	osa_poolMag_t * prev;
+	u32_t gen;
+};
+
+/* Pools alive, indexed by their slot. o_poolGen[] goes up every time a slot is taken */
+static osa_pool * o_pools[OSA_POOL_MAX];
+static u32_t o_poolGen[OSA_POOL_MAX];
+static std::atomic<u32_t> o_poolsLock(0);
+
+/* Per thread caches of all the pools, indexed by the slot of the pool */
+struct o_poolTls_t
+{
+	osa_poolCache_t * caches[OSA_POOL_MAX];
+	bool isGone; 						/* Thread is exiting. Pools are used without a cache from here on */
+
+	/* Give the objects of the exiting thread to the depots, so other threads can use them */
+	~o_poolTls_t()
+	{
+		osa_poolCache_t * c;
+
+		isGone = true;
+		o_lock(o_poolsLock);
+		for(int i = 0; i < OSA_POOL_MAX; i++)
+		{
+			if(NULL == (c = caches[i]))
+				continue;
+
+			if(NULL != o_pools[i] && o_poolGen[i] == c->gen)
+				o_pools[i]->cacheFlush(c);
+			else
+			{
+				osa_free(c->loaded);
+				osa_free(c->prev);
+			}
+			osa_free(c);
+			caches[i] = NULL;
+		}
+		o_unlock(o_poolsLock);
+	}
+};
+
+static thread_local o_poolTls_t o_poolTls;
+
+osa_pool :: osa_pool() : depotLock(0)
+{
+	objSz = 0;
+	align = 0;
+	maxObjs = 0;
+	isAlive = 0;
+	id = 0;
+	gen = 0;
+	fullMags = NULL;
+	emptyMags = NULL;
+	loose = NULL;
+	slabs = NULL;
+	slabCur = NULL;
+	slabEnd = NULL;
+	numObjs = 0;
+	reservedSz = 0;
+}
+
+osa_pool :: ~osa_pool()
+{
+	if(1 == isAlive)
+		destroy();
+}
+
+ret_e osa_pool :: create(u32_t objSz, u32_t maxObjs, u32_t align)
+{
+	char * func = "osa_pool::create";
+	u64_t sz;
+	u32_t i;
+
+	if(0 == objSz || 0 == align || 0 != (align & (align - 1)))
+	{
+		osa_loge("%s:error: objSz=%u, align=%u is not valid", func, objSz, align);
+		return OSA_ERR_BADPARAM;
+	}
+
+	if(1 == isAlive)
+	{
+		osa_loge("%s:error: pool %p is already created", func, this);
+		return OSA_ERR_BADPARAM;
+	}
+
+	if(align < sizeof(void *))
+		align = sizeof(void *);
+	sz = ((u64_t)objSz + align - 1) & ~(u64_t)(align - 1);
+	if(sizeof(void *) + align + sz * OSA_POOL_MAG_SZ > 0xFFFFFFFFull)		/* A slab must fit in osa_malloc */
+	{
+		osa_loge("%s:error: objSz=%u is too big for a pool", func, objSz);
+		return OSA_ERR_BADPARAM;
+	}
+
+	o_lock(o_poolsLock);
+	for(i = 0; i < OSA_POOL_MAX && NULL != o_pools[i]; i++)
+		;
+	if(OSA_POOL_MAX == i)
+	{
+		o_unlock(o_poolsLock);
+		osa_loge("%s:error: more than OSA_POOL_MAX (%d) pools", func, OSA_POOL_MAX);
+		return OSA_ERR_INSUFFMEM;
+	}
+	o_pools[i] = this;
+	if(0 == ++o_poolGen[i])				/* gen 0 never matches a cache */
+		++o_poolGen[i];
+	id = i;
+	gen = o_poolGen[i];
+	o_unlock(o_poolsLock);
+
+	this->objSz = (u32_t)sz;
+	this->align = align;
+	this->maxObjs = maxObjs;
+	fullMags = NULL;
+	emptyMags = NULL;
+	loose = NULL;
+	slabs = NULL;
+	slabCur = NULL;
+	slabEnd = NULL;
+	numObjs = 0;
+	reservedSz = 0;
+	isAlive = 1;
+
+	osa_logd("%s: pool %p created. objSz=%u, maxObjs=%u, align=%u", func, this, this->objSz, maxObjs, align);
+	return OSA_SUCCESS;
+}
+
+ret_e osa_pool :: destroy()
+{
+	char * func = "osa_pool::destroy";
+	osa_poolMag_t * m;
+	void * slab;
+
+	if(1 != isAlive)
+	{
+		osa_loge("%s:error: pool %p is not created", func, this);
+		return OSA_ERR_BADPARAM;
+	}
+
+	/* Caches still holding objects of this pool see the gen change and drop them */
+	o_lock(o_poolsLock);
+	o_pools[id] = NULL;
+	o_unlock(o_poolsLock);
+	gen = 0;
+
+	while(NULL != (m = fullMags))
+	{
+		fullMags = m->next;
+		osa_free(m);
+	}
+	while(NULL != (m = emptyMags))
+	{
+		emptyMags = m->next;
+		osa_free(m);
+	}
+	while(NULL != (slab = slabs))
+	{
+		slabs = *(void **)slab;
+		osa_free(slab);
+	}
+
+	loose = NULL;
+	slabCur = NULL;
+	slabEnd = NULL;
+	numObjs = 0;
+	reservedSz = 0;
+	isAlive = 0;
+	return OSA_SUCCESS;
+}
+
+/* Cache of the calling thread. NULL if the thread is exiting or the cache could not be allocated */
+osa_poolCache_t * osa_pool :: cacheGet()
+{
+	osa_poolCache_t * c;
+
+	if(o_poolTls.isGone)
+		return NULL;
+
+	c = o_poolTls.caches[id];
+	if(NULL != c && gen == c->gen)
+		return c;
+
+	if(NULL == c)
+	{
+		c = (osa_poolCache_t *)osa_malloc(sizeof(osa_poolCache_t));
+		if(NULL == c)
+			return NULL;
+		c->loaded = (osa_poolMag_t *)osa_malloc(sizeof(osa_poolMag_t));
+		c->prev = (osa_poolMag_t *)osa_malloc(sizeof(osa_poolMag_t));
+		if(NULL == c->loaded || NULL == c->prev)
+		{
+			osa_free(c->loaded);
+			osa_free(c->prev);
+			osa_free(c);
+			return NULL;
+		}
+		o_poolTls.caches[id] = c;
+	}
+
+	/* New cache, or the one of a destroyed pool that had the same slot. Its objects went away with that pool */
+	c->loaded->cnt = 0;
+	c->prev->cnt = 0;
+	c->gen = gen;
+	return c;
+}
+
+/* Move both magazines of a cache to the depot */
+void osa_pool :: cacheFlush(osa_poolCache_t * c)
+{
+	osa_poolMag_t * mags[2] = { c->loaded, c->prev };
+
+	o_lock(depotLock);
+	for(int i = 0; i < 2; i++)
+	{
+		if(0 != mags[i]->cnt)
+		{
+			mags[i]->next = fullMags;
+			fullMags = mags[i];
+		}
+		else
+		{
+			mags[i]->next = emptyMags;
+			emptyMags = mags[i];
+		}
+	}
+	o_unlock(depotLock);
+	c->loaded = NULL;
+	c->prev = NULL;
+}
+
+/* A new object from the current slab. Starts a new slab when it is used up. Call with depotLock held */
+void * osa_pool :: carve()
+{
+	u64_t slabSz = OSA_POOL_SLAB_SZ;
+	u8_t * slab;
+	void * obj;
+
+	if(0 != maxObjs && numObjs >= maxObjs)
+		return NULL;
+
+	if((u64_t)(slabEnd - slabCur) < objSz)
+	{
+		if(slabSz < sizeof(void *) + align + (u64_t)objSz * OSA_POOL_MAG_SZ)
+			slabSz = sizeof(void *) + align + (u64_t)objSz * OSA_POOL_MAG_SZ;
+
+		slab = (u8_t *)osa_malloc((u32_t)slabSz);
+		if(NULL == slab)
+			return NULL;
+
+		*(void **)slab = slabs;
+		slabs = slab;
+		slabCur = (u8_t *)(((uintptr_t)slab + sizeof(void *) + align - 1) & ~(uintptr_t)(align - 1));
+		slabEnd = slab + slabSz;
+		reservedSz += slabSz;
+	}
+
+	obj = slabCur;
+	slabCur += objSz;
+	numObjs++;
+	return obj;
+}
+
+/* alloc()/free() of a thread without a cache: one object at a time from/to the depot */
+void * osa_pool :: allocDirect()
+{
+	osa_poolMag_t * m;
+	void * obj;
+
+	o_lock(depotLock);
+	if(NULL != (obj = loose))
+		loose = *(void **)obj;
+	else if(NULL != (m = fullMags))
+	{
+		obj = m->objs[--m->cnt];
+		if(0 == m->cnt)
+		{
+			fullMags = m->next;
+			m->next = emptyMags;
+			emptyMags = m;
+		}
+	}
+	else
+		obj = carve();
+	o_unlock(depotLock);
+
+	return obj;
+}
+
+void osa_pool :: freeDirect(void * obj)
+{
+	o_lock(depotLock);
+	*(void **)obj = loose;
+	loose = obj;
+	o_unlock(depotLock);
+}
+
+void * osa_pool :: alloc()
+{
+	osa_poolCache_t * c = o_poolTls.caches[id];
+	osa_poolMag_t * m;
+
+	if(NULL != c && gen == c->gen && 0 != (m = c->loaded)->cnt)
+		return m->objs[--m->cnt];
+
+	return allocSlow(c);
+}
+
+void * osa_pool :: allocSlow(osa_poolCache_t * c)
+{
+	char * func = "osa_pool::alloc";
+	osa_poolMag_t * m;
+	void * obj;
+
+	if(1 != isAlive)
+	{
+		osa_loge("%s:error: pool %p is not created", func, this);
+		return NULL;
+	}
+
+	if(NULL == c || gen != c->gen)
+	{
+		c = cacheGet();
+		if(NULL == c)
+			return allocDirect();
+	}
+
+	if(0 == c->loaded->cnt)
+	{
+		m = c->loaded;
+		if(0 != c->prev->cnt)
+		{
+			c->loaded = c->prev;
+			c->prev = m;
+		}
+		else
+		{
+			o_lock(depotLock);
+			if(NULL != fullMags)
+			{
+				c->loaded = fullMags;
+				fullMags = fullMags->next;
+				m->next = emptyMags;
+				emptyMags = m;
+			}
+			else
+			{
+				/* Depot is dry. Fill the magazine with the loose objects and new ones from the slab */
+				while(NULL != loose && m->cnt < OSA_POOL_MAG_SZ)
+				{
+					m->objs[m->cnt++] = loose;
+					loose = *(void **)loose;
+				}
+				while(m->cnt < OSA_POOL_MAG_SZ && NULL != (obj = carve()))
+					m->objs[m->cnt++] = obj;
+			}
+			o_unlock(depotLock);
+
+			if(0 == c->loaded->cnt)
+			{
+				osa_logd("%s: pool %p has no free object. maxObjs=%u", func, this, maxObjs);
+				return NULL;
+			}
+		}
+	}
+
+	m = c->loaded;
+	return m->objs[--m->cnt];
+}
+
+void osa_pool :: free(void * obj)
+{
+	osa_poolCache_t * c = o_poolTls.caches[id];
+	osa_poolMag_t * m;
+
+	if(NULL != obj && NULL != c && gen == c->gen && OSA_POOL_MAG_SZ != (m = c->loaded)->cnt)
+	{
+		m->objs[m->cnt++] = obj;
+		return;
+	}
+
+	freeSlow(c, obj);
+}
+
+void osa_pool :: freeSlow(osa_poolCache_t * c, void * obj)
+{
+	char * func = "osa_pool::free";
+	osa_poolMag_t * m;
+
+	if(NULL == obj)
+		return;
+
+	if(1 != isAlive)
+	{
+		osa_loge("%s:error: pool %p is not created. obj=%p", func, this, obj);
+		return;
+	}
+
+	if(NULL == c || gen != c->gen)
+	{
+		c = cacheGet();
+		if(NULL == c)
+		{
+			freeDirect(obj);
+			return;
+		}
+	}
+
+	if(OSA_POOL_MAG_SZ == c->loaded->cnt)
+	{
+		m = c->loaded;
+		if(OSA_POOL_MAG_SZ != c->prev->cnt)
+		{
+			c->loaded = c->prev;
+			c->prev = m;
+		}
+		else
+		{
+			/* Both magazines are full. Give one to the depot and go on with an empty one */
+			o_lock(depotLock);
+			if(NULL != (m = emptyMags))
+			{
+				emptyMags = m->next;
+				c->prev->next = fullMags;
+				fullMags = c->prev;
+			}
+			o_unlock(depotLock);
+
+			if(NULL == m)
+			{
+				m = (osa_poolMag_t *)osa_malloc(sizeof(osa_poolMag_t));
+				if(NULL == m)
+				{
+					freeDirect(obj);
+					return;
+				}
+				o_lock(depotLock);
+				c->prev->next = fullMags;
+				fullMags = c->prev;
+				o_unlock(depotLock);
+			}
+
+			m->cnt = 0;
+			c->prev = c->loaded;
+			c->loaded = m;
+		}
+	}
+
+	m = c->loaded;
+	m->objs[m->cnt++] = obj;
+}
+
+u32_t osa_pool :: objSize()
+{
+	return objSz;
+}
+
+u64_t osa_pool :: reserved()
+{
+	u64_t sz;
+
+	o_lock(depotLock);
+	sz = reservedSz;
+	o_unlock(depotLock);
+	return sz;
+}
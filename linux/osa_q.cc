@@ -0,0 +1,553 @@
+#include "osa.h"
+#include <string.h>
+#include "osa_threads_internal.h"
+
+/********************************************************
+*					Q U E U E S
+*********************************************************/
+
+/* Bounded multi-producer/multi-consumer ring (sequence numbered slots).
+   Positions (head/tail) only ever grow. Slot for position 'pos' is cells[pos & mask].
+   A producer owns position 'pos' once it moves tail from pos to pos+1. It fills the slot and publishes it by setting
+   seq to pos+1. A consumer owns position 'pos' once it moves head from pos to pos+1. It empties the slot and hands it
+   back to the producer of the next lap by setting seq to pos+capacity.
+
+   Blocking consumers announce themselves in 'waiters' before their last check of the ring and then sleep on the futex
+   word 'wakeSeq'. A producer publishes its slot, then reads 'waiters' (with a full fence in between, pairing with the
+   consumer's atomic increment) and bumps 'wakeSeq' + wakes one thread only if somebody is sleeping. So the push path
+   costs no syscall while the consumers are busy.
+
+   OSA_Q_SPSC queues don't use the sequence numbers at all. Only the producer writes tail and only the consumer writes 
+   head, so publishing is a release store of the index. The waiting/wake up logic above is shared by both types.
+*/
+
+osa_q :: osa_q()
+{
+	cells = NULL;
+	mask = 0;
+	type = OSA_Q_MPMC;
+	isAlive = 0;
+	headCache = 0;
+	tailCache = 0;
+	tail.store(0, std::memory_order_relaxed);
+	head.store(0, std::memory_order_relaxed);
+	waiters.store(0, std::memory_order_relaxed);
+	wakeSeq.store(0, std::memory_order_relaxed);
+}
+
+osa_q :: osa_q(uint32_t maxSize, osa_q_type_e type)
+{
+	cells = NULL;
+	mask = 0;
+	this->type = OSA_Q_MPMC;
+	isAlive = 0;
+	headCache = 0;
+	tailCache = 0;
+	tail.store(0, std::memory_order_relaxed);
+	head.store(0, std::memory_order_relaxed);
+	waiters.store(0, std::memory_order_relaxed);
+	wakeSeq.store(0, std::memory_order_relaxed);
+
+	create(maxSize, type);
+}
+
+osa_q :: ~osa_q()
+{
+	if(1 == isAlive)
+	{
+		osa_free(cells);
+		cells = NULL;
+		isAlive = 0;
+	}
+}
+
+ret_e osa_q :: create(uint32_t maxSize, osa_q_type_e type)
+{
+	char * func = "osa_q::create";
+	u64_t cap = 2;
+
+	if(0 == maxSize || (OSA_Q_MPMC != type && OSA_Q_SPSC != type))
+	{
+		osa_loge("%s:error: maxSize=%u, type=%d is not valid", func, maxSize, type);
+		return OSA_ERR_BADPARAM;
+	}
+
+	if(1 == isAlive)
+	{
+		osa_loge("%s:error: queue %p is already created", func, this);
+		return OSA_ERR_BADPARAM;
+	}
+
+	while(cap < maxSize)
+		cap <<= 1;
+
+	if(cap * sizeof(osa_qCell_t) > 0xFFFFFFFFull)		/* osa_malloc takes a 32 bit size */
+	{
+		osa_loge("%s:error: maxSize=%u is too big", func, maxSize);
+		return OSA_ERR_BADPARAM;
+	}
+
+	cells = (osa_qCell_t *)osa_malloc((u32_t)(cap * sizeof(osa_qCell_t)));
+	if(NULL == cells)
+	{
+		osa_loge("%s:error: could not allocate %llu slots", func, (unsigned long long)cap);
+		return OSA_ERR_INSUFFMEM;
+	}
+
+	for(u64_t i=0; i<cap; i++)
+	{
+		cells[i].seq.store(i, std::memory_order_relaxed);
+		cells[i].data.obj = NULL;
+		cells[i].data.size = 0;
+	}
+
+	mask = cap - 1;
+	this->type = type;
+	tail.store(0, std::memory_order_relaxed);
+	head.store(0, std::memory_order_relaxed);
+	headCache = 0;
+	tailCache = 0;
+	isAlive = 1;
+
+	osa_logd("%s: queue %p created. maxSize=%u, capacity=%llu, type=%s", func, this, maxSize, (unsigned long long)cap,
+		(OSA_Q_SPSC == type) ? "SPSC" : "MPMC");
+	return OSA_SUCCESS;
+}
+
+ret_e osa_q :: destroy()
+{
+	if(1 == isAlive)
+	{
+		osa_free(cells);
+		cells = NULL;
+		mask = 0;
+		isAlive = 0;
+		osa_logd("osa_q::destroy: queue %p destroyed", this);
+	}
+
+	return OSA_SUCCESS;
+}
+
+ret_e osa_q :: push(q_data_t &obj)
+{
+	osa_qCell_t *cell;
+	u64_t pos;
+
+	if(1 != isAlive)
+	{
+		osa_loge("osa_q::push:error: queue %p is not created", this);
+		return OSA_ERR_BADPARAM;
+	}
+
+	if(OSA_Q_SPSC == type)
+		return spscPush(&obj, 1);
+
+	pos = tail.load(std::memory_order_relaxed);
+	for(;;)
+	{
+		cell = &cells[pos & mask];
+		u64_t seq = cell->seq.load(std::memory_order_acquire);
+		i64_t dif = (i64_t)seq - (i64_t)pos;
+
+		if(0 == dif)
+		{
+			/* Slot is free for this lap. Claim the position. On failure 'pos' is reloaded with the current tail */
+			if(tail.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+				break;
+		}
+		else if(dif < 0)
+		{
+			/* Slot still holds data from the previous lap */
+			return OSA_ERR_QFULL;
+		}
+		else
+		{
+			pos = tail.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->data = obj;
+	cell->seq.store(pos+1, std::memory_order_release);
+
+	wakeWaiters(1);
+
+	return OSA_SUCCESS;
+}
+
+ret_e osa_q :: pop(q_data_t &obj)
+{
+	osa_qCell_t *cell;
+	u64_t pos;
+
+	if(1 != isAlive)
+	{
+		osa_loge("osa_q::pop:error: queue %p is not created", this);
+		return OSA_ERR_BADPARAM;
+	}
+
+	if(OSA_Q_SPSC == type)
+	{
+		u32_t got;
+		return spscPop(&obj, 1, got);
+	}
+
+	pos = head.load(std::memory_order_relaxed);
+	for(;;)
+	{
+		cell = &cells[pos & mask];
+		u64_t seq = cell->seq.load(std::memory_order_acquire);
+		i64_t dif = (i64_t)seq - (i64_t)(pos+1);
+
+		if(0 == dif)
+		{
+			if(head.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+				break;
+		}
+		else if(dif < 0)
+		{
+			return OSA_ERR_QEMPTY;
+		}
+		else
+		{
+			pos = head.load(std::memory_order_relaxed);
+		}
+	}
+
+	obj = cell->data;
+	cell->seq.store(pos+mask+1, std::memory_order_release);
+
+	return OSA_SUCCESS;
+}
+
+ret_e osa_q :: pushBatch(q_data_t *objs, u32_t n)
+{
+	osa_qCell_t *cell;
+	u64_t pos;
+	u32_t i;
+	i64_t dif = 0;
+
+	if(1 != isAlive || NULL == objs || n > mask+1)
+	{
+		osa_loge("osa_q::pushBatch:error: queue %p, isAlive=%d, objs=%p, n=%u", this, isAlive, objs, n);
+		return OSA_ERR_BADPARAM;
+	}
+
+	if(0 == n)
+		return OSA_SUCCESS;
+
+	if(OSA_Q_SPSC == type)
+		return spscPush(objs, n);
+
+	pos = tail.load(std::memory_order_relaxed);
+	for(;;)
+	{
+		/* All 'n' slots after 'pos' must be free for this lap before the range can be claimed */
+		for(i=0; i<n; i++)
+		{
+			u64_t seq = cells[(pos+i) & mask].seq.load(std::memory_order_acquire);
+			dif = (i64_t)seq - (i64_t)(pos+i);
+			if(0 != dif)
+				break;
+		}
+
+		if(i == n)
+		{
+			if(tail.compare_exchange_weak(pos, pos+n, std::memory_order_relaxed))
+				break;
+		}
+		else if(dif < 0)
+		{
+			return OSA_ERR_QFULL;
+		}
+		else
+		{
+			pos = tail.load(std::memory_order_relaxed);
+		}
+	}
+
+	for(i=0; i<n; i++)
+	{
+		cell = &cells[(pos+i) & mask];
+		cell->data = objs[i];
+		cell->seq.store(pos+i+1, std::memory_order_release);
+	}
+
+	wakeWaiters(n);
+
+	return OSA_SUCCESS;
+}
+
+ret_e osa_q :: popBatch(q_data_t *objs, u32_t max, u32_t &got)
+{
+	osa_qCell_t *cell;
+	u64_t pos;
+	u32_t i, n;
+	i64_t dif = 0;
+
+	got = 0;
+
+	if(1 != isAlive || NULL == objs)
+	{
+		osa_loge("osa_q::popBatch:error: queue %p, isAlive=%d, objs=%p", this, isAlive, objs);
+		return OSA_ERR_BADPARAM;
+	}
+
+	/* Nothing could ever be claimed with max 0, the claim loop below would spin forever */
+	if(0 == max)
+	{
+		osa_loge("osa_q::popBatch:error: queue %p, max is 0", this);
+		return OSA_ERR_BADPARAM;
+	}
+
+	if(max > mask+1)
+		max = (u32_t)(mask+1);
+
+	if(OSA_Q_SPSC == type)
+		return spscPop(objs, max, got);
+
+	pos = head.load(std::memory_order_relaxed);
+	for(;;)
+	{
+		/* Count the published slots after 'pos' */
+		for(n=0; n<max; n++)
+		{
+			u64_t seq = cells[(pos+n) & mask].seq.load(std::memory_order_acquire);
+			dif = (i64_t)seq - (i64_t)(pos+n+1);
+			if(0 != dif)
+				break;
+		}
+
+		if(0 < n)
+		{
+			if(head.compare_exchange_weak(pos, pos+n, std::memory_order_relaxed))
+				break;
+		}
+		else if(dif < 0)
+		{
+			return OSA_ERR_QEMPTY;
+		}
+		else
+		{
+			pos = head.load(std::memory_order_relaxed);
+		}
+	}
+
+	for(i=0; i<n; i++)
+	{
+		cell = &cells[(pos+i) & mask];
+		objs[i] = cell->data;
+		cell->seq.store(pos+i+mask+1, std::memory_order_release);
+	}
+
+	got = n;
+	return OSA_SUCCESS;
+}
+
+/* spscPush : Producer side of OSA_Q_SPSC. All or nothing, like pushBatch */
+ret_e osa_q :: spscPush(q_data_t *objs, u32_t n)
+{
+	u64_t t = tail.load(std::memory_order_relaxed);
+
+	if(t + n - headCache > mask + 1)
+	{
+		headCache = head.load(std::memory_order_acquire);
+		if(t + n - headCache > mask + 1)
+			return OSA_ERR_QFULL;
+	}
+
+	for(u32_t i=0; i<n; i++)
+		cells[(t+i) & mask].data = objs[i];
+
+	tail.store(t+n, std::memory_order_release);
+
+	wakeWaiters(n);
+
+	return OSA_SUCCESS;
+}
+
+/* spscPop : Consumer side of OSA_Q_SPSC */
+ret_e osa_q :: spscPop(q_data_t *objs, u32_t max, u32_t &got)
+{
+	u64_t h = head.load(std::memory_order_relaxed);
+	u32_t n;
+
+	got = 0;
+
+	if(h == tailCache)
+	{
+		tailCache = tail.load(std::memory_order_acquire);
+		if(h == tailCache)
+			return OSA_ERR_QEMPTY;
+	}
+
+	n = (tailCache - h < max) ? (u32_t)(tailCache - h) : max;
+	for(u32_t i=0; i<n; i++)
+		objs[i] = cells[(h+i) & mask].data;
+
+	head.store(h+n, std::memory_order_release);
+
+	got = n;
+	return OSA_SUCCESS;
+}
+
+ret_e osa_q :: spscPeek(q_data_t &obj)
+{
+	u64_t h = head.load(std::memory_order_relaxed);
+
+	if(h == tailCache)
+	{
+		tailCache = tail.load(std::memory_order_acquire);
+		if(h == tailCache)
+			return OSA_ERR_QEMPTY;
+	}
+
+	obj = cells[h & mask].data;
+	return OSA_SUCCESS;
+}
+
+ret_e osa_q :: pop(q_data_t &obj, osa_q_wait_e wait)
+{
+	if(OSA_Q_NOWAIT == wait)
+		return pop(obj);
+
+	return waitPop(obj, -1);
+}
+
+ret_e osa_q :: popTimed(q_data_t &obj, u32_t timeoutUs)
+{
+	return waitPop(obj, (i64_t)timeoutUs);
+}
+
+/* wakeWaiters : Called by producers after publishing 'count' elements */
+void osa_q :: wakeWaiters(u32_t count)
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if(0 == waiters.load(std::memory_order_relaxed))
+		return;
+
+	wakeSeq.fetch_add(1, std::memory_order_release);
+	o_futexWake(&wakeSeq, (int)count);
+}
+
+/* waitPop : Spin, then sleep, till an element is popped or 'timeoutUs' (negative: forever) expires */
+ret_e osa_q :: waitPop(q_data_t &obj, i64_t timeoutUs)
+{
+	ret_e ret;
+	i64_t deadline = 0, remaining = -1;
+
+	for(int i=o_spinCount(OSA_Q_SPIN_COUNT); i>0; i--)
+	{
+		ret = pop(obj);
+		if(OSA_ERR_QEMPTY != ret)
+			return ret;
+		o_cpuRelax();
+	}
+
+	if(0 <= timeoutUs)
+		deadline = o_monotonicUs() + timeoutUs;
+
+	for(;;)
+	{
+		u32_t seq = wakeSeq.load(std::memory_order_acquire);
+
+		waiters.fetch_add(1, std::memory_order_seq_cst);
+
+		/* Re-check after announcing ourselves. A push that happened before the increment is seen here, a push after it
+		   will see waiters != 0 and change wakeSeq, so we can't miss it */
+		ret = pop(obj);
+		if(OSA_ERR_QEMPTY != ret)
+		{
+			waiters.fetch_sub(1, std::memory_order_relaxed);
+			return ret;
+		}
+
+		if(0 <= timeoutUs)
+		{
+			remaining = deadline - o_monotonicUs();
+			if(0 >= remaining)
+			{
+				waiters.fetch_sub(1, std::memory_order_relaxed);
+				return OSA_ERR_TIMEDOUT;
+			}
+		}
+
+		o_futexWait(&wakeSeq, seq, remaining);
+		waiters.fetch_sub(1, std::memory_order_relaxed);
+
+		ret = pop(obj);
+		if(OSA_ERR_QEMPTY != ret)
+			return ret;
+	}
+}
+
+ret_e osa_q :: peek(q_data_t &obj)
+{
+	osa_qCell_t *cell;
+	u64_t pos, seq;
+	q_data_t tmp;
+
+	if(1 != isAlive)
+	{
+		osa_loge("osa_q::peek:error: queue %p is not created", this);
+		return OSA_ERR_BADPARAM;
+	}
+
+	if(OSA_Q_SPSC == type)
+		return spscPeek(obj);
+
+	for(;;)
+	{
+		pos = head.load(std::memory_order_acquire);
+		cell = &cells[pos & mask];
+		seq = cell->seq.load(std::memory_order_acquire);
+
+		i64_t dif = (i64_t)seq - (i64_t)(pos+1);
+		if(dif < 0)
+			return OSA_ERR_QEMPTY;
+
+		if(0 == dif)
+		{
+			/* Copy, then make sure the slot was not popped (and refilled) while we were reading it */
+			tmp = cell->data;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if(seq == cell->seq.load(std::memory_order_relaxed))
+			{
+				obj = tmp;
+				return OSA_SUCCESS;
+			}
+		}
+	}
+}
+
+ret_e osa_q :: flush()
+{
+	q_data_t tmp;
+
+	if(1 != isAlive)
+	{
+		osa_loge("osa_q::flush:error: queue %p is not created", this);
+		return OSA_ERR_BADPARAM;
+	}
+
+	while(OSA_SUCCESS == pop(tmp))
+		;
+
+	return OSA_SUCCESS;
+}
+
+i32_t osa_q :: curSize()
+{
+	if(1 != isAlive)
+		return -1;
+
+	u64_t h = head.load(std::memory_order_acquire);
+	u64_t t = tail.load(std::memory_order_acquire);
+
+	if(t <= h)
+		return 0;
+	if(t - h > mask + 1)
+		return (i32_t)(mask + 1);
+
+	return (i32_t)(t - h);
+}
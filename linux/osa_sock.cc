@@ -12,8 +12,18 @@
 #include <netpacket/packet.h>
 #include <net/ethernet.h> /* the L2 protocols */
 #include <fcntl.h>
+#include <sys/epoll.h>
+#include <linux/errqueue.h>
+#include <sys/sendfile.h>
 #include "osa_sock_internal.h"
 
+#ifndef SO_ZEROCOPY 		/* Older libc headers */
+#define SO_ZEROCOPY 	60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 	0x4000000
+#endif
+
 char * osa_enum2str(osa_sockDomain_e domain)
 {
 	switch(domain)
@@ -51,6 +61,8 @@ char * osa_enum2str(osa_sockErr_e err)
 		case OSA_SOCKERR_ADDRINUSE 			:	return "SOCKERR_ADDRINUSE";
 		case OSA_SOCKERR_BADHANDLE 			:	return "SOCKERR_BADHANDLE";
 		case OSA_SOCKERR_SOCKINUSE 			:   return "SOCKERR_SOCKINUSE";
+		case OSA_SOCKERR_WOULDBLOCK 		:   return "SOCKERR_WOULDBLOCK";
+		case OSA_SOCKERR_CONNCLOSED 		:   return "SOCKERR_CONNCLOSED";
 		default 							:	return "SOCKERR_UNKNOWN";
 	}
 }
@@ -77,6 +89,7 @@ static osa_sockDomain_e o_unix2OsaSockDomain(sa_family_t unixDomain)
 		case AF_INET6	:	return OSA_AF_INET6;
 		case AF_NETLINK :	return OSA_AF_NETLINK;
 		case AF_PACKET	: 	return OSA_AF_PACKET;
+		default			:	return (osa_sockDomain_e)-1;
 	}	
 }
 
@@ -125,17 +138,32 @@ static osa_sockErr_e o_unix2osaSockErr()
 	}
 }
 
+/* o_recvErr : Handle failure of recv/recvfrom/accept. Asynchronous sockets run into EAGAIN every time they are drained,
+			   so it is reported as OSA_SOCKERR_WOULDBLOCK and not logged as an error */
+static ret_e o_recvErr(char * func, int sockFd, osa_sockErr_e &sockErr)
+{
+	if(EAGAIN == errno || EWOULDBLOCK == errno)
+	{
+		sockErr = OSA_SOCKERR_WOULDBLOCK;
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	osa_loge("%s:error: sockFd=%d, failed. errno=%s (%d). returning", func, sockFd, strerror(errno), errno);
+	sockErr = o_unix2osaSockErr();
+	return OSA_ERR_COREFUNCFAIL;
+}
+
 static void o_unix2OsaStruct(struct sockaddr_in &src, osa_sockAddrIn_t &dst)
 {
 	dst.domain = o_unix2OsaSockDomain(src.sin_family);
-	dst.port = src.sin_port;
+	dst.port = ntohs(src.sin_port);
 	osa_strcpy(dst.addr, inet_ntoa(src.sin_addr), SOCKADDR_MAX_STR_SZ);
 }
 
 static void o_unix2OsaStruct(struct sockaddr_in6 &src6, osa_sockAddrIn_t &dst6)
 {
 	dst6.domain = o_unix2OsaSockDomain(src6.sin6_family);
-	dst6.port = src6.sin6_port;
+	dst6.port = ntohs(src6.sin6_port);
 	if(NULL == inet_ntop(AF_INET6, (const void *)&src6.sin6_addr, dst6.addr, SOCKADDR_MAX_STR_SZ) )
 	{
 		osa_loge("o_unix2OsaStruct: inet_ntop failed: errno=%s (%d)", strerror(errno), errno);
@@ -158,6 +186,113 @@ static int o_osa2unixStruct(osa_sockAddrIn_t &src6, struct sockaddr_in6 &dst6 )
 	return inet_pton(dst6.sin6_family, (const char *)src6.addr, (void *)&dst6.sin6_addr);
 }
 
+/********************************************************
+*			B I N A R Y    A D D R E S S E S
+*********************************************************/
+
+/* o_sockAddrFinish : Make an address just written by the kernel ('len' bytes) a canonical handle: rest of the bytes and 
+					  the IPv6 flow label are zeroed, so equal addresses stay equal byte by byte */
+static void o_sockAddrFinish(osa_sockAddr_t &addr, socklen_t len)
+{
+	if(len > OSA_SOCKADDR_BIN_SZ || len < sizeof(sa_family_t))
+	{
+		addr.len = 0; 	/* Not an IP address (e.g. unix domain), it doesn't fit */
+		return;
+	}
+
+	memset(addr.bin + len, 0, OSA_SOCKADDR_BIN_SZ - len);
+	if(AF_INET6 == ((struct sockaddr *)addr.bin)->sa_family)
+		((struct sockaddr_in6 *)addr.bin)->sin6_flowinfo = 0;
+	addr.len = len;
+}
+
+ret_e osa_sockAddrResolve(osa_sockAddrIn_t &src, osa_sockAddr_t &dst)
+{
+	memset(&dst, 0, sizeof(dst));
+
+	switch(src.domain)
+	{
+		case OSA_AF_INET:
+			if(1 != o_osa2unixStruct(src, *(struct sockaddr_in *)dst.bin))
+				break;
+			dst.len = sizeof(struct sockaddr_in);
+			return OSA_SUCCESS;
+
+		case OSA_AF_INET6:
+			if(1 != o_osa2unixStruct(src, *(struct sockaddr_in6 *)dst.bin))
+				break;
+			dst.len = sizeof(struct sockaddr_in6);
+			return OSA_SUCCESS;
+
+		default:
+			break;
+	}
+
+	osa_loge("osa_sockAddrResolve:error: invalid address: domain=%s, addr=%s", osa_enum2str(src.domain), src.addr);
+	memset(&dst, 0, sizeof(dst));
+	return OSA_ERR_BADPARAM;
+}
+
+ret_e osa_sockAddrToStr(osa_sockAddr_t &src, osa_sockAddrIn_t &dst)
+{
+	if(sizeof(struct sockaddr_in) == src.len && AF_INET == ((struct sockaddr *)src.bin)->sa_family)
+	{
+		o_unix2OsaStruct(*(struct sockaddr_in *)src.bin, dst);
+		return OSA_SUCCESS;
+	}
+
+	if(sizeof(struct sockaddr_in6) == src.len && AF_INET6 == ((struct sockaddr *)src.bin)->sa_family)
+	{
+		o_unix2OsaStruct(*(struct sockaddr_in6 *)src.bin, dst);
+		return OSA_SUCCESS;
+	}
+
+	osa_loge("osa_sockAddrToStr:error: handle doesn't hold an IP address (len=%u)", src.len);
+	return OSA_ERR_BADPARAM;
+}
+
+bool osa_sockAddrEqual(const osa_sockAddr_t &a, const osa_sockAddr_t &b)
+{
+	return a.len == b.len && 0 == memcmp(a.bin, b.bin, a.len);
+}
+
+u32_t osa_sockAddrHash(const osa_sockAddr_t &addr)
+{
+	u32_t h = 2166136261u;
+	u32_t i;
+
+	for(i = 0; i < addr.len && i < OSA_SOCKADDR_BIN_SZ; i++)
+	{
+		h ^= addr.bin[i];
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+/* o_pktPool : Descriptors of the queued packets of all the sockets. One pool for the process, so an idle socket costs
+				nothing and a busy one takes only what it has queued. Senders allocate, the event loops free, which the
+				thread caches of osa_pool are made for. Never destroyed: loop threads may still free while the process exits */
+static osa_pool * o_pktPoolCreate()
+{
+	osa_pool * pool = new osa_pool;
+
+	if(OSA_SUCCESS != pool->create(sizeof(pktData_t)))
+	{
+		osa_loge("o_pktPoolCreate:error: packet descriptor pool could not be created");
+		delete pool;
+		return NULL;
+	}
+
+	return pool;
+}
+
+static osa_pool * o_pktPool()
+{
+	static osa_pool * pool = o_pktPoolCreate();
+	return pool;
+}
+
 ret_e osa_socket::getSockAddr(osa_sockAddrIn_t &sAddrOsa)
 {
 	char * func = "osa_socket:getSockAddr";
@@ -253,11 +388,38 @@ ret_e osa_socket::getsockPeerAddr(osa_sockAddrIn_t &peerAddrOsa)
 	return OSA_SUCCESS;
 }
 
+osa_socket :: osa_socket()
+{
+	sockFd = -1;
+	isAsync = 0;
+	sendCompleteCb = NULL;
+	recvReadyCb = NULL;
+	appData = NULL;
+	evLoop = NULL;
+	evPrev = NULL;
+	evNext = NULL;
+	txScheduled.store(0, std::memory_order_relaxed);
+	txCnt = 0;
+	txIdx = 0;
+	txOff = 0;
+	ioCtx = NULL;
+	zcMode = 0;
+	zcSeq = 0;
+	zcDone = 0;
+	zcHead = NULL;
+	zcTail = NULL;
+}
+
 void osa_socket :: setSockFd(int newSockFd)
 {
 	sockFd = newSockFd;
 }
 
+osa_eventLoop * osa_socket :: getEventLoop()
+{
+	return evLoop;
+}
+
 
 
 ret_e osa_socket::create(osa_sockDomain_e domain, osa_sockType_e type, i32_t proto, osa_sockErr_e &sockErr)
@@ -268,11 +430,12 @@ ret_e osa_socket::create(osa_sockDomain_e domain, osa_sockType_e type, i32_t pro
 
 	/*--*----*----*----*----*----*----*----*----*----*----*----*----*----*----*----*--
 	--*----*----*----*----*----*----*----*----*----*----*----*----*----*----*----*--*/
-	osa_logd("%s: entered. domain=%s, type=%s, proto=%d", osa_enum2str(domain), osa_enum2str(type), proto);
+	osa_logd("%s: entered. domain=%s, type=%s, proto=%d", func, osa_enum2str(domain), osa_enum2str(type), proto);
 	if (OSA_AF_UNIX != domain && OSA_AF_INET != domain && OSA_AF_INET6 != domain
 		&& OSA_AF_NETLINK != domain && OSA_AF_PACKET != domain)
 	{
 		osa_loge("%s:error: domain paramater incorrect: %d. Returning", func, domain);
+		sockErr = OSA_SOCKERR_INVAL;
 		return OSA_ERR_BADPARAM;
 	}
 
@@ -280,6 +443,7 @@ ret_e osa_socket::create(osa_sockDomain_e domain, osa_sockType_e type, i32_t pro
 		&& OSA_SOCK_RAW != type )
 	{
 		osa_loge("%s:error: type paramater incorrect: %d. Returning", func, type);
+		sockErr = OSA_SOCKERR_INVAL;
 		return OSA_ERR_BADPARAM;	
 	}
 
@@ -311,6 +475,7 @@ ret_e osa_socket::create(osa_sockDomain_e domain, osa_sockType_e type, i32_t pro
 	}
 
 	osa_logi("%s: success. sockFd=%d, returning", func, sockFd);
+	return ret;
 }
 
 ret_e osa_socket :: makeAsynchronous(osa_sendCompleteCb sendCompleteCb, osa_recvReadyCb recvReadyCb, void * appData)
@@ -319,13 +484,13 @@ ret_e osa_socket :: makeAsynchronous(osa_sendCompleteCb sendCompleteCb, osa_recv
 
 	if(NULL==sendCompleteCb || NULL==recvReadyCb)
 	{
-		osa_loge("%s: sockFd=%d, callback function pointer/s passed are NULL. sendCompleteCb=%x, recvReadyCb=%x", func, sockFd,
-			sendCompleteCb, recvReadyCb);
+		osa_loge("%s: sockFd=%d, callback function pointer/s passed are NULL. sendCompleteCb=%p, recvReadyCb=%p", func, sockFd,
+			(void *)sendCompleteCb, (void *)recvReadyCb);
 		return OSA_ERR_BADPARAM;
 	}
 
-	osa_logd("%s: Entered. sockFd=%d, sendCompleteCb=%x, recvReadyCb=%x, appdata=%x", func, 
-		sockFd, sendCompleteCb, recvReadyCb, appData);
+	osa_logd("%s: Entered. sockFd=%d, sendCompleteCb=%p, recvReadyCb=%p, appdata=%p", func, 
+		sockFd, (void *)sendCompleteCb, (void *)recvReadyCb, appData);
 
 	int flags = fcntl(sockFd, F_GETFL, 0);
 
@@ -339,17 +504,65 @@ ret_e osa_socket :: makeAsynchronous(osa_sendCompleteCb sendCompleteCb, osa_recv
 
 	if(0 != fcntl(sockFd, F_SETFL, flags) )
 	{
-		osa_loge("%s: sockFd=%d, error: fcntl F_SETFL failed. Can't make the socket asynchronous");
+		osa_loge("%s: sockFd=%d, error: fcntl F_SETFL failed. Can't make the socket asynchronous", func, sockFd);
 		return OSA_ERR_COREFUNCFAIL;
 	}
 
+	/* Listeners never send: no send queue for them. Call listen() before makeAsynchronous to get that */
+	int listening = 0;
+	socklen_t optLen = sizeof(listening);
+	if(0 != getsockopt(sockFd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &optLen))
+		listening = 0;
+
+	if(!listening && 0 > sockQ.curSize() && OSA_SUCCESS != sockQ.create(OSA_SOCK_Q_SIZE))	/* Created only the first time */
+	{
+		osa_loge("%s: sockFd=%d, error: send queue could not be created", func, sockFd);
+		return OSA_ERR_INSUFFMEM;
+	}
+
 	this->sendCompleteCb = sendCompleteCb;
 	this->recvReadyCb = recvReadyCb;
 	this->appData = appData;
+	isAsync = 1;
 	osa_logi("%s: sockFd=%d, socket is set to be asynchronous successfully", func, sockFd);
 	return OSA_SUCCESS;
 }
 
+ret_e osa_socket :: setReusePort(osa_sockErr_e &sockErr)
+{
+	char * func = "osa_socket::setReusePort";
+	int on = 1;
+
+	if(0 != setsockopt(sockFd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)))
+	{
+		osa_loge("%s:error: sockFd=%d, setsockopt(SO_REUSEPORT) failed. errno=%s (%d)", func, sockFd, strerror(errno), errno);
+		sockErr = o_unix2osaSockErr();
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	osa_logd("%s: sockFd=%d, SO_REUSEPORT set", func, sockFd);
+	sockErr = OSA_SOCK_SUCCESS;
+	return OSA_SUCCESS;
+}
+
+ret_e osa_socket :: setZeroCopy(osa_sockErr_e &sockErr)
+{
+	char * func = "osa_socket::setZeroCopy";
+	int on = 1;
+
+	if(0 != setsockopt(sockFd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)))
+	{
+		osa_loge("%s:error: sockFd=%d, setsockopt(SO_ZEROCOPY) failed. errno=%s (%d)", func, sockFd, strerror(errno), errno);
+		sockErr = o_unix2osaSockErr();
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	zcMode = 1;
+	osa_logd("%s: sockFd=%d, SO_ZEROCOPY set", func, sockFd);
+	sockErr = OSA_SOCK_SUCCESS;
+	return OSA_SUCCESS;
+}
+
 ret_e osa_socket::bind(osa_sockAddrIn_t &sockAddr, osa_sockErr_e &sockErr)
 {
 	char * func="osa_socket::bind";
@@ -366,6 +579,7 @@ ret_e osa_socket::bind(osa_sockAddrIn_t &sockAddr, osa_sockErr_e &sockErr)
 	if (OSA_AF_INET != sockAddr.domain && OSA_AF_INET6 != sockAddr.domain)
 	{
 		osa_loge("%s: sockFd=%d, error: Wrong domain provided: %d. Use this API for IPv4 and IPv6 only. returning", func, sockFd, sockAddr.domain);
+		sockErr = OSA_SOCKERR_INVAL;
 		return OSA_ERR_BADPARAM;
 	}
 	/*--*----*----*----*----*----*----*----*----*----*----*----*----*----*----*----*--
@@ -382,6 +596,7 @@ ret_e osa_socket::bind(osa_sockAddrIn_t &sockAddr, osa_sockErr_e &sockErr)
 			if(1 != result)
 			{
 				osa_loge("%s: sockFd=%d, error: Invalid IP address:%s. inet_pton returned %d. returning", func, sockFd, sockAddr.addr, result);
+				sockErr = OSA_SOCKERR_INVAL;
 				return OSA_ERR_BADPARAM;
 			}
 
@@ -413,6 +628,7 @@ ret_e osa_socket::bind(osa_sockAddrIn_t &sockAddr, osa_sockErr_e &sockErr)
 			if(1 != result)
 			{
 				osa_loge("%s:error: sockFd=%d, Invalid IP address:%s. inet_pton returned %d. returning", func, sockFd, sockAddr.addr, result);
+				sockErr = OSA_SOCKERR_INVAL;
 				return OSA_ERR_BADPARAM;
 			}
 
@@ -447,6 +663,29 @@ ret_e osa_socket::bind(osa_sockAddrIn_t &sockAddr, osa_sockErr_e &sockErr)
 }
 
 
+ret_e osa_socket::bind(osa_sockAddr_t &sockAddr, osa_sockErr_e &sockErr)
+{
+	char * func = "osa_socket::bind";
+
+	if(0 == sockAddr.len)
+	{
+		osa_loge("%s:error: sockFd=%d, address is not resolved. returning", func, sockFd);
+		sockErr = OSA_SOCKERR_INVAL;
+		return OSA_ERR_BADPARAM;
+	}
+
+	if(0 != ::bind(sockFd, (struct sockaddr *)sockAddr.bin, sockAddr.len))
+	{
+		osa_loge("%s:error: socket bind failed. sockFd=%d, errno=%s (%d). returning", func, sockFd, strerror(errno), errno);
+		sockErr = o_unix2osaSockErr();
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	osa_logi("%s: success. sockFd=%d, returning", func, sockFd);
+	sockErr = OSA_SOCK_SUCCESS;
+	return OSA_SUCCESS;
+}
+
 ret_e osa_socket::bind(osa_sockAddrGeneric_t &sockAddr, osa_sockErr_e &sockErr)
 {
 	char * func="osa_socket::bind";
@@ -462,12 +701,13 @@ ret_e osa_socket::bind(osa_sockAddrGeneric_t &sockAddr, osa_sockErr_e &sockErr)
 	if (OSA_AF_UNIX != sockAddr.domain && OSA_AF_NETLINK != sockAddr.domain && OSA_AF_PACKET != sockAddr.domain)
 	{
 		osa_loge("%s: sockFd=%d, error: Wrong domain provided: %d. Use the API for UNIX|NETLINK|PACKET domain. Returning", func, sockFd, sockAddr.domain);
+		sockErr = OSA_SOCKERR_INVAL;
 		return OSA_ERR_BADPARAM;
 	}
 
 	if(NULL == sockAddr.addr || 0 == sockAddr.addrLen)
 	{
-		osa_loge("%s: sockFd=%d, error: Bad input parameters. addr=%x, addrLen=%d", func, sockFd, sockAddr.addr, sockAddr.addrLen);
+		osa_loge("%s: sockFd=%d, error: Bad input parameters. addr=%p, addrLen=%d", func, sockFd, sockAddr.addr, sockAddr.addrLen);
 	}
 	/*--*----*----*----*----*----*----*----*----*----*----*----*----*----*----*----*--
 	--*----*----*----*----*----*----*----*----*----*----*----*----*----*----*----*--*/
@@ -480,8 +720,9 @@ ret_e osa_socket::bind(osa_sockAddrGeneric_t &sockAddr, osa_sockErr_e &sockErr)
 		{
 			if(sizeof(struct sockaddr_un) != sockAddr.addrLen)
 			{
-				osa_loge("%s:error: sockFd=%d, struct sockaddr_un expected as addr with len=%d, But addrLen=%d. returning", func,  sockFd,
+				osa_loge("%s:error: sockFd=%d, struct sockaddr_un expected as addr with len=%zu, But addrLen=%d. returning", func,  sockFd,
 					sizeof(struct sockaddr_un), sockAddr.addrLen);
+				sockErr = OSA_SOCKERR_INVAL;
 				return OSA_ERR_BADPARAM;
 			}
 			sAddrUn = (struct sockaddr_un *)sockAddr.addr;
@@ -512,8 +753,9 @@ ret_e osa_socket::bind(osa_sockAddrGeneric_t &sockAddr, osa_sockErr_e &sockErr)
 		{
 			if(sizeof(struct sockaddr_ll) != sockAddr.addrLen)
 			{
-				osa_loge("%s:error: sockFd=%d, struct sockaddr_ll expected as addr with len=%d, But addrLen=%d. returning", func, sockFd,
+				osa_loge("%s:error: sockFd=%d, struct sockaddr_ll expected as addr with len=%zu, But addrLen=%d. returning", func, sockFd,
 					sizeof(struct sockaddr_un), sockAddr.addrLen);
+				sockErr = OSA_SOCKERR_INVAL;
 				return OSA_ERR_BADPARAM;
 			}
 			sAddrPkt = (struct sockaddr_ll *)sockAddr.addr;
@@ -598,14 +840,14 @@ ret_e osa_socket :: accept(osa_socket &newStreamSock, osa_sockErr_e &sockErr)
 
 	osa_logd("%s: entered, sockFd=%d", func, sockFd);
 
-	newSockFd = ::accept(sockFd, &sAddr, &sockLen);
+	if(NULL != ioCtx)
+		newSockFd = evLoop->uringAccept(*this); 	/* io_uring loop has accepted it already */
+	else
+		newSockFd = ::accept(sockFd, &sAddr, &sockLen);
 
 	if(-1 == newSockFd)
 	{
-		osa_loge("%s:error: sockFd=%d, socket accept failed. errno=%s (%d)", func, sockFd, strerror(errno), errno);
-
-		sockErr = o_unix2osaSockErr();
-		ret = OSA_ERR_COREFUNCFAIL;	
+		ret = o_recvErr(func, sockFd, sockErr);
 	}
 	else
 	{
@@ -664,6 +906,7 @@ ret_e osa_socket :: accept(osa_socket &newStreamSock, osa_sockErr_e &sockErr)
 	}
 
 	osa_logd("%s: sockFd=%d, success. returning", func, sockFd);
+	return ret;
 }
 
 ret_e osa_socket :: connect(osa_sockAddrIn_t &rAddr, osa_sockErr_e &sockErr)
@@ -686,6 +929,7 @@ ret_e osa_socket :: connect(osa_sockAddrIn_t &rAddr, osa_sockErr_e &sockErr)
 			if(1 != result)
 			{
 				osa_loge("%s:error: sockFd=%d, Invalid remote IP address:%s. inet_pton returned %d. returning", func, sockFd, rAddr.addr, result);
+				sockErr = OSA_SOCKERR_INVAL;
 				return OSA_ERR_BADPARAM;
 			}
 
@@ -701,6 +945,7 @@ ret_e osa_socket :: connect(osa_sockAddrIn_t &rAddr, osa_sockErr_e &sockErr)
 			if(1 != result)
 			{
 				osa_loge("%s:error: sockFd=%d, Invalid remote IP address:%s. inet_pton returned %d. returning", func, sockFd, rAddr.addr, result);
+				sockErr = OSA_SOCKERR_INVAL;
 				return OSA_ERR_BADPARAM;
 			}
 
@@ -726,6 +971,30 @@ ret_e osa_socket :: connect(osa_sockAddrIn_t &rAddr, osa_sockErr_e &sockErr)
 }
 
 
+ret_e osa_socket :: connect(osa_sockAddr_t &rAddr, osa_sockErr_e &sockErr)
+{
+	char * func = "osa_socket::connect";
+
+	if(0 == rAddr.len)
+	{
+		osa_loge("%s:error: sockFd=%d, address is not resolved. returning", func, sockFd);
+		sockErr = OSA_SOCKERR_INVAL;
+		return OSA_ERR_BADPARAM;
+	}
+
+	if(-1 == ::connect(sockFd, (struct sockaddr *)rAddr.bin, rAddr.len))
+	{
+		osa_loge("%s:error: sockFd=%d, socket connect failed. errno=%s (%d). returning", func, sockFd, strerror(errno), errno);
+		sockErr = o_unix2osaSockErr();
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	sockErr = OSA_SOCK_SUCCESS;
+	osa_logd("%s: sockFd=%d, socket connect successful. returning", func, sockFd);
+	return OSA_SUCCESS;
+}
+
+
 ret_e osa_socket :: connect(osa_sockAddrGeneric_t &rAddr, osa_sockErr_e &sockErr)
 {
 	char * func = "osa_socket::connect";
@@ -743,8 +1012,9 @@ ret_e osa_socket :: connect(osa_sockAddrGeneric_t &rAddr, osa_sockErr_e &sockErr
 
 			if(0 == rAddr.addrLen || NULL == rAddr.addr)
 			{
-				osa_loge("%s:error: sockFd=%d, sockaddr_un(len=%d) expected. Instead passed addr is %d, len=%d. returning", func, 
+				osa_loge("%s:error: sockFd=%d, sockaddr_un(len=%zu) expected. Instead passed addr is %p, len=%d. returning", func, 
 					 sockFd, sizeof(struct sockaddr_un), rAddr.addr, rAddr.addrLen);
+				sockErr = OSA_SOCKERR_INVAL;
 				return OSA_ERR_BADPARAM;
 			}
 
@@ -775,27 +1045,26 @@ ret_e osa_socket :: send(void * buf, i32_t len, i32_t flags, osa_sockErr_e &sock
 
 	if(NULL == buf || 0 == len)
 	{
-		osa_loge("%s:error: sockFd=%d, param error: buf=%x, len=%d. returning", func, sockFd, buf, len);
+		osa_loge("%s:error: sockFd=%d, param error: buf=%p, len=%d. returning", func, sockFd, buf, len);
+		sockErr = OSA_SOCKERR_INVAL;
 		return OSA_ERR_BADPARAM;
 	}
 
-	osa_logd("%s: entered. sockFd=%d, buf=%x, len=%d, flags=%x", func, sockFd, buf, len, flags);
+	osa_logd("%s: entered. sockFd=%d, buf=%p, len=%d, flags=%x", func, sockFd, buf, len, flags);
 
 	if(1 == isAsync)
 	{
-		pktData_t *pktData = (pktData_t *)malloc(sizeof(pktData_t)); /* This needs to be freed in receiver function OR socket destructor */
-		pktData->buf = buf;
+		pktData_t *pktData = pktGet(sockErr); /* Given back by the event loop once it is sent */
+		if(NULL == pktData)
+			return OSA_ERR_QFULL;
+		pktData->iov[0].buf = buf;
+		pktData->iov[0].len = len;
+		pktData->iovCnt = 1;
 		pktData->len = len;
+		pktData->flags = flags;
 		pktData->isSendTo = false;
 
-		q_data_t qObj;
-		qObj.obj = pktData;
-		qObj.size = sizeof(pktData);
-
-		sockQ.push(qObj);
-		osa_logi("%s: sockFd=%d, data pushed for async send. returning", func, sockFd);
-		sockErr =  OSA_SOCKERR_INPROGRESS;
-		return OSA_SUCCESS;
+		return queuePkt(pktData, sockErr);
 	}
 
 	/* TO DO: Flags is unused right now */
@@ -814,78 +1083,209 @@ ret_e osa_socket :: send(void * buf, i32_t len, i32_t flags, osa_sockErr_e &sock
 }
 
 
-ret_e osa_socket :: sendto(void *buf, i32_t len, i32_t flags, osa_sockAddrIn_t &rAddr, osa_sockErr_e &sockErr)
+ret_e osa_socket :: sendv(osa_iovec_t *iov, i32_t iovCnt, i32_t flags, osa_sockErr_e &sockErr)
 {
-	char *func = "osa_socket::sendto";
-	int result, unixDomain;
-	ret_e ret=OSA_SUCCESS;
+	char * func = "osa_socket::sendv";
+	struct iovec kIov[OSA_SOCK_IOV_MAX];
+	struct msghdr msg;
+	i32_t i, total = 0;
+	ssize_t result;
 
-	if(NULL == buf || 0 == len)
+	if(NULL == iov || 0 >= iovCnt || OSA_SOCK_IOV_MAX < iovCnt)
 	{
-		osa_loge("%s:error: sockFd=%d, param error: buf=%x, len=%d. returning", func, sockFd, buf, len);
+		osa_loge("%s:error: sockFd=%d, param error: iov=%p, iovCnt=%d (max %d). returning", func, sockFd, iov, iovCnt,
+			OSA_SOCK_IOV_MAX);
+		sockErr = OSA_SOCKERR_INVAL;
 		return OSA_ERR_BADPARAM;
 	}
 
-	osa_logd("%s: entered. sockFd=%d, buf=%x, len=%d, flags=%x, rAddr.domain=%s, rAddr.addr=%s, rAddr.port=%d", func, 
-		 sockFd, buf, len, flags, osa_enum2str(rAddr.domain), rAddr.addr, rAddr.port);
+	for(i = 0; i < iovCnt; i++)
+	{
+		if(NULL == iov[i].buf || 0 > iov[i].len)
+		{
+			osa_loge("%s:error: sockFd=%d, param error: segment %d: buf=%p, len=%d. returning", func, sockFd, i, iov[i].buf,
+				iov[i].len);
+			sockErr = OSA_SOCKERR_INVAL;
+			return OSA_ERR_BADPARAM;
+		}
+		total += iov[i].len;
+	}
+
+	if(0 == total)
+	{
+		osa_loge("%s:error: sockFd=%d, param error: all %d segments are empty. returning", func, sockFd, iovCnt);
+		sockErr = OSA_SOCKERR_INVAL;
+		return OSA_ERR_BADPARAM;
+	}
+
+	osa_logd("%s: entered. sockFd=%d, iovCnt=%d, total=%d, flags=%x", func, sockFd, iovCnt, total, flags);
 
 	if(1 == isAsync)
 	{
-		pktData_t *pktData = (pktData_t *)malloc(sizeof(pktData_t)); /* This needs to be freed in receiver function OR socket destructor */
-		pktData->buf = buf;
-		pktData->len = len;
-		pktData->isSendTo = true;
-		pktData->ipAddr = rAddr;
+		pktData_t *pktData = pktGet(sockErr); /* Given back by the event loop once it is sent */
+		if(NULL == pktData)
+			return OSA_ERR_QFULL;
+
+		memcpy(pktData->iov, iov, iovCnt * sizeof(osa_iovec_t));
+		pktData->iovCnt = iovCnt;
+		pktData->len = total;
+		pktData->flags = flags;
+		pktData->isSendTo = false;
 
-		q_data_t qObj;
-		qObj.obj = pktData;
-		qObj.size = sizeof(pktData);
+		return queuePkt(pktData, sockErr);
+	}
 
-		sockQ.push(qObj);
-		osa_logi("%s: sockFd=%d, data pushed for async send. returning", func, sockFd);
-		sockErr =  OSA_SOCKERR_INPROGRESS;
-		return OSA_SUCCESS;
+	for(i = 0; i < iovCnt; i++)
+	{
+		kIov[i].iov_base = iov[i].buf;
+		kIov[i].iov_len = iov[i].len;
 	}
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = kIov;
+	msg.msg_iovlen = iovCnt;
 
-	switch(rAddr.domain)
+	result = ::sendmsg(sockFd, &msg, flags);
+	if(-1 == result)
 	{
-		case OSA_AF_INET:
-		struct sockaddr_in rAddrIn;
-		result = o_osa2unixStruct(rAddr, rAddrIn);
-		if(1 != result)
+		osa_loge("%s:error: sockFd=%d, socket blocking-send failed. errorno=%s (%d). returning", func, sockFd, strerror(errno), errno);
+		sockErr = o_unix2osaSockErr();
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	osa_logd("%s: success. sockFd=%d, %d bytes sent. returning", func, sockFd, (int)result);
+
+	return OSA_SUCCESS;
+}
+
+
+ret_e osa_socket :: sendFile(osa_fileHd_t &hd, i64_t offset, i64_t len, osa_sockErr_e &sockErr)
+{
+	char * func = "osa_socket::sendFile";
+	int fileFd = fileno(&hd);
+	off_t off = (off_t)offset;
+	ssize_t result;
+
+	if(0 > fileFd || 0 > offset || 0 >= len)
+	{
+		osa_loge("%s:error: sockFd=%d, param error: fileFd=%d, offset=%lld, len=%lld. returning", func, sockFd, fileFd, 
+			(long long)offset, (long long)len);
+		sockErr = OSA_SOCKERR_INVAL;
+		return OSA_ERR_BADPARAM;
+	}
+
+	osa_logd("%s: entered. sockFd=%d, fileFd=%d, offset=%lld, len=%lld", func, sockFd, fileFd, (long long)offset, (long long)len);
+
+	if(1 == isAsync)
+	{
+		pktData_t *pktData;
+
+		if(0x7FFFFFFF < len)
 		{
-			osa_loge("%s:error: sockFd=%d, Invalid remote IP address:%s. inet_pton returned %d. returning", func, sockFd, rAddr.addr, result);
+			osa_loge("%s:error: sockFd=%d, len=%lld is more than 2 GB. returning", func, sockFd, (long long)len);
+			sockErr = OSA_SOCKERR_INVAL;
 			return OSA_ERR_BADPARAM;
 		}
 
-		result = ::sendto(sockFd, buf, len, 0, (struct sockaddr *)&rAddrIn, sizeof(struct sockaddr_in));
-		break;
+		pktData = pktGet(sockErr); /* Given back by the event loop once it is sent */
+		if(NULL == pktData)
+			return OSA_ERR_QFULL;
+		pktData->iovCnt = 0;
+		pktData->len = (i32_t)len;
+		pktData->flags = 0;
+		pktData->isSendTo = false;
+		pktData->isFile = true;
+		pktData->fileFd = fileFd;
+		pktData->fileOff = offset;
 
-		case OSA_AF_INET6:
-		struct sockaddr_in rAddrIn6;
-		result = o_osa2unixStruct(rAddr, rAddrIn6);
-		if(1 != result)
+		return queuePkt(pktData, sockErr);
+	}
+
+	while(0 < len)
+	{
+		result = ::sendfile(sockFd, fileFd, &off, (size_t)len);
+		if(-1 == result && EINTR == errno)
+			continue;
+		if(0 == result)
 		{
-			osa_loge("%s:error: sockFd=%d, Invalid remote IP address:%s. inet_pton returned %d. returning", func, sockFd, rAddr.addr, result);
-			return OSA_ERR_BADPARAM;
+			osa_loge("%s:error: sockFd=%d, file ended %lld bytes early. returning", func, sockFd, (long long)len);
+			sockErr = OSA_SOCKERR_INVAL;
+			return OSA_ERR_COREFUNCFAIL;
+		}
+		if(-1 == result)
+		{
+			osa_loge("%s:error: sockFd=%d, sendfile failed. errno=%s (%d). returning", func, sockFd, strerror(errno), errno);
+			sockErr = o_unix2osaSockErr();
+			return OSA_ERR_COREFUNCFAIL;
 		}
+		len -= result;
+	}
 
-		result = ::sendto(sockFd, buf, len, 0, (struct sockaddr *)&rAddrIn6, sizeof(struct sockaddr_in6));
-		break;
+	osa_logd("%s: success. sockFd=%d, file sent up to offset %lld. returning", func, sockFd, (long long)off);
+
+	return OSA_SUCCESS;
+}
+
+
+ret_e osa_socket :: sendto(void *buf, i32_t len, i32_t flags, osa_sockAddrIn_t &rAddr, osa_sockErr_e &sockErr)
+{
+	char *func = "osa_socket::sendto";
+	osa_sockAddr_t binAddr;
+
+	osa_logd("%s: entered. sockFd=%d, buf=%p, len=%d, flags=%x, rAddr.domain=%s, rAddr.addr=%s, rAddr.port=%d", func, 
+		 sockFd, buf, len, flags, osa_enum2str(rAddr.domain), rAddr.addr, rAddr.port);
+
+	/* Resolve a sendto to a binary address. Callers sending often to the same peer should resolve it once themselves */
+	if(OSA_SUCCESS != osa_sockAddrResolve(rAddr, binAddr))
+	{
+		osa_loge("%s:error: sockFd=%d, Invalid remote IP address:%s. returning", func, sockFd, rAddr.addr);
+		sockErr = OSA_SOCKERR_INVAL;
+		return OSA_ERR_BADPARAM;
 	}
-	
-	/* TO DO: Flags is unused right now */
+
+	return sendto(buf, len, flags, binAddr, sockErr);
+}
+
+
+ret_e osa_socket :: sendto(void *buf, i32_t len, i32_t flags, osa_sockAddr_t &rAddr, osa_sockErr_e &sockErr)
+{
+	char *func = "osa_socket::sendto";
+	ssize_t result;
+
+	if(NULL == buf || 0 == len || 0 == rAddr.len)
+	{
+		osa_loge("%s:error: sockFd=%d, param error: buf=%p, len=%d, rAddr.len=%u. returning", func, sockFd, buf, len, rAddr.len);
+		sockErr = OSA_SOCKERR_INVAL;
+		return OSA_ERR_BADPARAM;
+	}
+
+	if(1 == isAsync)
+	{
+		pktData_t *pktData = pktGet(sockErr); /* Given back by the event loop once it is sent */
+		if(NULL == pktData)
+			return OSA_ERR_QFULL;
+		pktData->iov[0].buf = buf;
+		pktData->iov[0].len = len;
+		pktData->iovCnt = 1;
+		pktData->len = len;
+		pktData->flags = flags;
+		pktData->isSendTo = true;
+		pktData->isGenAddr = false;
+		pktData->binAddr = rAddr;
+
+		return queuePkt(pktData, sockErr);
+	}
+
+	result = ::sendto(sockFd, buf, len, flags, (struct sockaddr *)rAddr.bin, rAddr.len);
 	if(-1 ==  result)
 	{
 		osa_loge("%s:error: sockFd=%d, socket blocking-send failed. errorno=%s (%d). returning", func, sockFd, strerror(errno), errno);
 		sockErr = o_unix2osaSockErr();
-		ret = OSA_ERR_COREFUNCFAIL;	
-		return ret;
+		return OSA_ERR_COREFUNCFAIL;
 	}
 
-	osa_logd("%s: sockFd=%d, success. %d bytes sent. returning", func, sockFd, result);
+	osa_logd("%s: sockFd=%d, success. %d bytes sent. returning", func, sockFd, (int)result);
 
-	return ret;
+	return OSA_SUCCESS;
 }
 
 
@@ -897,29 +1297,29 @@ ret_e osa_socket :: sendto(void *buf, i32_t len, i32_t flags, osa_sockAddrGeneri
 
 	if(NULL == buf || 0 == len)
 	{
-		osa_loge("%s:error: sockFd=%d, param error: buf=%x, len=%d. returning", func, sockFd, buf, len);
+		osa_loge("%s:error: sockFd=%d, param error: buf=%p, len=%d. returning", func, sockFd, buf, len);
+		sockErr = OSA_SOCKERR_INVAL;
 		return OSA_ERR_BADPARAM;
 	}
 
-	osa_logd("%s: entered. sockFd=%d, buf=%x, len=%d, flags=%x, rAddr.domain=%s, rAddr.addr=%x, rAddr.addrLen=%d", func, sockFd,
+	osa_logd("%s: entered. sockFd=%d, buf=%p, len=%d, flags=%x, rAddr.domain=%s, rAddr.addr=%p, rAddr.addrLen=%d", func, sockFd,
 		buf, len, flags, osa_enum2str(rAddr.domain), rAddr.addr, rAddr.addrLen);
 
 	if(1 == isAsync)
 	{
-		pktData_t *pktData = (pktData_t *)malloc(sizeof(pktData_t)); /* This needs to be freed in receiver function OR socket destructor */
-		pktData->buf = buf;
+		pktData_t *pktData = pktGet(sockErr); /* Given back by the event loop once it is sent */
+		if(NULL == pktData)
+			return OSA_ERR_QFULL;
+		pktData->iov[0].buf = buf;
+		pktData->iov[0].len = len;
+		pktData->iovCnt = 1;
 		pktData->len = len;
+		pktData->flags = flags;
 		pktData->isSendTo = true;
+		pktData->isGenAddr = true;
 		pktData->genAddr = rAddr;
 
-		q_data_t qObj;
-		qObj.obj = pktData;
-		qObj.size = sizeof(pktData);
-
-		sockQ.push(qObj);
-		osa_logi("%s: sockFd=%d, data pushed for async send. returning", func, sockFd);
-		sockErr =  OSA_SOCKERR_INPROGRESS;
-		return OSA_SUCCESS;
+		return queuePkt(pktData, sockErr);
 	}
 
 	switch(rAddr.domain)
@@ -929,8 +1329,9 @@ ret_e osa_socket :: sendto(void *buf, i32_t len, i32_t flags, osa_sockAddrGeneri
 
 		if(0 == rAddr.addrLen || NULL == rAddr.addr)
 		{
-			osa_loge("%s:error: sockFd=%d, unix domain expects sockaddr_un(len=%d). Instead passed addr is %d, len=%d. returning", func, 
+			osa_loge("%s:error: sockFd=%d, unix domain expects sockaddr_un(len=%zu). Instead passed addr is %p, len=%d. returning", func, 
 				sockFd, sizeof(struct sockaddr_un), rAddr.addr, rAddr.addrLen);
+			sockErr = OSA_SOCKERR_INVAL;
 			return OSA_ERR_BADPARAM;
 		}
 
@@ -960,20 +1361,29 @@ ret_e osa_socket :: recv(void *buf, i32_t bufSize, i32_t *bytesRead, i32_t flags
 
 	if(NULL == buf || 0 == bufSize || NULL == bytesRead)
 	{
-		osa_loge("%s:error: sockFd=%d, param error: buf=%x, bufSize=%d, bytesRead=%x returning", func, sockFd, buf, bufSize, bytesRead);
+		osa_loge("%s:error: sockFd=%d, param error: buf=%p, bufSize=%d, bytesRead=%p returning", func, sockFd, buf, bufSize, bytesRead);
+		sockErr = OSA_SOCKERR_INVAL;
 		return OSA_ERR_BADPARAM;
 	}
 
-	osa_logd("%s: entered. sockFd=%d, buf=%x, bufSize=%d, flags=%x", func, sockFd, buf, bufSize, flags);
+	osa_logd("%s: entered. sockFd=%d, buf=%p, bufSize=%d, flags=%x", func, sockFd, buf, bufSize, flags);
+
+	if(NULL != ioCtx)
+		*bytesRead = evLoop->uringRecv(*this, buf, bufSize, flags); 	/* Data is already in the loop's receive buffers */
+	else
+		*bytesRead = ::recv(sockFd, buf, bufSize, flags);
 
-	*bytesRead = ::recv(sockFd, buf, bufSize, flags);
+	if(0 == *bytesRead)
+	{
+		osa_logd("%s: sockFd=%d, connection closed by peer. returning", func, sockFd);
+		sockErr = OSA_SOCKERR_CONNCLOSED;
+		return OSA_ERR_COREFUNCFAIL;
+	}
 
-	if(0 >= *bytesRead)
+	if(0 > *bytesRead)
 	{
-		osa_loge("%s:error: sockFd=%d, socket blocking-recv failed. errorno=%s (%d). returning", func, sockFd, strerror(errno), errno);
-		sockErr = o_unix2osaSockErr();
-		ret = OSA_ERR_COREFUNCFAIL;	
-		return ret;	
+		*bytesRead = 0;
+		return o_recvErr(func, sockFd, sockErr);
 	}
 
 	osa_logd("%s: success. sockFd=%d, %d bytes received. returning", func, sockFd, *bytesRead);
@@ -982,62 +1392,126 @@ ret_e osa_socket :: recv(void *buf, i32_t bufSize, i32_t *bytesRead, i32_t flags
 }
 
 
-ret_e osa_socket :: recvfrom(void * buf, i32_t bufSize, i32_t *bytesRead, i32_t flags, 
-		osa_sockAddrIn_t &rAddr, osa_sockErr_e &sockErr)
+ret_e osa_socket :: recvv(osa_iovec_t *iov, i32_t iovCnt, i32_t *bytesRead, i32_t flags, osa_sockErr_e &sockErr)
 {
-	char *func = "osa_socket::recvfrom";
-	ret_e ret=OSA_SUCCESS;
-	socklen_t sockLen=0;
+	char *func = "osa_socket::recvv";
+	struct iovec kIov[OSA_SOCK_IOV_MAX];
+	struct msghdr msg;
+	i32_t i, result;
 
-	if(NULL == buf || 0 == bufSize || NULL == bytesRead)
+	if(NULL == iov || 0 >= iovCnt || OSA_SOCK_IOV_MAX < iovCnt || NULL == bytesRead)
 	{
-		osa_loge("%s:error: sockFd=%d, param error: buf=%x, bufSize=%d, bytesRead=%x returning", func, sockFd, buf, bufSize, bytesRead);
+		osa_loge("%s:error: sockFd=%d, param error: iov=%p, iovCnt=%d (max %d), bytesRead=%p. returning", func, sockFd, iov, 
+			iovCnt, OSA_SOCK_IOV_MAX, bytesRead);
+		sockErr = OSA_SOCKERR_INVAL;
 		return OSA_ERR_BADPARAM;
 	}
 
-	osa_logd("%s: entered. sockFd=%d, buf=%x, bufSize=%d, flags=%x", func, sockFd, buf, bufSize, flags);
+	osa_logd("%s: entered. sockFd=%d, iovCnt=%d, flags=%x", func, sockFd, iovCnt, flags);
 
-	switch(rAddr.domain)
+	if(NULL != ioCtx)
 	{
-		case OSA_AF_INET:
-		struct sockaddr_in rAddrIn;
+		/* Data is already in the loop's receive buffers. Fill one segment after the other till they run out */
+		*bytesRead = 0;
+		for(i = 0; i < iovCnt; i++)
+		{
+			if(0 == iov[i].len)
+				continue;
 
+			result = evLoop->uringRecv(*this, iov[i].buf, iov[i].len, flags);
+			if(0 >= result)
+			{
+				if(0 == *bytesRead)
+					*bytesRead = result;
+				break;
+			}
 
-		*bytesRead = ::recvfrom(sockFd, buf, bufSize, flags, (struct sockaddr *)&rAddrIn, &sockLen);
-	
-		if(0 >= *bytesRead)
+			*bytesRead += result;
+			if(result < iov[i].len)
+				break;
+		}
+	}
+	else
+	{
+		for(i = 0; i < iovCnt; i++)
 		{
-			osa_loge("%s:error: sockFd=%d, socket blocking-recvfrom failed. errorno=%s (%d). returning", func, sockFd, strerror(errno), errno);
-			sockErr = o_unix2osaSockErr();
-			ret = OSA_ERR_COREFUNCFAIL;	
-			return ret;	
+			kIov[i].iov_base = iov[i].buf;
+			kIov[i].iov_len = iov[i].len;
 		}
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = kIov;
+		msg.msg_iovlen = iovCnt;
 
-		o_unix2OsaStruct(rAddrIn, rAddr);
-		break;
-
-		case OSA_AF_INET6:
-		struct sockaddr_in6 rAddrIn6;
-		*bytesRead = ::recvfrom(sockFd, buf, bufSize, flags, (struct sockaddr *)&rAddrIn6, &sockLen);
+		*bytesRead = ::recvmsg(sockFd, &msg, flags);
+	}
 
-		if(0 >= *bytesRead)
-		{
-			osa_loge("%s:error: sockFd=%d, socket blocking-recvfrom failed. errorno=%s (%d). returning", func, sockFd, strerror(errno), errno);
-			sockErr = o_unix2osaSockErr();
-			ret = OSA_ERR_COREFUNCFAIL;	
-			return ret;	
-		}
+	if(0 == *bytesRead)
+	{
+		osa_logd("%s: sockFd=%d, connection closed by peer. returning", func, sockFd);
+		sockErr = OSA_SOCKERR_CONNCLOSED;
+		return OSA_ERR_COREFUNCFAIL;
+	}
 
-		o_unix2OsaStruct(rAddrIn6, rAddr);
-		break;
+	if(0 > *bytesRead)
+	{
+		*bytesRead = 0;
+		return o_recvErr(func, sockFd, sockErr);
 	}
 
-	osa_logd("%s: success. sockFd=%d, %d bytes recvd from rAddr:(%s:%d). returning", func, sockFd, *bytesRead, rAddr.addr, rAddr.port);
+	osa_logd("%s: success. sockFd=%d, %d bytes received. returning", func, sockFd, *bytesRead);
+
+	return OSA_SUCCESS;
+}
+
+
+ret_e osa_socket :: recvfrom(void * buf, i32_t bufSize, i32_t *bytesRead, i32_t flags, 
+		osa_sockAddrIn_t &rAddr, osa_sockErr_e &sockErr)
+{
+	osa_sockAddr_t binAddr;
+	ret_e ret;
+
+	ret = recvfrom(buf, bufSize, bytesRead, flags, binAddr, sockErr);
+	if(OSA_SUCCESS == ret && 0 != binAddr.len)
+		osa_sockAddrToStr(binAddr, rAddr);
 
 	return ret;
 }
 
 
+ret_e osa_socket :: recvfrom(void * buf, i32_t bufSize, i32_t *bytesRead, i32_t flags, 
+		osa_sockAddr_t &rAddr, osa_sockErr_e &sockErr)
+{
+	char *func = "osa_socket::recvfrom";
+	socklen_t sockLen = OSA_SOCKADDR_BIN_SZ;
+
+	if(NULL == buf || 0 == bufSize || NULL == bytesRead)
+	{
+		osa_loge("%s:error: sockFd=%d, param error: buf=%p, bufSize=%d, bytesRead=%p returning", func, sockFd, buf, bufSize, bytesRead);
+		sockErr = OSA_SOCKERR_INVAL;
+		return OSA_ERR_BADPARAM;
+	}
+
+	osa_logd("%s: entered. sockFd=%d, buf=%p, bufSize=%d, flags=%x", func, sockFd, buf, bufSize, flags);
+
+	if(NULL != ioCtx) 	/* Stream data is already in the loop's receive buffers */
+		*bytesRead = evLoop->uringRecv(*this, buf, bufSize, flags, rAddr.bin, &sockLen);
+	else
+		*bytesRead = ::recvfrom(sockFd, buf, bufSize, flags, (struct sockaddr *)rAddr.bin, &sockLen);
+	if(0 > *bytesRead)
+	{
+		*bytesRead = 0;
+		rAddr.len = 0;
+		return o_recvErr(func, sockFd, sockErr);
+	}
+
+	o_sockAddrFinish(rAddr, sockLen); 	/* len stays 0 for a connected stream socket: the kernel gives no address */
+
+	osa_logd("%s: success. sockFd=%d, %d bytes recvd. returning", func, sockFd, *bytesRead);
+
+	return OSA_SUCCESS;
+}
+
+
 ret_e osa_socket :: recvfrom(void * buf, i32_t bufSize, i32_t *bytesRead, i32_t flags, 
 		osa_sockAddrGeneric_t &rAddr, osa_sockErr_e &sockErr)
 {
@@ -1047,11 +1521,12 @@ ret_e osa_socket :: recvfrom(void * buf, i32_t bufSize, i32_t *bytesRead, i32_t
 
 	if(NULL == buf || 0 == bufSize || NULL == bytesRead)
 	{
-		osa_loge("%s:error: sockFd=%d, param error: buf=%x, bufSize=%d, bytesRead=%x returning", func, sockFd, buf, bufSize, bytesRead);
+		osa_loge("%s:error: sockFd=%d, param error: buf=%p, bufSize=%d, bytesRead=%p returning", func, sockFd, buf, bufSize, bytesRead);
+		sockErr = OSA_SOCKERR_INVAL;
 		return OSA_ERR_BADPARAM;
 	}
 
-	osa_logd("%s: entered. sockFd=%d, buf=%x, bufSize=%d, flags=%x", func, sockFd, buf, bufSize, flags);
+	osa_logd("%s: entered. sockFd=%d, buf=%p, bufSize=%d, flags=%x", func, sockFd, buf, bufSize, flags);
 
 	switch(rAddr.domain)
 	{
@@ -1059,18 +1534,19 @@ ret_e osa_socket :: recvfrom(void * buf, i32_t bufSize, i32_t *bytesRead, i32_t
 		struct sockaddr_un rAddrUn;
 		if(rAddr.addrLen < sizeof(struct sockaddr_un))
 		{
-			osa_loge("%s: sockFd=%d, rAddr.addrlen (%d) is not enough to store remote address. It should be %d", func, sockFd, rAddr.addrLen, sizeof(struct sockaddr_un));
+			osa_loge("%s: sockFd=%d, rAddr.addrlen (%d) is not enough to store remote address. It should be %zu", func, sockFd, rAddr.addrLen, sizeof(struct sockaddr_un));
+			sockErr = OSA_SOCKERR_INVAL;
 			return OSA_ERR_BADPARAM;		
 		}
 
-		*bytesRead = ::recvfrom(sockFd, buf, bufSize, flags, (struct sockaddr *)&rAddrUn, &sockLen);
+		if(NULL != ioCtx)
+			*bytesRead = evLoop->uringRecv(*this, buf, bufSize, flags, &rAddrUn, &sockLen);
+		else
+			*bytesRead = ::recvfrom(sockFd, buf, bufSize, flags, (struct sockaddr *)&rAddrUn, &sockLen);
 	
 		if(0 >= *bytesRead)
 		{
-			osa_loge("%s:error: sockFd=%d, socket blocking-recvfrom failed. errorno=%s (%d). returning", func, sockFd, strerror(errno), errno);
-			sockErr = o_unix2osaSockErr();
-			ret = OSA_ERR_COREFUNCFAIL;	
-			return ret;	
+			return o_recvErr(func, sockFd, sockErr);
 		}
 
 		/* TO DO */memcpy(rAddr.addr, &rAddrUn, sizeof(struct sockaddr_un));
@@ -1082,19 +1558,594 @@ ret_e osa_socket :: recvfrom(void * buf, i32_t bufSize, i32_t *bytesRead, i32_t
 	return ret;
 }
 
+/********************************************************
+*			B A T C H E D    D A T A G R A M S
+*********************************************************/
+
+/* o_sendBatch : sendBatch for either kind of destination array ('txtAddrs' or 'binAddrs', at most one of them set) */
+static ret_e o_sendBatch(int sockFd, osa_sockMsg_t *msgs, u32_t count, i32_t flags, osa_sockAddrIn_t *txtAddrs, 
+		osa_sockAddr_t *binAddrs, u32_t *sent, osa_sockErr_e &sockErr)
+{
+	char *func = "osa_socket::sendBatch";
+	struct mmsghdr hdrs[OSA_SOCK_MMSG_MAX];
+	struct iovec iovs[OSA_SOCK_MMSG_MAX];
+	osa_sockAddr_t resolved[OSA_SOCK_MMSG_MAX];
+	u32_t done = 0, n, i;
+	int result;
+
+	if(NULL == msgs || 0 == count || NULL == sent)
+	{
+		osa_loge("%s:error: sockFd=%d, param error: msgs=%p, count=%u, sent=%p. returning", func, sockFd, msgs, count, sent);
+		sockErr = OSA_SOCKERR_INVAL;
+		return OSA_ERR_BADPARAM;
+	}
+
+	osa_logd("%s: entered. sockFd=%d, count=%u, flags=%x", func, sockFd, count, flags);
+
+	*sent = 0;
+	while(done < count)
+	{
+		n = count - done;
+		if(n > OSA_SOCK_MMSG_MAX)
+			n = OSA_SOCK_MMSG_MAX;
+
+		memset(hdrs, 0, n * sizeof(struct mmsghdr));
+		for(i = 0; i < n; i++)
+		{
+			osa_sockMsg_t &m = msgs[done + i];
+			osa_sockAddr_t *rAddr;
+
+			m.bytes = 0;
+			iovs[i].iov_base = m.buf;
+			iovs[i].iov_len = m.len;
+			hdrs[i].msg_hdr.msg_iov = &iovs[i];
+			hdrs[i].msg_hdr.msg_iovlen = 1;
+
+			if(NULL != binAddrs)
+				rAddr = &binAddrs[done + i];
+			else if(NULL != txtAddrs)
+			{
+				rAddr = &resolved[i];
+				osa_sockAddrResolve(txtAddrs[done + i], *rAddr);
+			}
+			else
+				continue;
+
+			if(0 == rAddr->len)
+			{
+				osa_loge("%s:error: sockFd=%d, invalid remote address of datagram %u. returning", func, sockFd, done + i);
+				if(0 == i)
+				{
+					sockErr = OSA_SOCKERR_INVAL;
+					return (0 == done) ? OSA_ERR_BADPARAM : OSA_SUCCESS;
+				}
+				n = i; 		/* Send the good ones before it. The next call stops at the bad one */
+				break;
+			}
+			hdrs[i].msg_hdr.msg_name = rAddr->bin;
+			hdrs[i].msg_hdr.msg_namelen = rAddr->len;
+		}
+
+		result = ::sendmmsg(sockFd, hdrs, n, flags | MSG_NOSIGNAL);
+		if(-1 == result)
+		{
+			if(EINTR == errno)
+				continue;
+			if(0 < done)
+				break;
+
+			if(EAGAIN == errno || EWOULDBLOCK == errno)
+			{
+				sockErr = OSA_SOCKERR_WOULDBLOCK;
+				return OSA_ERR_COREFUNCFAIL;
+			}
+			osa_loge("%s:error: sockFd=%d, sendmmsg failed. errno=%s (%d). returning", func, sockFd, strerror(errno), errno);
+			sockErr = o_unix2osaSockErr();
+			return OSA_ERR_COREFUNCFAIL;
+		}
+
+		for(i = 0; i < (u32_t)result; i++)
+			msgs[done + i].bytes = hdrs[i].msg_len;
+		done += result;
+		*sent = done;
+
+		if((u32_t)result < n)
+			break; 			/* Socket buffer is full (or the next address is bad) */
+	}
+
+	osa_logd("%s: success. sockFd=%d, %u of %u datagrams sent. returning", func, sockFd, done, count);
+	sockErr = OSA_SOCK_SUCCESS;
+	return OSA_SUCCESS;
+}
+
+/* o_recvBatch : recvBatch for either kind of source array ('txtAddrs' or 'binAddrs', at most one of them set) */
+static ret_e o_recvBatch(int sockFd, int loopRx, osa_sockMsg_t *msgs, u32_t count, i32_t flags, osa_sockAddrIn_t *txtAddrs,
+		osa_sockAddr_t *binAddrs, u32_t *received, osa_sockErr_e &sockErr)
+{
+	char *func = "osa_socket::recvBatch";
+	struct mmsghdr hdrs[OSA_SOCK_MMSG_MAX];
+	struct iovec iovs[OSA_SOCK_MMSG_MAX];
+	osa_sockAddr_t srcs[OSA_SOCK_MMSG_MAX];
+	osa_sockAddr_t *src;
+	u32_t done = 0, n, i;
+	int result;
+
+	if(NULL == msgs || 0 == count || NULL == received)
+	{
+		osa_loge("%s:error: sockFd=%d, param error: msgs=%p, count=%u, received=%p. returning", func, sockFd, msgs, count,
+			received);
+		sockErr = OSA_SOCKERR_INVAL;
+		return OSA_ERR_BADPARAM;
+	}
+
+	/* Stream socket of an io_uring loop: the loop has taken the data out already, recvmmsg would read what comes after it */
+	if(loopRx)
+	{
+		osa_loge("%s:error: sockFd=%d, stream socket of an io_uring loop. Use recv. returning", func, sockFd);
+		sockErr = OSA_SOCKERR_OPNOTSUPP;
+		return OSA_ERR_BADPARAM;
+	}
+
+	osa_logd("%s: entered. sockFd=%d, count=%u, flags=%x", func, sockFd, count, flags);
+
+	*received = 0;
+	while(done < count)
+	{
+		n = count - done;
+		if(n > OSA_SOCK_MMSG_MAX)
+			n = OSA_SOCK_MMSG_MAX;
+
+		/* Binary addresses are received in place, text ones are converted afterwards */
+		src = (NULL != binAddrs) ? &binAddrs[done] : srcs;
+
+		memset(hdrs, 0, n * sizeof(struct mmsghdr));
+		for(i = 0; i < n; i++)
+		{
+			iovs[i].iov_base = msgs[done + i].buf;
+			iovs[i].iov_len = msgs[done + i].len;
+			hdrs[i].msg_hdr.msg_iov = &iovs[i];
+			hdrs[i].msg_hdr.msg_iovlen = 1;
+			if(NULL != binAddrs || NULL != txtAddrs)
+			{
+				hdrs[i].msg_hdr.msg_name = src[i].bin;
+				hdrs[i].msg_hdr.msg_namelen = OSA_SOCKADDR_BIN_SZ;
+			}
+		}
+
+		/* Only the first call may wait. After that, take what is already queued */
+		result = ::recvmmsg(sockFd, hdrs, n, flags | (0 == done ? MSG_WAITFORONE : MSG_DONTWAIT), NULL);
+		if(-1 == result)
+		{
+			if(EINTR == errno && 0 == done)
+				continue;
+			if(0 < done)
+				break;
+			return o_recvErr(func, sockFd, sockErr);
+		}
+
+		for(i = 0; i < (u32_t)result; i++)
+		{
+			msgs[done + i].bytes = hdrs[i].msg_len;
+			msgs[done + i].msgFlags = hdrs[i].msg_hdr.msg_flags;
+			if(NULL == binAddrs && NULL == txtAddrs)
+				continue;
+
+			o_sockAddrFinish(src[i], hdrs[i].msg_hdr.msg_namelen);
+			if(NULL != txtAddrs)
+				osa_sockAddrToStr(src[i], txtAddrs[done + i]);
+		}
+		done += result;
+		*received = done;
+
+		if((u32_t)result < n)
+			break; 			/* Nothing more queued */
+	}
+
+	osa_logd("%s: success. sockFd=%d, %u datagrams received. returning", func, sockFd, done);
+	sockErr = OSA_SOCK_SUCCESS;
+	return OSA_SUCCESS;
+}
+
+ret_e osa_socket :: sendBatch(osa_sockMsg_t *msgs, u32_t count, i32_t flags, osa_sockAddrIn_t *rAddrs, u32_t *sent, 
+		osa_sockErr_e &sockErr)
+{
+	return o_sendBatch(sockFd, msgs, count, flags, rAddrs, NULL, sent, sockErr);
+}
+
+ret_e osa_socket :: sendBatch(osa_sockMsg_t *msgs, u32_t count, i32_t flags, osa_sockAddr_t *rAddrs, u32_t *sent, 
+		osa_sockErr_e &sockErr)
+{
+	return o_sendBatch(sockFd, msgs, count, flags, NULL, rAddrs, sent, sockErr);
+}
+
+ret_e osa_socket :: sendBatch(osa_sockMsg_t *msgs, u32_t count, i32_t flags, u32_t *sent, osa_sockErr_e &sockErr)
+{
+	return o_sendBatch(sockFd, msgs, count, flags, NULL, NULL, sent, sockErr);
+}
+
+ret_e osa_socket :: recvBatch(osa_sockMsg_t *msgs, u32_t count, i32_t flags, osa_sockAddrIn_t *rAddrs, u32_t *received,
+		osa_sockErr_e &sockErr)
+{
+	return o_recvBatch(sockFd, (NULL != ioCtx) ? evLoop->uringOwnsRx(*this) : 0, msgs, count, flags, rAddrs, NULL, received, sockErr);
+}
+
+ret_e osa_socket :: recvBatch(osa_sockMsg_t *msgs, u32_t count, i32_t flags, osa_sockAddr_t *rAddrs, u32_t *received,
+		osa_sockErr_e &sockErr)
+{
+	return o_recvBatch(sockFd, (NULL != ioCtx) ? evLoop->uringOwnsRx(*this) : 0, msgs, count, flags, NULL, rAddrs, received, sockErr);
+}
+
+ret_e osa_socket :: recvBatch(osa_sockMsg_t *msgs, u32_t count, i32_t flags, u32_t *received, osa_sockErr_e &sockErr)
+{
+	return o_recvBatch(sockFd, (NULL != ioCtx) ? evLoop->uringOwnsRx(*this) : 0, msgs, count, flags, NULL, NULL, received, sockErr);
+}
+
+/********************************************************
+*			A S Y N C H R O N O U S    S E N D
+*********************************************************/
+
+/* osa_pktSockAddr : Destination of a sendto packet in kernel format. It points into the packet */
+struct sockaddr * osa_pktSockAddr(pktData_t *pkt, socklen_t &addrLen)
+{
+	if(pkt->isGenAddr)
+	{
+		addrLen = pkt->genAddr.addrLen;
+		return (struct sockaddr *)pkt->genAddr.addr;
+	}
+
+	addrLen = pkt->binAddr.len;
+	return (struct sockaddr *)pkt->binAddr.bin;
+}
+
+/* osa_pktIov : Kernel iovecs of what is left of a packet after its first 'off' bytes */
+i32_t osa_pktIov(pktData_t *pkt, i32_t off, struct iovec *iov)
+{
+	i32_t i, n = 0;
+
+	for(i = 0; i < pkt->iovCnt; i++)
+	{
+		if(off >= pkt->iov[i].len)
+		{
+			off -= pkt->iov[i].len; 	/* Segment went out completely */
+			continue;
+		}
+
+		iov[n].iov_base = (u8_t *)pkt->iov[i].buf + off;
+		iov[n].iov_len = pkt->iov[i].len - off;
+		off = 0;
+		n++;
+	}
+
+	return n;
+}
+
+/* osa_pktSendFile : Send what is left of a sendFile packet after its first 'off' bytes */
+ssize_t osa_pktSendFile(int sockFd, pktData_t *pkt, i32_t off)
+{
+	off_t fileOff = (off_t)(pkt->fileOff + off);
+	ssize_t result;
+
+	result = ::sendfile(sockFd, pkt->fileFd, &fileOff, pkt->len - off);
+	if(0 == result)
+	{
+		errno = ENODATA; 	/* File is shorter than the packet. Waiting won't help */
+		return -1;
+	}
+
+	return result;
+}
+
+/* o_sendPkt : Send (the rest of) one queued packet on a non-blocking socket, zero copy if 'zc'. Returns what 
+			   send/sendmsg return */
+static ssize_t o_sendPkt(int sockFd, pktData_t *pkt, i32_t off, int zc)
+{
+	int flags  = pkt->flags | MSG_NOSIGNAL; 	/* A closed peer must not kill the io thread with SIGPIPE */
+	struct iovec iov[OSA_SOCK_IOV_MAX];
+	struct msghdr msg;
+
+	if(pkt->isFile)
+		return osa_pktSendFile(sockFd, pkt, off);
+
+	if(zc)
+		flags |= MSG_ZEROCOPY;
+
+	if(1 == pkt->iovCnt && false == pkt->isSendTo)
+		return ::send(sockFd, (u8_t *)pkt->iov[0].buf + off, pkt->len - off, flags);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = osa_pktIov(pkt, off, iov);
+
+	if(pkt->isSendTo)
+		msg.msg_name = osa_pktSockAddr(pkt, msg.msg_namelen);
+
+	return ::sendmsg(sockFd, &msg, flags);
+}
+
+/* pktGet : Take a packet descriptor. Any thread may call it. The send queue bounds how many a socket holds */
+pktData_t * osa_socket :: pktGet(osa_sockErr_e &sockErr)
+{
+	osa_pool * pool = o_pktPool();
+	pktData_t * pkt = (NULL != pool) ? (pktData_t *)pool->alloc() : NULL;
+
+	if(NULL == pkt)
+	{
+		osa_loge("osa_socket::pktGet:error: sockFd=%d, no memory for a packet descriptor. returning", sockFd);
+		sockErr = OSA_SOCKERR_INSUFFMEM;
+		return NULL;
+	}
+
+	pkt->isZc = false;
+	pkt->isFile = false;
+	return pkt;
+}
+
+/* pktPut : Give a packet descriptor back to the pool */
+void osa_socket :: pktPut(pktData_t *pkt)
+{
+	o_pktPool()->free(pkt);
+}
+
+/* queuePkt : Push a packet to the send queue and ask the event loop to flush it */
+ret_e osa_socket :: queuePkt(pktData_t *pkt, osa_sockErr_e &sockErr)
+{
+	char * func = "osa_socket::queuePkt";
+	q_data_t qObj;
+
+	qObj.obj = pkt;
+	qObj.size = sizeof(pktData_t);
+
+	if(OSA_SUCCESS != sockQ.push(qObj))
+	{
+		osa_loge("%s:error: sockFd=%d, send queue is full (%d packets). returning", func, sockFd, sockQ.curSize());
+		pktPut(pkt);
+		sockErr = OSA_SOCKERR_INSUFFMEM;
+		return OSA_ERR_QFULL;
+	}
+
+	if(NULL != evLoop)
+		evLoop->scheduleFlush(*this);
+
+	osa_logd("%s: sockFd=%d, data pushed for async send. returning", func, sockFd);
+	sockErr =  OSA_SOCKERR_INPROGRESS;
+	return OSA_SUCCESS;
+}
+
+/* txHead : Packet to be sent next (txOff bytes of it are sent already). NULL if the send queue is empty */
+pktData_t * osa_socket :: txHead()
+{
+	if(txIdx == txCnt)
+	{
+		txIdx = 0;
+		txOff = 0;
+		if(OSA_SUCCESS != sockQ.popBatch(txBatch, OSA_SOCK_TX_BATCH, txCnt))
+		{
+			txCnt = 0;
+			return NULL;
+		}
+	}
+
+	return (pktData_t *)txBatch[txIdx].obj;
+}
+
+/* txAdvance : 'sent' more bytes of txHead() went out. Completes the packet when it is fully sent.
+			   IMP: sendCompleteCb may destroy the socket. Nothing of the socket may be touched after this call, unless the
+			   caller has checked that the socket is still in its loop (evLoop->isCurrent) */
+void osa_socket :: txAdvance(i32_t sent)
+{
+	pktData_t *pkt = (pktData_t *)txBatch[txIdx].obj;
+
+	txOff += sent;
+	if(txOff < pkt->len)
+		return;
+
+	/* Packet is done. Give it back before the callback */
+	txIdx++;
+	txOff = 0;
+
+	if(NULL != zcHead && false == pkt->isZc)
+	{
+		pkt->isZc = true;
+		pkt->zcId = zcSeq - 1; 		/* Copied packet: completes after the zero copy ones before it */
+	}
+
+	if(pkt->isZc && 0 >= (i32_t)(zcDone - pkt->zcId))
+	{
+		/* The kernel still reads the caller's buffer. Completed by zcReap */
+		pkt->zcNext = NULL;
+		if(NULL == zcTail)
+			zcHead = pkt;
+		else
+			zcTail->zcNext = pkt;
+		zcTail = pkt;
+		return;
+	}
+
+	pktPut(pkt);
+
+	if(NULL != sendCompleteCb)
+		sendCompleteCb(*this, appData);
+}
+
+/* flushSendQ : Called in the event loop thread when the socket is writable or new packets were queued.
+				Sends as much as the socket takes. On EAGAIN it simply returns: the next EPOLLOUT edge calls it again. */
+void osa_socket :: flushSendQ()
+{
+	char * func = "osa_socket::flushSendQ";
+	osa_eventLoop *loop = evLoop;
+	pktData_t *pkt;
+
+	while(NULL != (pkt = txHead()))
+	{
+		int zc = (1 == zcMode && false == pkt->isFile && OSA_SOCK_ZC_MIN <= pkt->len);
+		ssize_t result = o_sendPkt(sockFd, pkt, txOff, zc);
+
+		if(-1 == result && zc && ENOBUFS == errno)
+		{
+			/* Too many zero copy sends waiting for completion (socket option memory is full). Copy this one */
+			zc = 0;
+			result = o_sendPkt(sockFd, pkt, txOff, 0);
+		}
+
+		if(-1 == result)
+		{
+			if(EAGAIN == errno || EWOULDBLOCK == errno)
+				return;
+			if(EINTR == errno)
+				continue;
+
+			osa_loge("%s:error: sockFd=%d, async send failed. errno=%s (%d). Dropping the send queue", func, sockFd, 
+				strerror(errno), errno);
+			dropSendQ(1);
+			return;
+		}
+
+		if(zc)
+		{
+			pkt->isZc = true;
+			pkt->zcId = zcSeq++; 	/* The kernel numbers every successful zero copy call */
+		}
+
+		txAdvance((i32_t)result);
+		if(!loop->isCurrent(*this))
+			return; 		/* sendCompleteCb removed the socket */
+	}
+}
+
+/* zcReap : Read zero copy completions from the socket's error queue (the loop sees EPOLLERR) and complete the packets
+			whose buffers the kernel has released.
+			IMP: sendCompleteCb may destroy the socket, same as for txAdvance */
+void osa_socket :: zcReap()
+{
+	char control[128];
+	struct msghdr msg;
+	struct cmsghdr *cm;
+	struct sock_extended_err *serr;
+	osa_eventLoop *loop = evLoop;
+	pktData_t *pkt;
+
+	for(;;)
+	{
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if(-1 == ::recvmsg(sockFd, &msg, MSG_ERRQUEUE))
+			break; 			/* EAGAIN: all read */
+
+		for(cm = CMSG_FIRSTHDR(&msg); NULL != cm; cm = CMSG_NXTHDR(&msg, cm))
+		{
+			if(!(SOL_IP == cm->cmsg_level && IP_RECVERR == cm->cmsg_type) && 
+			   !(SOL_IPV6 == cm->cmsg_level && IPV6_RECVERR == cm->cmsg_type))
+				continue;
+
+			/* ee_info..ee_data : range of completed call ids */
+			serr = (struct sock_extended_err *)CMSG_DATA(cm);
+			if(SO_EE_ORIGIN_ZEROCOPY != serr->ee_origin || 0 != serr->ee_errno)
+				continue;
+			if(0 < (i32_t)(serr->ee_data + 1 - zcDone))
+				zcDone = serr->ee_data + 1;
+		}
+	}
+
+	/* A stream socket completes its calls in order, so every packet before zcDone is done */
+	while(NULL != (pkt = zcHead) && 0 < (i32_t)(zcDone - pkt->zcId))
+	{
+		zcHead = pkt->zcNext;
+		if(NULL == zcHead)
+			zcTail = NULL;
+		pktPut(pkt);
+
+		if(NULL != sendCompleteCb)
+		{
+			sendCompleteCb(*this, appData);
+			if(!loop->isCurrent(*this))
+				return;
+		}
+	}
+}
+
+/* dropSendQ : Drop all queued packets. 'notify' tells whether sendCompleteCb is called for each of them (only done in
+			   the loop thread).
+			   The queues are emptied before the first callback, so a callback that destroys the socket (and calls
+			   dropSendQ again) finds nothing left. The callbacks stop as soon as the socket is out of its loop */
+void osa_socket :: dropSendQ(int notify)
+{
+	osa_eventLoop *loop = evLoop;
+	q_data_t qObj;
+	u32_t dropped = 0;
+
+	for(; txIdx < txCnt; txIdx++, dropped++)
+		pktPut((pktData_t *)txBatch[txIdx].obj);
+	txIdx = 0;
+	txCnt = 0;
+	txOff = 0;
+
+	/* Listeners have no send queue (makeAsynchronous) */
+	if(0 <= sockQ.curSize())
+	{
+		while(OSA_SUCCESS == sockQ.pop(qObj))
+		{
+			pktPut((pktData_t *)qObj.obj);
+			dropped++;
+		}
+	}
+
+	/* Zero copy packets still waiting for the kernel */
+	while(NULL != zcHead)
+	{
+		pktData_t *pkt = zcHead;
+
+		zcHead = pkt->zcNext;
+		pktPut(pkt);
+		dropped++;
+	}
+	zcTail = NULL;
+
+	if(!notify || NULL == loop || NULL == sendCompleteCb)
+		return;
+
+	while(0 < dropped-- && loop->isCurrent(*this))
+		sendCompleteCb(*this, appData);
+}
+
+void osa_socket :: onReadable()
+{
+	if(NULL != recvReadyCb)
+		recvReadyCb(*this, appData);
+}
+
 ret_e osa_socket :: destroy()
 {
 	char *func = "osa_socket::destroy";
 	int result;
-	osa_logd("%s: entered");
+	osa_logd("%s: entered", func);
+
+	if(-1 == sockFd)
+		return OSA_SUCCESS; 	/* Never created or already closed */
+
+	if(NULL != evLoop)
+		evLoop->remove(*this);
+
+	if(1 == isAsync)
+	{
+		dropSendQ(0);
+		sockQ.destroy();
+		isAsync = 0;
+		zcMode = 0;
+		zcSeq = 0;
+		zcDone = 0;
+	}
+
 	result = ::close(sockFd);
 	if(0!=result)
 	{
 		osa_loge("%s: close failed. errno=%s (%d)", func, strerror(errno), errno);
+		sockFd = -1;
 		return OSA_ERR_COREFUNCFAIL;
 	}
 
-	osa_logi("%s: socket %d closed", sockFd);
+	osa_logi("%s: socket %d closed", func, sockFd);
+	sockFd = -1;
 	return OSA_SUCCESS;
 }
 
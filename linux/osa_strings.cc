@@ -76,7 +76,7 @@ ret_e osa_strncpy(char * dst, char *src, i32_t n, i32_t dstSz)
 
 	if(n > dstSz-1)
 	{
-		osa_logd("%s:warning: dest buffer (%d) is smaller than n (%d). Only %d bytes will be copied", dstSz, n, dstSz-1);
+		osa_logd("%s:warning: dest buffer (%d) is smaller than n (%d). Only %d bytes will be copied", func, dstSz, n, dstSz-1);
 	}
 	/*##############
 	  ############## */
@@ -0,0 +1,774 @@
+#include "osa.h"
+#include "osa_threads_internal.h"
+#include <limits.h>
+
+/********************************************************
+*			T A S K S   A N D   D E Q U E S
+*********************************************************/
+
+/* osa_task_t::state */
+#define O_TASK_PENDING		0
+#define O_TASK_DONE			1
+#define O_TASK_WAITED		2			/* Pending and somebody sleeps on 'state' */
+
+struct osa_task_t
+{
+	osa_taskFunc 		func;
+	void * 				arg;
+	std::atomic<u32_t> 	state;
+	std::atomic<u32_t> 	refs; 			/* The runner, plus one while the handle is out */
+	i64_t 				deadline; 		/* o_monotonicUs() by which it should start. 0 for none */
+};
+
+/* Entry of the deadline heap */
+struct osa_tpDeadline_t
+{
+	i64_t 				deadline;
+	osa_task_t * 		task;
+};
+
+/* One worker and its deque. Only the owner works on 'bottom' (push/pop), thieves race on 'top' with a compare-and-swap.
+   top and bottom are on their own cache lines: the owner should not lose its line every time somebody steals */
+struct osa_tpWorker_t
+{
+	char 						pad0[OSA_CACHELINE_SZ];
+	std::atomic<i64_t> 			top;
+	char 						pad1[OSA_CACHELINE_SZ - sizeof(std::atomic<i64_t>)];
+	std::atomic<i64_t> 			bottom;
+	char 						pad2[OSA_CACHELINE_SZ - sizeof(std::atomic<i64_t>)];
+	std::atomic<osa_task_t *> 	buf[OSA_TP_DEQUE_SZ];
+	osa_threadpool * 			pool;
+	osa_threadHd_t 				thr;
+	u32_t 						idx;
+	u32_t 						rnd; 		/* Picks the first victim to steal from */
+	int 						thrAlive;
+};
+
+/* Worker the calling thread is. NULL for threads that are not pool workers */
+static thread_local osa_tpWorker_t * o_tpSelf = NULL;
+
+/* Tasks a worker has started from inside wait(), one in the other. Each one is a few more frames on its stack */
+static thread_local u32_t o_tpHelpDepth = 0;
+
+/* The deque follows "Correct and Efficient Work-Stealing for Weak Memory Models" (Le, Pop, Cohen, Zappa Nardelli, 2013).
+   The array has a fixed size. When it is full the caller uses the shared queue instead of growing it */
+
+/* o_tpPush : Owner only. False if the deque is full */
+static bool o_tpPush(osa_tpWorker_t * w, osa_task_t * t)
+{
+	i64_t b = w->bottom.load(std::memory_order_relaxed);
+	i64_t top = w->top.load(std::memory_order_acquire);
+
+	if(b - top >= OSA_TP_DEQUE_SZ)
+		return false;
+
+	w->buf[b & (OSA_TP_DEQUE_SZ - 1)].store(t, std::memory_order_relaxed);
+	w->bottom.store(b + 1, std::memory_order_release);
+	return true;
+}
+
+/* o_tpPop : Owner only. Newest task, or NULL */
+static osa_task_t * o_tpPop(osa_tpWorker_t * w)
+{
+	i64_t b = w->bottom.load(std::memory_order_relaxed) - 1;
+	i64_t top;
+	osa_task_t * t = NULL;
+
+	w->bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	top = w->top.load(std::memory_order_relaxed);
+
+	if(top <= b)
+	{
+		t = w->buf[b & (OSA_TP_DEQUE_SZ - 1)].load(std::memory_order_relaxed);
+		if(top == b)
+		{
+			/* Last task. Thieves may be after it too */
+			if(!w->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				t = NULL;
+			w->bottom.store(b + 1, std::memory_order_relaxed);
+		}
+	}
+	else
+		w->bottom.store(b + 1, std::memory_order_relaxed);
+
+	return t;
+}
+
+/* o_tpSteal : Any thread. Oldest task, or NULL if the deque is empty or another thread got it first */
+static osa_task_t * o_tpSteal(osa_tpWorker_t * w)
+{
+	i64_t top = w->top.load(std::memory_order_acquire);
+	i64_t b;
+	osa_task_t * t;
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	b = w->bottom.load(std::memory_order_acquire);
+	if(top >= b)
+		return NULL;
+
+	t = w->buf[top & (OSA_TP_DEQUE_SZ - 1)].load(std::memory_order_relaxed);
+	if(!w->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return NULL;
+
+	return t;
+}
+
+
+/********************************************************
+*			T H R E A D P O O L
+*********************************************************/
+
+osa_threadpool :: osa_threadpool() : dlNum(0), dlLock(0), pending(0), idleSeq(0), allWaiters(0), sleepers(0), wakeSeq(0),
+	stopping(0), urgent(0), missed(0)
+{
+	dlHeap = NULL;
+	workers = NULL;
+	numThreads = 0;
+	isAlive = 0;
+}
+
+osa_threadpool :: ~osa_threadpool()
+{
+	if(1 == isAlive)
+		destroy();
+}
+
+osa_tpWorker_t * osa_threadpool :: self()
+{
+	osa_tpWorker_t * me = o_tpSelf;
+
+	return (NULL != me && this == me->pool) ? me : NULL;
+}
+
+/* workerThread : Entry point of every worker. Runs tasks till destroy(), sleeps when there are none */
+void * osa_threadpool :: workerThread(void * arg)
+{
+	osa_tpWorker_t * me = (osa_tpWorker_t *)arg;
+	osa_threadpool * tp = me->pool;
+	osa_task_t * t;
+	u32_t seq;
+
+	o_tpSelf = me;
+
+	for(;;)
+	{
+		if(NULL != (t = tp->findTask(me)))
+		{
+			tp->run(t);
+			continue;
+		}
+
+		for(int i = o_spinCount(OSA_TP_SPIN); i > 0 && NULL == t; i--)
+		{
+			o_cpuRelax();
+			t = tp->findTask(me);
+		}
+		if(NULL != t)
+		{
+			tp->run(t);
+			continue;
+		}
+
+		if(0 != tp->stopping.load(std::memory_order_acquire))
+			break;
+
+		/* Announce the sleep before the last look at the queues. A submit pushes before it checks 'sleepers', so one
+		   of the two sides sees the other */
+		seq = tp->wakeSeq.load(std::memory_order_acquire);
+		tp->sleepers.fetch_add(1, std::memory_order_seq_cst);
+		if(!tp->hasWork() && 0 == tp->stopping.load(std::memory_order_seq_cst))
+			o_futexWait(&tp->wakeSeq, seq, -1);
+		tp->sleepers.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	o_tpSelf = NULL;
+	return NULL;
+}
+
+ret_e osa_threadpool :: create(u32_t numThreads, const osa_cpuSet_t * cpus)
+{
+	char * func = "osa_threadpool::create";
+	osa_thread_priority_e prio = OSA_THREAD_PRIO_DEFAULT;
+	i32_t numCpu = (i32_t)sysconf(_SC_NPROCESSORS_ONLN);
+	osa_topology_t *topo;
+	osa_cpuSet_t pin;
+	i32_t order[OSA_CPU_MAX];
+	u32_t numPin = 0, n;
+	char thrName[16];
+	u32_t i;
+
+	if(1 == isAlive)
+	{
+		osa_loge("%s:error: pool %p is already created", func, this);
+		return OSA_ERR_BADPARAM;
+	}
+
+	if(NULL != cpus)
+	{
+		/* Workers are pinned in spread order (a core each before SMT siblings), restricted to 'cpus' */
+		topo = new osa_topology_t;
+		n = (OSA_SUCCESS == osa_topology_get(*topo)) ? osa_topology_spread(*topo, order, OSA_CPU_MAX) : 0;
+		delete topo;
+		for(i=0; i<n; i++)
+		{
+			if(osa_cpuSet_has(*cpus, order[i]))
+				order[numPin++] = order[i];
+		}
+		if(0 == numPin)
+		{
+			osa_loge("%s:error: none of the %u cpus given is online and allowed for this process", func,
+				osa_cpuSet_count(*cpus));
+			return OSA_ERR_BADPARAM;
+		}
+		numCpu = (i32_t)numPin;
+	}
+
+	if(0 >= numCpu)
+		numCpu = 1;
+	if(0 == numThreads)
+		numThreads = (u32_t)numCpu;
+
+	dlHeap = (osa_tpDeadline_t *)osa_malloc(OSA_TP_URGENT_SZ * sizeof(osa_tpDeadline_t));
+	if(NULL == dlHeap || OSA_SUCCESS != injectQ.create(OSA_TP_QUEUE_SZ) || OSA_SUCCESS != critQ.create(OSA_TP_URGENT_SZ)
+		|| OSA_SUCCESS != highQ.create(OSA_TP_URGENT_SZ) || OSA_SUCCESS != lowQ.create(OSA_TP_QUEUE_SZ)
+		|| OSA_SUCCESS != tasks.create(sizeof(osa_task_t)))
+	{
+		osa_loge("%s:error: queues or task pool could not be created", func);
+		osa_free(dlHeap);
+		dlHeap = NULL;
+		injectQ.destroy();
+		critQ.destroy();
+		highQ.destroy();
+		lowQ.destroy();
+		return OSA_ERR_INSUFFMEM;
+	}
+
+	workers = new osa_tpWorker_t[numThreads];
+	this->numThreads = numThreads;
+	pending.store(0, std::memory_order_relaxed);
+	sleepers.store(0, std::memory_order_relaxed);
+	stopping.store(0, std::memory_order_relaxed);
+	urgent.store(0, std::memory_order_relaxed);
+	missed.store(0, std::memory_order_relaxed);
+	dlNum.store(0, std::memory_order_relaxed);
+	isAlive = 1;
+
+	for(i=0; i<numThreads; i++)
+	{
+		osa_tpWorker_t * w = &workers[i];
+
+		w->top.store(0, std::memory_order_relaxed);
+		w->bottom.store(0, std::memory_order_relaxed);
+		w->pool = this;
+		w->idx = i;
+		w->rnd = i * 2654435761u + 1;
+		w->thrAlive = 0;
+	}
+
+	for(i=0; i<numThreads; i++)
+	{
+		snprintf(thrName, sizeof(thrName), "osa_tp%u", i % 100000);
+		osa_cpuSet_zero(pin);
+		if(0 < numPin)
+			osa_cpuSet_add(pin, order[i % numPin]);
+		if(0 < numPin && OSA_SUCCESS != osa_thread_create(workers[i].thr, workerThread, prio, thrName, &workers[i], NULL, &pin))
+		{
+			osa_loge("%s: could not pin worker %u to cpu %d, but we will continue", func, i, order[i % numPin]);
+			osa_cpuSet_zero(pin);
+		}
+		if(0 == osa_cpuSet_count(pin) && OSA_SUCCESS != osa_thread_create(workers[i].thr, workerThread, prio, thrName,
+					&workers[i], NULL))
+		{
+			osa_loge("%s:error: worker %u could not be created", func, i);
+			destroy();
+			return OSA_ERR_COREFUNCFAIL;
+		}
+		workers[i].thrAlive = 1;
+	}
+
+	osa_logi("%s: pool %p running with %u workers", func, this, numThreads);
+	return OSA_SUCCESS;
+}
+
+ret_e osa_threadpool :: destroy()
+{
+	char * func = "osa_threadpool::destroy";
+	u32_t i;
+
+	if(1 != isAlive)
+	{
+		osa_loge("%s:error: pool %p is not created", func, this);
+		return OSA_ERR_BADPARAM;
+	}
+
+	waitAll();
+
+	stopping.store(1, std::memory_order_seq_cst);
+	wakeSeq.fetch_add(1, std::memory_order_release);
+	o_futexWake(&wakeSeq, INT_MAX);
+
+	for(i=0; i<numThreads; i++)
+	{
+		if(1 == workers[i].thrAlive)
+		{
+			osa_thread_join(workers[i].thr, NULL);
+			workers[i].thrAlive = 0;
+		}
+	}
+
+	delete [] workers;
+	workers = NULL;
+	numThreads = 0;
+	injectQ.destroy();
+	critQ.destroy();
+	highQ.destroy();
+	lowQ.destroy();
+	osa_free(dlHeap);
+	dlHeap = NULL;
+	tasks.destroy();
+	isAlive = 0;
+
+	osa_logi("%s: pool %p stopped", func, this);
+	return OSA_SUCCESS;
+}
+
+/* deadlinePush : Add a task to the deadline heap. False if it is full */
+bool osa_threadpool :: deadlinePush(osa_task_t * t)
+{
+	osa_tpDeadline_t e = { t->deadline, t };
+	u32_t i, parent;
+
+	o_lock(dlLock);
+	i = dlNum.load(std::memory_order_relaxed);
+	if(OSA_TP_URGENT_SZ == i)
+	{
+		o_unlock(dlLock);
+		return false;
+	}
+
+	for(; 0 < i && dlHeap[parent = (i - 1) / 2].deadline > e.deadline; i = parent)
+		dlHeap[i] = dlHeap[parent];
+	dlHeap[i] = e;
+	dlNum.store(dlNum.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	o_unlock(dlLock);
+
+	return true;
+}
+
+/* findUrgent : A CRITICAL task, else the one with the earliest deadline, else a HIGH one */
+osa_task_t * osa_threadpool :: findUrgent()
+{
+	osa_task_t * t = NULL;
+	osa_tpDeadline_t last;
+	q_data_t d;
+	u32_t n, i, child;
+
+	if(OSA_SUCCESS == critQ.pop(d))
+		t = (osa_task_t *)d.obj;
+	else if(0 != dlNum.load(std::memory_order_relaxed))
+	{
+		o_lock(dlLock);
+		n = dlNum.load(std::memory_order_relaxed);
+		if(0 != n)
+		{
+			t = dlHeap[0].task;
+			last = dlHeap[--n];
+			for(i = 0; (child = 2 * i + 1) < n; i = child)
+			{
+				if(child + 1 < n && dlHeap[child + 1].deadline < dlHeap[child].deadline)
+					child++;
+				if(last.deadline <= dlHeap[child].deadline)
+					break;
+				dlHeap[i] = dlHeap[child];
+			}
+			dlHeap[i] = last;
+			dlNum.store(n, std::memory_order_relaxed);
+		}
+		o_unlock(dlLock);
+	}
+
+	if(NULL == t && OSA_SUCCESS == highQ.pop(d))
+		t = (osa_task_t *)d.obj;
+
+	if(NULL != t)
+		urgent.fetch_sub(1, std::memory_order_relaxed);
+	return t;
+}
+
+/* findTask : Urgent tasks first. Then the own deque, the shared queue and stealing from the others (starting at a random
+			  worker). LOW tasks last */
+osa_task_t * osa_threadpool :: findTask(osa_tpWorker_t * me)
+{
+	osa_task_t * t;
+	q_data_t d;
+	u32_t start;
+
+	if(0 != urgent.load(std::memory_order_relaxed) && NULL != (t = findUrgent()))
+		return t;
+
+	if(NULL != me && NULL != (t = o_tpPop(me)))
+		return t;
+
+	if(OSA_SUCCESS == injectQ.pop(d))
+		return (osa_task_t *)d.obj;
+
+	if(NULL != me)
+	{
+		me->rnd ^= me->rnd << 13;
+		me->rnd ^= me->rnd >> 17;
+		me->rnd ^= me->rnd << 5;
+		start = me->rnd;
+	}
+	else
+		start = (u32_t)(uintptr_t)&d >> 6;
+
+	for(u32_t i = 0; i < numThreads; i++)
+	{
+		osa_tpWorker_t * w = &workers[(start + i) % numThreads];
+
+		if(w != me && NULL != (t = o_tpSteal(w)))
+			return t;
+	}
+
+	if(OSA_SUCCESS == lowQ.pop(d))
+		return (osa_task_t *)d.obj;
+
+	return NULL;
+}
+
+bool osa_threadpool :: hasWork()
+{
+	if(0 != urgent.load(std::memory_order_seq_cst) || 0 < injectQ.curSize() || 0 < lowQ.curSize())
+		return true;
+
+	for(u32_t i = 0; i < numThreads; i++)
+	{
+		if(workers[i].top.load(std::memory_order_seq_cst) < workers[i].bottom.load(std::memory_order_seq_cst))
+			return true;
+	}
+
+	return false;
+}
+
+/* wake : Wake one sleeping worker, if any. Called after a task is queued */
+void osa_threadpool :: wake()
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if(0 != sleepers.load(std::memory_order_relaxed))
+	{
+		wakeSeq.fetch_add(1, std::memory_order_release);
+		o_futexWake(&wakeSeq, 1);
+	}
+}
+
+void osa_threadpool :: run(osa_task_t * t)
+{
+	if(0 != t->deadline && o_monotonicUs() > t->deadline)
+		missed.fetch_add(1, std::memory_order_relaxed);
+
+	t->func(t->arg);
+
+	if(O_TASK_WAITED == t->state.exchange(O_TASK_DONE, std::memory_order_acq_rel))
+		o_futexWake(&t->state, INT_MAX);
+	if(1 == t->refs.fetch_sub(1, std::memory_order_acq_rel))
+		tasks.free(t);
+
+	if(1 == pending.fetch_sub(1, std::memory_order_seq_cst))
+	{
+		idleSeq.fetch_add(1, std::memory_order_seq_cst);
+		if(0 != allWaiters.load(std::memory_order_seq_cst))
+			o_futexWake(&idleSeq, INT_MAX);
+	}
+}
+
+/* o_tpPushQ : Push a task to one of the shared queues */
+static bool o_tpPushQ(osa_q &q, osa_task_t * t)
+{
+	q_data_t d;
+
+	d.obj = t;
+	d.size = sizeof(osa_task_t);
+	return OSA_SUCCESS == q.push(d);
+}
+
+ret_e osa_threadpool :: submit(osa_taskFunc taskFunc, void * arg, osa_task_t ** task, osa_thread_priority_e prio,
+	u32_t deadlineUs)
+{
+	char * func = "osa_threadpool::submit";
+	osa_tpWorker_t * me = self();
+	osa_task_t * t;
+	bool queued;
+
+	if(1 != isAlive || NULL == taskFunc)
+	{
+		osa_loge("%s:error: pool %p is not created or taskFunc is NULL", func, this);
+		return OSA_ERR_BADPARAM;
+	}
+
+	t = (osa_task_t *)tasks.alloc();
+	if(NULL == t)
+	{
+		osa_loge("%s:error: no memory for a task", func);
+		return OSA_ERR_INSUFFMEM;
+	}
+
+	t->func = taskFunc;
+	t->arg = arg;
+	t->state.store(O_TASK_PENDING, std::memory_order_relaxed);
+	t->refs.store((NULL != task) ? 2 : 1, std::memory_order_relaxed);
+	t->deadline = (0 != deadlineUs) ? o_monotonicUs() + deadlineUs : 0;
+	if(NULL != task)
+		*task = t;
+	pending.fetch_add(1, std::memory_order_relaxed);
+
+	if(OSA_THREAD_PRIO_CRITICAL == prio || OSA_THREAD_PRIO_HIGH == prio || 0 != deadlineUs)
+	{
+		/* Counted before it is visible, so a worker never misses it. At worst it finds nothing once */
+		urgent.fetch_add(1, std::memory_order_relaxed);
+		if(OSA_THREAD_PRIO_CRITICAL == prio)
+			queued = o_tpPushQ(critQ, t);
+		else
+			queued = (0 != deadlineUs && deadlinePush(t)) || o_tpPushQ(highQ, t);
+		if(!queued)
+			urgent.fetch_sub(1, std::memory_order_relaxed);
+	}
+	else if(OSA_THREAD_PRIO_LOW == prio)
+		queued = o_tpPushQ(lowQ, t);
+	else if(NULL != me)
+	{
+		/* A worker runs a task itself rather than put it in the shared queue, where its own wait() would not look */
+		queued = o_tpPush(me, t);
+	}
+	else
+		queued = o_tpPushQ(injectQ, t);
+
+	if(!queued)
+	{
+		osa_logd("%s: queue of pool %p for prio %d is full. Task runs on the calling thread", func, this, prio);
+		run(t);
+		return OSA_SUCCESS;
+	}
+
+	wake();
+	return OSA_SUCCESS;
+}
+
+ret_e osa_threadpool :: wait(osa_task_t * task)
+{
+	char * func = "osa_threadpool::wait";
+	osa_tpWorker_t * me = self();
+	osa_task_t * t;
+	u32_t state;
+
+	if(1 != isAlive || NULL == task)
+	{
+		osa_loge("%s:error: pool %p is not created or task is NULL", func, this);
+		return OSA_ERR_BADPARAM;
+	}
+
+	while(O_TASK_DONE != task->state.load(std::memory_order_acquire))
+	{
+		/* A worker runs its own tasks first: they are the children of what it is doing. Other tasks (stolen ones)
+		   only up to OSA_TP_HELP_DEPTH deep, each of them may wait and help again. Other threads just sleep */
+		t = NULL;
+		if(NULL != me && NULL == (t = o_tpPop(me)) && OSA_TP_HELP_DEPTH > o_tpHelpDepth)
+			t = findTask(me);
+		if(NULL != t)
+		{
+			o_tpHelpDepth++;
+			run(t);
+			o_tpHelpDepth--;
+			continue;
+		}
+
+		/* Nothing to help with. The task runs on another thread, sleep till it is done */
+		state = O_TASK_PENDING;
+		if(task->state.compare_exchange_strong(state, O_TASK_WAITED, std::memory_order_acq_rel) || O_TASK_WAITED == state)
+			o_futexWait(&task->state, O_TASK_WAITED, -1);
+	}
+
+	if(1 == task->refs.fetch_sub(1, std::memory_order_acq_rel))
+		tasks.free(task);
+
+	return OSA_SUCCESS;
+}
+
+ret_e osa_threadpool :: waitAll()
+{
+	char * func = "osa_threadpool::waitAll";
+	osa_tpWorker_t * me = self();
+	osa_task_t * t;
+	u32_t seq;
+
+	if(1 != isAlive)
+	{
+		osa_loge("%s:error: pool %p is not created", func, this);
+		return OSA_ERR_BADPARAM;
+	}
+
+	while(0 != pending.load(std::memory_order_acquire))
+	{
+		if(NULL != (t = findTask(me)))
+		{
+			run(t);
+			continue;
+		}
+
+		seq = idleSeq.load(std::memory_order_seq_cst);
+		allWaiters.fetch_add(1, std::memory_order_seq_cst);
+		if(0 != pending.load(std::memory_order_seq_cst))
+			o_futexWait(&idleSeq, seq, -1);
+		allWaiters.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	return OSA_SUCCESS;
+}
+
+u32_t osa_threadpool :: getNumThreads()
+{
+	return numThreads;
+}
+
+i32_t osa_threadpool :: getWorkerIdx()
+{
+	osa_tpWorker_t * me = self();
+
+	return (NULL != me) ? (i32_t)me->idx : -1;
+}
+
+u64_t osa_threadpool :: getMissedDeadlines()
+{
+	return missed.load(std::memory_order_relaxed);
+}
+
+
+/********************************************************
+*			P A R A L L E L   L O O P S
+*********************************************************/
+
+/* A part of the range. The accumulators live on the stacks of the threads splitting the range: a part is done before
+   the thread that made it returns */
+typedef struct o_parRange_t
+{
+	osa_threadpool * 	tp;
+	u64_t 				begin;
+	u64_t 				end;
+	u64_t 				grain;
+	osa_rangeFunc 		forFn;			/* osa_parallel_for */
+	osa_reduceFunc 		reduceFn;		/* osa_parallel_reduce */
+	osa_joinFunc 		join;
+	void * 				arg;
+	void * 				acc;
+	const void * 		identity;
+	u32_t 				accSz;
+}o_parRange_t;
+
+static void o_parRun(void * p)
+{
+	o_parRange_t * r = (o_parRange_t *)p;
+	o_parRange_t left, right;
+	u64_t rightAcc[OSA_PAR_ACC_MAX / sizeof(u64_t)];
+	osa_task_t * task;
+
+	if(r->end - r->begin <= r->grain)
+	{
+		if(NULL != r->forFn)
+			r->forFn(r->begin, r->end, r->arg);
+		else
+			r->reduceFn(r->begin, r->end, r->acc, r->arg);
+		return;
+	}
+
+	left = *r;
+	right = *r;
+	left.end = right.begin = r->begin + (r->end - r->begin) / 2;
+	if(NULL != r->reduceFn)
+	{
+		memcpy(rightAcc, r->identity, r->accSz);
+		right.acc = rightAcc;
+	}
+
+	/* Give the right half away and go on with the left one. If it can't be submitted, do it here */
+	if(OSA_SUCCESS != r->tp->submit(o_parRun, &right, &task))
+		task = NULL;
+	o_parRun(&left);
+	if(NULL != task)
+		r->tp->wait(task);
+	else
+		o_parRun(&right);
+
+	if(NULL != r->reduceFn)
+		r->join(r->acc, rightAcc, r->arg);
+}
+
+static u64_t o_parGrain(osa_threadpool &tp, u64_t begin, u64_t end, u64_t grain)
+{
+	if(0 == grain)
+		grain = (end - begin) / ((u64_t)tp.getNumThreads() * 8);
+
+	return (0 == grain) ? 1 : grain;
+}
+
+ret_e osa_parallel_for(osa_threadpool &tp, u64_t begin, u64_t end, u64_t grain, osa_rangeFunc fn, void * arg)
+{
+	char * func = "osa_parallel_for";
+	o_parRange_t r;
+
+	if(NULL == fn || end < begin || 0 == tp.getNumThreads())
+	{
+		osa_loge("%s:error: fn=%p, begin=%llu, end=%llu or pool %p (not created?) is not valid", func, fn,
+					(unsigned long long)begin, (unsigned long long)end, &tp);
+		return OSA_ERR_BADPARAM;
+	}
+
+	if(begin == end)
+		return OSA_SUCCESS;
+
+	memset(&r, 0, sizeof(r));
+	r.tp = &tp;
+	r.begin = begin;
+	r.end = end;
+	r.grain = o_parGrain(tp, begin, end, grain);
+	r.forFn = fn;
+	r.arg = arg;
+	o_parRun(&r);
+
+	return OSA_SUCCESS;
+}
+
+ret_e osa_parallel_reduce(osa_threadpool &tp, u64_t begin, u64_t end, u64_t grain, void * acc, u32_t accSz,
+						  osa_reduceFunc fn, osa_joinFunc join, void * arg)
+{
+	char * func = "osa_parallel_reduce";
+	u64_t identity[OSA_PAR_ACC_MAX / sizeof(u64_t)];
+	o_parRange_t r;
+
+	if(NULL == fn || NULL == join || NULL == acc || 0 == accSz || OSA_PAR_ACC_MAX < accSz || end < begin
+		|| 0 == tp.getNumThreads())
+	{
+		osa_loge("%s:error: fn=%p, join=%p, acc=%p, accSz=%u, begin=%llu, end=%llu or pool %p (not created?) is not valid",
+					func, fn, join, acc, accSz, (unsigned long long)begin, (unsigned long long)end, &tp);
+		return OSA_ERR_BADPARAM;
+	}
+
+	if(begin == end)
+		return OSA_SUCCESS;
+
+	memcpy(identity, acc, accSz);
+
+	memset(&r, 0, sizeof(r));
+	r.tp = &tp;
+	r.begin = begin;
+	r.end = end;
+	r.grain = o_parGrain(tp, begin, end, grain);
+	r.reduceFn = fn;
+	r.join = join;
+	r.arg = arg;
+	r.acc = acc;
+	r.identity = identity;
+	r.accSz = accSz;
+	o_parRun(&r);
+
+	return OSA_SUCCESS;
+}
@@ -1,5 +1,6 @@
 #include "osa.h"
 #include "osa_threads.h"
+#include "osa_threads_internal.h"
 #include <string.h>
 #include <assert.h>
 
@@ -26,7 +27,18 @@ char * osa_errStr(int err)
 	}
 }
 
-static ret_e o_set_attributes(pthread_attr_t &attr, osa_thread_priority_e &prio, osa_thread_stack_t *stack)
+static void o_cpuSet2os(const osa_cpuSet_t &cpus, cpu_set_t &osSet)
+{
+	CPU_ZERO(&osSet);
+	for(i32_t cpu = 0; cpu < OSA_CPU_MAX && cpu < CPU_SETSIZE; cpu++)
+	{
+		if(osa_cpuSet_has(cpus, cpu))
+			CPU_SET(cpu, &osSet);
+	}
+}
+
+static ret_e o_set_attributes(pthread_attr_t &attr, osa_thread_priority_e &prio, osa_thread_stack_t *stack,
+			const osa_cpuSet_t * cpus)
 {
 	char * func = "o_set_attributes";
 	if(0 != pthread_attr_init (&attr))
@@ -47,7 +59,7 @@ static ret_e o_set_attributes(pthread_attr_t &attr, osa_thread_priority_e &prio,
 			struct sched_param schdPrio;
 			schdPrio.sched_priority = min + ((max-min)/4);
 			pthread_attr_setschedparam(&attr, &schdPrio);
-			osa_loge("%s: Priority: (OS-min=%d, OS-max=%d), ThreadPrioritySelected=%d", min, max, schdPrio.sched_priority);
+			osa_logd("%s: Priority: (OS-min=%d, OS-max=%d), ThreadPrioritySelected=%d", func, min, max, schdPrio.sched_priority);
 		}
 		break;
 		case OSA_THREAD_PRIO_CRITICAL:
@@ -60,12 +72,12 @@ static ret_e o_set_attributes(pthread_attr_t &attr, osa_thread_priority_e &prio,
 			struct sched_param schdPrio;
 			schdPrio.sched_priority = min + 3 * ((max-min)/4);
 			pthread_attr_setschedparam(&attr, &schdPrio);
-			osa_loge("%s: Priority: (OS-min=%d, OS-max=%d), ThreadPrioritySelected=%d", func, min, max, schdPrio.sched_priority);
+			osa_logd("%s: Priority: (OS-min=%d, OS-max=%d), ThreadPrioritySelected=%d", func, min, max, schdPrio.sched_priority);
 		}
 		break;
 		case OSA_THREAD_PRIO_DEFAULT:
 		case OSA_THREAD_PRIO_LOW:
-			osa_loge("%s: Thread priority kept to default");
+			osa_logd("%s: Thread priority kept to default", func);
 		break;
 	}
 
@@ -73,30 +85,49 @@ static ret_e o_set_attributes(pthread_attr_t &attr, osa_thread_priority_e &prio,
 	{
 		if(0 != pthread_attr_setstack(&attr, stack->buf, stack->sz))
 		{
-			osa_loge("o_set_attributes: pthread_attr_setstack failed. user provided stack=%x, size=%d", stack->buf, stack->sz);
+			osa_loge("o_set_attributes: pthread_attr_setstack failed. user provided stack=%p, size=%d", stack->buf, stack->sz);
 			return OSA_ERR_COREFUNCFAIL;
 		}
 	}
+
+	if(NULL != cpus)
+	{
+		/* Set before the thread starts, so it never runs (and touches its first memory pages) on a cpu it should not */
+		cpu_set_t osSet;
+		o_cpuSet2os(*cpus, osSet);
+		if(0 != pthread_attr_setaffinity_np(&attr, sizeof(osSet), &osSet))
+		{
+			osa_loge("%s: pthread_attr_setaffinity_np failed. numCpus=%u", func, osa_cpuSet_count(*cpus));
+			return OSA_ERR_BADPARAM;
+		}
+	}
+	return OSA_SUCCESS;
 }
 
 ret_e osa_thread_create(osa_threadHd_t &tHd, ThreadFunc tFunc, osa_thread_priority_e &prio, char thrName[15], void * arg,
-			osa_thread_stack_t *stack)
+			osa_thread_stack_t *stack, const osa_cpuSet_t * cpus)
 {
 	char * func = "osa_thread_create";
 
 	if(NULL == func || osa_strlen(thrName)> 15)
 	{
-		osa_loge("%s: error: in params. func=%x, thrName=%s", func, thrName);
+		osa_loge("%s: error: in params. thrName=%s", func, thrName);
 	}
 
-	osa_logd("%s: entered. ThreadName=%d, tFunc=%x, prio=%s, arg=%d, stack=%x", func, 
-			thrName, tFunc, osa_enum2str(prio), arg, stack);
+	osa_logd("%s: entered. ThreadName=%s, tFunc=%p, prio=%s, arg=%p, stack=%p", func, 
+			thrName, (void *)tFunc, osa_enum2str(prio), arg, stack);
 
 	osa_ThreadHandle_t *hd = (osa_ThreadHandle_t *)&tHd;
 	pthread_attr_t attr;
 
-	o_set_attributes(attr, prio, stack);
+	ret_e ret = o_set_attributes(attr, prio, stack, cpus);
+	if(OSA_ERR_BADPARAM == ret)
+	{
+		pthread_attr_destroy(&attr);
+		return ret;
+	}
 	int result = pthread_create(&(hd->t), &attr, tFunc, arg);
+	pthread_attr_destroy(&attr);
 	if(0 != result)
 	{
 		osa_loge("%s: pthread_create failed. err=%s", func, osa_errStr(result));
@@ -108,7 +139,8 @@ ret_e osa_thread_create(osa_threadHd_t &tHd, ThreadFunc tFunc, osa_thread_priori
 		osa_loge("%s: pthread_setname_np failed, but we will continue", func);
 	}
 
-	osa_logi("%s: success. ThreadId=%x, ThreadName=%s", hd->t, thrName);
+	osa_logi("%s: success. ThreadId=%lx, ThreadName=%s", func, (unsigned long)hd->t, thrName);
+	return OSA_SUCCESS;
 }
 
 ret_e osa_thread_exit(void *retVal)
@@ -119,11 +151,263 @@ ret_e osa_thread_exit(void *retVal)
 	t = pthread_self();
 	pthread_getname_np(t, thrName, 15);
 	
-	osa_logi("osa_thread_exit: Thread=%x, Name=%s", t, thrName);
+	osa_logi("osa_thread_exit: Thread=%lx, Name=%s", (unsigned long)t, thrName);
 
 	pthread_exit(retVal);
 }
 
+ret_e osa_thread_join(osa_threadHd_t &tHd, void ** retVal)
+{
+	char * func = "osa_thread_join";
+	osa_ThreadHandle_t *hd = (osa_ThreadHandle_t *)&tHd;
+
+	int result = pthread_join(hd->t, retVal);
+	if(0 != result)
+	{
+		osa_loge("%s: pthread_join failed. err=%s", func, osa_errStr(result));
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	osa_logd("%s: ThreadId=%lx joined", func, (unsigned long)hd->t);
+	return OSA_SUCCESS;
+}
+
+ret_e osa_thread_setAffinity(const osa_cpuSet_t &cpus)
+{
+	char * func = "osa_thread_setAffinity";
+	cpu_set_t osSet;
+
+	o_cpuSet2os(cpus, osSet);
+	int result = pthread_setaffinity_np(pthread_self(), sizeof(osSet), &osSet);
+	if(0 != result)
+	{
+		osa_loge("%s: pthread_setaffinity_np failed. numCpus=%u, err=%s", func, osa_cpuSet_count(cpus), osa_errStr(result));
+		return (EINVAL == result) ? OSA_ERR_BADPARAM : OSA_ERR_COREFUNCFAIL;
+	}
+	return OSA_SUCCESS;
+}
+
+
+/********************************************************
+*				C P U   T O P O L O G Y
+*********************************************************/
+
+#define O_SYS_CPU 	"/sys/devices/system/cpu"
+#define O_SYS_NODE 	"/sys/devices/system/node"
+
+/* Read a small sysfs file into buf. false if it does not exist */
+static bool o_sysRead(const char * path, char * buf, int bufSz)
+{
+	FILE * f = fopen(path, "r");
+	size_t n;
+
+	if(NULL == f)
+		return false;
+	n = fread(buf, 1, bufSz - 1, f);
+	fclose(f);
+	buf[n] = '\0';
+	return 0 < n;
+}
+
+static i32_t o_sysReadInt(const char * path, i32_t dflt)
+{
+	char buf[32];
+
+	return o_sysRead(path, buf, sizeof(buf)) ? atoi(buf) : dflt;
+}
+
+/* Parse a cpu list such as "0-3,8,10-11" (the format of cpulist/shared_cpu_list/online) */
+static bool o_sysReadList(const char * path, osa_cpuSet_t &set)
+{
+	char buf[4096];
+	char * p = buf;
+	long first, last;
+
+	osa_cpuSet_zero(set);
+	if(!o_sysRead(path, buf, sizeof(buf)))
+		return false;
+
+	while('\0' != *p && '\n' != *p)
+	{
+		first = last = strtol(p, &p, 10);
+		if('-' == *p)
+			last = strtol(p + 1, &p, 10);
+		for(long cpu = first; cpu <= last; cpu++)
+			osa_cpuSet_add(set, (i32_t)cpu);
+		if(',' != *p)
+			break;
+		p++;
+	}
+	return true;
+}
+
+/* Lowest cpu of a set, -1 if empty */
+static i32_t o_cpuSetFirst(const osa_cpuSet_t &set)
+{
+	for(i32_t i = 0; i < OSA_CPU_MAX / 64; i++)
+	{
+		if(0 != set.bits[i])
+			return i * 64 + __builtin_ctzll(set.bits[i]);
+	}
+	return -1;
+}
+
+/* Id of the unified or data cache at 'level' seen by 'cpu' */
+static i32_t o_cacheId(i32_t cpu, i32_t level)
+{
+	char path[128], type[32];
+	osa_cpuSet_t shared;
+
+	for(i32_t idx = 0; ; idx++)
+	{
+		snprintf(path, sizeof(path), O_SYS_CPU "/cpu%d/cache/index%d/level", cpu, idx);
+		i32_t lvl = o_sysReadInt(path, -1);
+		if(-1 == lvl)
+			return -1;
+		if(level != lvl)
+			continue;
+
+		snprintf(path, sizeof(path), O_SYS_CPU "/cpu%d/cache/index%d/type", cpu, idx);
+		if(!o_sysRead(path, type, sizeof(type)) || 0 == strncmp(type, "Instruction", 11))
+			continue;
+
+		snprintf(path, sizeof(path), O_SYS_CPU "/cpu%d/cache/index%d/shared_cpu_list", cpu, idx);
+		return o_sysReadList(path, shared) ? o_cpuSetFirst(shared) : -1;
+	}
+}
+
+ret_e osa_topology_get(osa_topology_t &topo)
+{
+	char * func = "osa_topology_get";
+	char path[128];
+	osa_cpuSet_t online, nodeCpus;
+	i32_t coreKey[OSA_CPU_MAX], pkgKey[OSA_CPU_MAX];
+	u32_t i, j;
+
+	memset(&topo, 0, sizeof(topo));
+	if(!o_sysReadList(O_SYS_CPU "/online", online))
+	{
+		osa_loge("%s: cannot read " O_SYS_CPU "/online", func);
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	for(i32_t cpu = 0; cpu < OSA_CPU_MAX; cpu++)
+	{
+		if(!osa_cpuSet_has(online, cpu))
+			continue;
+
+		osa_cpuInfo_t &c = topo.cpus[topo.numCpus];
+		c.cpu = cpu;
+		c.node = 0;
+		c.l2Id = o_cacheId(cpu, 2);
+		c.l3Id = o_cacheId(cpu, 3);
+
+		snprintf(path, sizeof(path), O_SYS_CPU "/cpu%d/topology/physical_package_id", cpu);
+		pkgKey[topo.numCpus] = o_sysReadInt(path, 0);
+		/* core_id is only unique inside a package. Without it, every cpu is its own core */
+		snprintf(path, sizeof(path), O_SYS_CPU "/cpu%d/topology/core_id", cpu);
+		coreKey[topo.numCpus] = o_sysReadInt(path, -1 - cpu);
+		topo.numCpus++;
+	}
+
+	/* Number cores densely, in the order of their first cpu. Packages keep the OS number, as lscpu prints it */
+	for(i = 0; i < topo.numCpus; i++)
+	{
+		bool newPkg = true;
+
+		topo.cpus[i].package = pkgKey[i];
+		topo.cpus[i].core = -1;
+		for(j = 0; j < i; j++)
+		{
+			if(pkgKey[j] != pkgKey[i])
+				continue;
+			newPkg = false;
+			if(coreKey[j] == coreKey[i])
+			{
+				topo.cpus[i].core = topo.cpus[j].core;
+				break;
+			}
+		}
+		if(newPkg)
+			topo.numPackages++;
+		if(-1 == topo.cpus[i].core)
+			topo.cpus[i].core = topo.numCores++;
+	}
+
+	topo.numNodes = 1;
+	for(i32_t node = 0; node < OSA_CPU_MAX; node++)
+	{
+		snprintf(path, sizeof(path), O_SYS_NODE "/node%d/cpulist", node);
+		if(!o_sysReadList(path, nodeCpus))
+			continue;
+		for(i = 0; i < topo.numCpus; i++)
+		{
+			if(osa_cpuSet_has(nodeCpus, topo.cpus[i].cpu))
+				topo.cpus[i].node = node;
+		}
+		if((u32_t)node + 1 > topo.numNodes)
+			topo.numNodes = node + 1;
+	}
+
+	osa_logi("%s: cpus=%u, cores=%u, packages=%u, nodes=%u", func, topo.numCpus, topo.numCores, topo.numPackages,
+			topo.numNodes);
+	return OSA_SUCCESS;
+}
+
+void osa_topology_nodeCpus(const osa_topology_t &topo, i32_t node, osa_cpuSet_t &cpus)
+{
+	osa_cpuSet_zero(cpus);
+	for(u32_t i = 0; i < topo.numCpus; i++)
+	{
+		if(node == topo.cpus[i].node)
+			osa_cpuSet_add(cpus, topo.cpus[i].cpu);
+	}
+}
+
+u32_t osa_topology_spread(const osa_topology_t &topo, i32_t * order, u32_t max)
+{
+	bool used[OSA_CPU_MAX], coreTaken[OSA_CPU_MAX];
+	u32_t n = 0, placed;
+	cpu_set_t allowed;
+
+	if(NULL == order)
+		return 0;
+
+	/* Cpus the process may not use (taskset, container cpusets) are left out: pinning a thread to them fails */
+	memset(used, 0, sizeof(used));
+	if(0 == sched_getaffinity(0, sizeof(allowed), &allowed))
+	{
+		for(u32_t i = 0; i < topo.numCpus; i++)
+			used[i] = (topo.cpus[i].cpu >= CPU_SETSIZE || !CPU_ISSET(topo.cpus[i].cpu, &allowed));
+	}
+	/* Each round takes at most one cpu per core (one SMT level), and within a round goes round robin over the nodes */
+	while(n < max)
+	{
+		memset(coreTaken, 0, sizeof(coreTaken));
+		placed = n;
+		for(bool more = true; more && n < max; )
+		{
+			more = false;
+			for(u32_t node = 0; node < topo.numNodes && n < max; node++)
+			{
+				for(u32_t i = 0; i < topo.numCpus; i++)
+				{
+					const osa_cpuInfo_t &c = topo.cpus[i];
+					if(used[i] || coreTaken[c.core] || (i32_t)node != c.node)
+						continue;
+					used[i] = coreTaken[c.core] = true;
+					order[n++] = c.cpu;
+					more = true;
+					break;
+				}
+			}
+		}
+		if(placed == n)
+			break;
+	}
+	return n;
+}
+
 
 /********************************************************
 *					M U T E X
@@ -133,6 +417,7 @@ ret_e osa_thread_exit(void *retVal)
 osa_mutex :: osa_mutex(void)
 {
 	isAlive=0;
+	flags=0;
 }
 
 
@@ -141,24 +426,34 @@ osa_mutex :: ~osa_mutex(void)
 	if(1 == isAlive)
 	{
 		pthread_mutex_destroy(&mutex);
-		osa_logi("osa_mutex::destructor: Mutex %x destroyed", &mutex);
+		osa_logi("osa_mutex::destructor: Mutex %p destroyed", &mutex);
 	}
 }
 
-ret_e osa_mutex :: create(void)
+ret_e osa_mutex :: create(u32_t flags)
 {
 	int result = pthread_mutex_init(&mutex, NULL);
 
 	if(0 == result)
 	{
-		osa_logd("osa_mutex::create Mutex %x created", &mutex);
+		osa_logd("osa_mutex::create Mutex %p created. flags=0x%x", &mutex, flags);
 	}
 	else
 	{
-		osa_logd("osa_mutex::create Mutex %x creation failed", &mutex);
+		osa_logd("osa_mutex::create Mutex %p creation failed", &mutex);
 		return OSA_ERR_COREFUNCFAIL;
 	}
 
+	this->flags = flags;
+	nAcq.store(0, std::memory_order_relaxed);
+	nContended.store(0, std::memory_order_relaxed);
+	nSpinAcq.store(0, std::memory_order_relaxed);
+	waitNs.store(0, std::memory_order_relaxed);
+	maxWaitNs.store(0, std::memory_order_relaxed);
+	holdNs.store(0, std::memory_order_relaxed);
+	maxHoldNs.store(0, std::memory_order_relaxed);
+	lockedAt = 0;
+
 	isAlive=1;
 	return OSA_SUCCESS;
 }
@@ -170,18 +465,79 @@ ret_e osa_mutex :: destroy()
 	if(1 == isAlive)
 	{
 		pthread_mutex_destroy(&mutex);
-		osa_logd("osa_mutex::destroy: Mutex %x destroyed", &mutex);
+		osa_logd("osa_mutex::destroy: Mutex %p destroyed", &mutex);
 		isAlive = 0;
 	}
+
+	return OSA_SUCCESS;
+}
+
+/* The counters have a single writer at a time (the owner of the mutex), so a plain load+store is enough. The atomics
+   only let getStats read them without taking the mutex */
+static inline void o_statAdd(std::atomic<u64_t> &stat, u64_t val)
+{
+	stat.store(stat.load(std::memory_order_relaxed) + val, std::memory_order_relaxed);
+}
+
+static inline void o_statMax(std::atomic<u64_t> &stat, u64_t val)
+{
+	if(val > stat.load(std::memory_order_relaxed))
+		stat.store(val, std::memory_order_relaxed);
+}
+
+/* holdStart/holdEnd : Called by the owner right after getting/right before releasing the mutex (also around cond waits) */
+void osa_mutex :: holdStart()
+{
+	lockedAt = o_monotonicNs();
+}
+
+void osa_mutex :: holdEnd()
+{
+	u64_t held = (u64_t)(o_monotonicNs() - lockedAt);
+
+	o_statAdd(holdNs, held);
+	o_statMax(maxHoldNs, held);
 }
 
 ret_e osa_mutex :: lock(char * locker)
 {
 	char * func = "osa_mutex::lock";
+	i64_t waitStart = 0;
+	int result, spin, pause;
 
 	if(1 == isAlive)
 	{
-		int result = pthread_mutex_lock(&mutex);
+		result = pthread_mutex_trylock(&mutex);
+		if(EBUSY == result)
+		{
+			if(flags & OSA_MUTEX_STATS)
+				waitStart = o_monotonicNs();
+
+			/* Adaptive : retry with exponential backoff, so the spinners don't keep stealing the cache line of the mutex
+			   from the owner. pthread_mutex_lock sleeps on a futex */
+			if(flags & OSA_MUTEX_ADAPTIVE)
+			{
+				for(spin = o_spinCount(OSA_MUTEX_SPIN), pause = 1; 0 < spin && EBUSY == result; spin -= pause, pause *= 2)
+				{
+					for(int i = 0; i < pause; i++)
+						o_cpuRelax();
+					result = pthread_mutex_trylock(&mutex);
+				}
+			}
+
+			if(EBUSY == result)
+				result = pthread_mutex_lock(&mutex);
+			else if(0 == result && (flags & OSA_MUTEX_STATS))
+				o_statAdd(nSpinAcq, 1);
+
+			if(0 == result && (flags & OSA_MUTEX_STATS))
+			{
+				u64_t waited = (u64_t)(o_monotonicNs() - waitStart);
+				o_statAdd(nContended, 1);
+				o_statAdd(waitNs, waited);
+				o_statMax(maxWaitNs, waited);
+			}
+		}
 
 		if(0 != result)
 		{
@@ -189,11 +545,17 @@ ret_e osa_mutex :: lock(char * locker)
 			return OSA_ERR_COREFUNCFAIL;
 		}
 
-		osa_logv("%s: mutex %x locked by ", func, &mutex, locker?locker:"--");
+		if(flags & OSA_MUTEX_STATS)
+		{
+			o_statAdd(nAcq, 1);
+			holdStart();
+		}
+
+		osa_logv("%s: mutex %p locked by %s", func, &mutex, locker?locker:"--");
 	}
 	else
 	{
-		osa_loge("%s: error: mutex %x is destroyed. locker=%s. Dying", func, &mutex, locker?locker:"--");
+		osa_loge("%s: error: mutex %p is destroyed. locker=%s. Dying", func, &mutex, locker?locker:"--");
 		osa_assert(0);
 	}
 
@@ -206,6 +568,9 @@ ret_e osa_mutex :: unlock(char * unlocker)
 
 	if(1 == isAlive)
 	{
+		if(flags & OSA_MUTEX_STATS)
+			holdEnd();
+
 		int result = pthread_mutex_unlock(&mutex);
 
 		if(0 != result)
@@ -213,19 +578,41 @@ ret_e osa_mutex :: unlock(char * unlocker)
 			osa_loge("%s: error: failed. result=%d\n", func, result);
 			return OSA_ERR_COREFUNCFAIL;
 		}
-		osa_logv("%s: mutex %x unlocked by ", func, &mutex, unlocker?unlocker:"--");
+		osa_logv("%s: mutex %p unlocked by %s", func, &mutex, unlocker?unlocker:"--");
 	}
 	else
 	{
-		osa_loge("%s: error: mutex %x is destroyed. unlocker=%s. Dying", func, &mutex, unlocker?unlocker:"--");
+		osa_loge("%s: error: mutex %p is destroyed. unlocker=%s. Dying", func, &mutex, unlocker?unlocker:"--");
 		osa_assert(0);
 	}
 
-	osa_logd("mutex %x unlocked by ", &mutex, unlocker?unlocker:"--");
-
 	return OSA_SUCCESS;	
 }
 
+ret_e osa_mutex :: getStats(osa_mutexStats_t &stats)
+{
+	if(1 != isAlive || 0 == (flags & OSA_MUTEX_STATS))
+	{
+		osa_loge("osa_mutex::getStats:error: mutex %p is not created with OSA_MUTEX_STATS. flags=0x%x", &mutex, flags);
+		return OSA_ERR_BADPARAM;
+	}
+
+	stats.acquisitions 	= nAcq.load(std::memory_order_relaxed);
+	stats.contended 	= nContended.load(std::memory_order_relaxed);
+	stats.spinAcquired 	= nSpinAcq.load(std::memory_order_relaxed);
+	stats.waitNs 		= waitNs.load(std::memory_order_relaxed);
+	stats.maxWaitNs 	= maxWaitNs.load(std::memory_order_relaxed);
+	stats.holdNs 		= holdNs.load(std::memory_order_relaxed);
+	stats.maxHoldNs 	= maxHoldNs.load(std::memory_order_relaxed);
+	return OSA_SUCCESS;
+}
+
+
+void * osa_mutex :: getNativeMutex()
+{
+	return (void *)&mutex;
+}
+
 
 /********************************************************
 *					S E M A P H O R E
@@ -280,7 +667,7 @@ osa_semaphore :: ~osa_semaphore()
 		return; /* TO DO: Do we just return? assert? call destroy anyways?? */
 		}
 
-		osa_logd("%s: %x destroyed", func, &sem);
+		osa_logd("%s: %p destroyed", func, &sem);
 		isAlive = 0;
 	}
 }
@@ -307,7 +694,7 @@ ret_e osa_semaphore :: destroy()
 		}
 
 		isAlive = 0;
-		osa_logd("%s: %x destroyed", func, &sem);
+		osa_logd("%s: %p destroyed", func, &sem);
 	}
 }
 
@@ -323,11 +710,11 @@ ret_e osa_semaphore :: wait(char * waiter)
 			return OSA_ERR_COREFUNCFAIL;
 		}
 
-		osa_logv("semaphore %x locked by %s", &sem, waiter?waiter:"--");
+		osa_logv("semaphore %p locked by %s", &sem, waiter?waiter:"--");
 	}
 	else
 	{
-		osa_logd("semaphore %x is destroyed. waiter=%s", &sem, waiter?waiter:"--");
+		osa_logd("semaphore %p is destroyed. waiter=%s", &sem, waiter?waiter:"--");
 		osa_assert(1==0);
 	}
 
@@ -348,11 +735,11 @@ ret_e osa_semaphore :: post(char * poster)
 			return OSA_ERR_COREFUNCFAIL;
 		}
 
-		osa_logv("%s: semaphore %x unlocked by %s", func, &sem, poster?poster:"--");
+		osa_logv("%s: semaphore %p unlocked by %s", func, &sem, poster?poster:"--");
 	}
 	else
 	{
-		osa_loge("%s: semaphore %x is destroyed. poster=%s. Dying", func, &sem, poster?poster:"--");
+		osa_loge("%s: semaphore %p is destroyed. poster=%s. Dying", func, &sem, poster?poster:"--");
 		osa_assert(0);
 	}
 
@@ -427,19 +814,25 @@ ret_e osa_cond :: wait(osa_mutex &m, char * waiter)
 	if(isAlive)
 	{
 		pthread_mutex_t * mutex = (pthread_mutex_t *)m.getNativeMutex();
+
+		/* The mutex is not held while we sleep, don't count that time as hold time */
+		if(m.flags & OSA_MUTEX_STATS)
+			m.holdEnd();
 		int result = pthread_cond_wait(&cond, mutex);
+		if(m.flags & OSA_MUTEX_STATS)
+			m.holdStart();
 
 		if(0 != result)
 		{
-			osa_loge("osa_cond::wait failed. result=\n", osa_errStr(result));
+			osa_loge("osa_cond::wait failed. result=%s", osa_errStr(result));
 			return OSA_ERR_COREFUNCFAIL;
 		}
 
-		osa_logv("cond %x locked by %s", &cond, waiter?waiter:"--");
+		osa_logv("cond %p locked by %s", &cond, waiter?waiter:"--");
 	}
 	else
 	{
-		osa_logd("cond %x is already destroyed. waiter=%s", &cond, waiter?waiter:"--");
+		osa_logd("cond %p is already destroyed. waiter=%s", &cond, waiter?waiter:"--");
 		osa_assert(1==0);
 	}
 
@@ -460,11 +853,11 @@ ret_e osa_cond :: signal(char * poster)
 			return OSA_ERR_COREFUNCFAIL;
 		}
 
-		osa_logv("%s: cond %x signalled by %s", func, &cond, poster?poster:"--");
+		osa_logv("%s: cond %p signalled by %s", func, &cond, poster?poster:"--");
 	}
 	else
 	{
-		osa_loge("%s: cond %x is destroyed. poster=%s. Dying", func, &cond, poster?poster:"--");
+		osa_loge("%s: cond %p is destroyed. poster=%s. Dying", func, &cond, poster?poster:"--");
 		osa_assert(0);
 	}
 
@@ -485,11 +878,11 @@ ret_e osa_cond :: broadcast(char * poster)
 			return OSA_ERR_COREFUNCFAIL;
 		}
 
-		osa_logv("%s: cond %x broadcasted by %s", func, &cond, poster?poster:"--");
+		osa_logv("%s: cond %p broadcasted by %s", func, &cond, poster?poster:"--");
 	}
 	else
 	{
-		osa_loge("%s: cond %x is destroyed. broadcaster=%s. Dying", func, &cond, poster?poster:"--");
+		osa_loge("%s: cond %p is destroyed. broadcaster=%s. Dying", func, &cond, poster?poster:"--");
 		osa_assert(0);
 	}
 
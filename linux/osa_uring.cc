@@ -0,0 +1,1054 @@
+#include "osa.h"
+#include "errno.h"
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "osa_sock_internal.h"
+
+/********************************************************
+*		E V E N T    L O O P   ( I O _ U R I N G )
+*********************************************************/
+
+/* io_uring backend of osa_eventLoop. There is no liburing dependency: the rings are set up with the raw system calls and
+   shared with the kernel through mmap.
+	- submission ring : we fill requests (sqe) and move the tail. The kernel moves the head as it takes them.
+	- completion ring : the kernel writes results (cqe) and moves the tail. We move the head.
+	- buffer ring 	  : receive buffers the kernel picks from for multishot recv. We give buffers back by moving its tail.
+   Every request carries the osa_uringSock_t of its socket and the operation in its user_data.
+   All the functions here run in the loop thread (or before run() is called). */
+
+#define O_URING_OP_WAKE		1		/* Multishot poll on wakeFd */
+#define O_URING_OP_ACCEPT	2		/* Multishot accept on a listening socket */
+#define O_URING_OP_RECV		3		/* Multishot recv on a stream socket */
+#define O_URING_OP_POLL		4		/* Multishot poll on any other socket (e.g. UDP), one shot poll on a starved stream */
+#define O_URING_OP_SEND		5
+#define O_URING_OP_CANCEL	6
+#define O_URING_OP_POLLOUT	7		/* One shot poll for writability. The send queue waits for it when the socket is full */
+#define O_URING_OP_MASK		7		/* osa_uringSock_t comes from malloc, so the low 3 bits of its address are free */
+
+#define O_URING_BGID		0		/* Buffer group of the loop's buffer ring */
+
+/* osa_uringSock_t : State of one socket in an io_uring loop. Requests point to it and not to the osa_socket, so it is freed
+					 only after the kernel has completed the last of them, even if the socket is gone long before. */
+typedef struct osa_uringSock_t
+{
+	osa_socket *			sock;			/* NULL once the socket has left the loop */
+	int 					fd;
+	int 					op; 			/* Multishot request of this socket: O_URING_OP_ACCEPT/RECV/POLL */
+	int 					armed;			/* Multishot request is active */
+	int 					txBusy; 		/* A send request is active */
+	i32_t 					inflight;		/* Requests the kernel still owns */
+
+	/* Received data: chain of buffer ids, linked through osa_uring_t::bufNext */
+	i32_t 					rxHead;
+	i32_t 					rxTail;
+	i32_t 					rxOff;			/* Bytes of rxHead already copied out by recv() */
+	i32_t 					rxCnt;			/* Buffers in the chain */
+	int 					rxPaused;		/* recv was cancelled because the socket holds too many buffers */
+	int 					rxEof;
+	int 					rxErr; 			/* errno of a failed recv. Given to recv() after the data received before it */
+	int 					starved;		/* recv stopped because the loop ran out of buffers */
+	int 					polling;		/* One shot poll standing in for the stopped recv */
+	struct osa_uringSock_t *starvedNext;
+
+	/* Listener: connections accepted by the kernel and not yet taken by accept() */
+	int 					acceptFds[OSA_URING_ACCEPT_STASH];
+	u32_t 					acceptHead;
+	u32_t 					acceptCnt;
+	int 					acceptErr;
+
+	/* sendto: sendmsg arguments must stay valid till the request completes */
+	struct msghdr 			txMsg;
+	struct iovec 			txIov[OSA_SOCK_IOV_MAX];
+
+	struct osa_uringSock_t *prev;			/* All the states of the loop, for destroy() */
+	struct osa_uringSock_t *next;
+}osa_uringSock_t;
+
+typedef struct osa_uring_t
+{
+	int 					ringFd;
+
+	/* Submission ring */
+	void *					sqRing;
+	size_t 					sqRingSz;
+	u32_t *					sqHead;
+	u32_t *					sqTail;
+	u32_t 					sqMask;
+	u32_t 					sqEntries;
+	u32_t 					sqLocalTail;	/* sqes filled so far. Published to the kernel by o_uringSubmit */
+	struct io_uring_sqe *	sqes;
+	size_t 					sqesSz;
+
+	/* Completion ring */
+	void *					cqRing;
+	size_t 					cqRingSz;
+	u32_t *					cqHead;
+	u32_t *					cqTail;
+	u32_t 					cqMask;
+	u32_t 					cqEntries;
+	struct io_uring_cqe *	cqes;
+
+	/* Receive buffers */
+	struct io_uring_buf_ring *bufRing;
+	u8_t *					bufs;
+	u16_t 					bufTail;
+	i32_t 					bufFree;		/* Buffers the kernel can pick from */
+	i32_t 					bufNext[OSA_URING_NUM_BUFS];
+	i32_t 					bufLen[OSA_URING_NUM_BUFS];
+
+	osa_uringSock_t *		starved;		/* Sockets waiting for free buffers */
+	osa_uringSock_t *		socks;
+}osa_uring_t;
+
+static int o_uringSetup(u32_t entries, struct io_uring_params *p)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int o_uringRegister(int ringFd, u32_t opcode, void *arg, u32_t nrArgs)
+{
+	return (int)syscall(__NR_io_uring_register, ringFd, opcode, arg, nrArgs);
+}
+
+/* o_uringSubmit : Hand the filled sqes to the kernel and wait for 'waitNr' completions, at most 'timeoutMs' milli seconds
+				   (-1: no limit). Returns what io_uring_enter returns */
+static int o_uringSubmit(osa_uring_t *r, u32_t waitNr, i32_t timeoutMs)
+{
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	u32_t flags = 0;
+	u32_t toSubmit;
+
+	__atomic_store_n(r->sqTail, r->sqLocalTail, __ATOMIC_RELEASE);
+	toSubmit = r->sqLocalTail - __atomic_load_n(r->sqHead, __ATOMIC_ACQUIRE);
+
+	if(0 == waitNr)
+	{
+		if(0 == toSubmit)
+			return 0;
+		return (int)syscall(__NR_io_uring_enter, r->ringFd, toSubmit, 0, 0, NULL, 0);
+	}
+
+	flags = IORING_ENTER_GETEVENTS;
+	if(0 > timeoutMs)
+		return (int)syscall(__NR_io_uring_enter, r->ringFd, toSubmit, waitNr, flags, NULL, 0);
+
+	memset(&arg, 0, sizeof(arg));
+	ts.tv_sec = timeoutMs / 1000;
+	ts.tv_nsec = (long long)(timeoutMs % 1000) * 1000000;
+	arg.ts = (u64_t)(uintptr_t)&ts;
+	flags |= IORING_ENTER_EXT_ARG;
+
+	return (int)syscall(__NR_io_uring_enter, r->ringFd, toSubmit, waitNr, flags, &arg, sizeof(arg));
+}
+
+/* o_uringGetSqe : Next free sqe (zeroed). NULL if the kernel has not taken any of the OSA_URING_SQ_ENTRIES yet */
+static struct io_uring_sqe * o_uringGetSqe(osa_uring_t *r)
+{
+	struct io_uring_sqe *sqe;
+
+	if(r->sqLocalTail - __atomic_load_n(r->sqHead, __ATOMIC_ACQUIRE) >= r->sqEntries)
+	{
+		o_uringSubmit(r, 0, 0);
+		if(r->sqLocalTail - __atomic_load_n(r->sqHead, __ATOMIC_ACQUIRE) >= r->sqEntries)
+			return NULL;
+	}
+
+	sqe = &r->sqes[r->sqLocalTail & r->sqMask];
+	memset(sqe, 0, sizeof(*sqe));
+	r->sqLocalTail++;
+	return sqe;
+}
+
+/* o_uringPutBuf : Give receive buffer 'bid' (back) to the kernel */
+static void o_uringPutBuf(osa_uring_t *r, i32_t bid)
+{
+	/* Not bufRing->bufs: in C++ the flexible array of the kernel header starts 8 bytes too late */
+	struct io_uring_buf *buf = (struct io_uring_buf *)r->bufRing + (r->bufTail & (OSA_URING_NUM_BUFS - 1));
+
+	/* Field by field: the ring tail lives in the 'resv' of the first entry */
+	buf->addr = (u64_t)(uintptr_t)(r->bufs + (size_t)bid * OSA_URING_BUF_SZ);
+	buf->len = OSA_URING_BUF_SZ;
+	buf->bid = (u16_t)bid;
+
+	r->bufTail++;
+	r->bufFree++;
+	__atomic_store_n(&r->bufRing->tail, r->bufTail, __ATOMIC_RELEASE);
+}
+
+static ret_e o_uringPollWake(osa_uring_t *r, int wakeFd)
+{
+	struct io_uring_sqe *sqe = o_uringGetSqe(r);
+
+	if(NULL == sqe)
+		return OSA_ERR_QFULL;
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = wakeFd;
+	sqe->len = IORING_POLL_ADD_MULTI;
+	sqe->poll32_events = POLLIN;
+	sqe->user_data = O_URING_OP_WAKE;
+	return OSA_SUCCESS;
+}
+
+/* o_uringArm : Submit the multishot request of the socket */
+static ret_e o_uringArm(osa_uring_t *r, osa_uringSock_t *ctx)
+{
+	struct io_uring_sqe *sqe = o_uringGetSqe(r);
+
+	if(NULL == sqe)
+	{
+		osa_loge("o_uringArm:error: submission ring is full. fd=%d is not armed", ctx->fd);
+		return OSA_ERR_QFULL;
+	}
+
+	sqe->fd = ctx->fd;
+	sqe->user_data = (u64_t)(uintptr_t)ctx | (u64_t)ctx->op;
+
+	switch(ctx->op)
+	{
+		case O_URING_OP_ACCEPT:
+			sqe->opcode = IORING_OP_ACCEPT;
+			sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+			break;
+
+		case O_URING_OP_RECV:
+			sqe->opcode = IORING_OP_RECV;
+			sqe->ioprio = IORING_RECV_MULTISHOT;
+			sqe->flags = IOSQE_BUFFER_SELECT;
+			sqe->buf_group = O_URING_BGID;
+			break;
+
+		default:
+			sqe->opcode = IORING_OP_POLL_ADD;
+			sqe->len = IORING_POLL_ADD_MULTI;
+			sqe->poll32_events = POLLIN | POLLRDHUP;
+			break;
+	}
+
+	ctx->armed = 1;
+	ctx->inflight++;
+	return OSA_SUCCESS;
+}
+
+/* o_uringPollOnce : Watch a stream socket whose recv has stopped (out of buffers), so that it is still served by reading
+					 the socket directly */
+static void o_uringPollOnce(osa_uring_t *r, osa_uringSock_t *ctx)
+{
+	struct io_uring_sqe *sqe = o_uringGetSqe(r);
+
+	if(NULL == sqe)
+	{
+		osa_loge("o_uringPollOnce:error: submission ring is full. fd=%d is not watched", ctx->fd);
+		return;
+	}
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = ctx->fd;
+	sqe->poll32_events = POLLIN | POLLRDHUP;
+	sqe->user_data = (u64_t)(uintptr_t)ctx | O_URING_OP_POLL;
+
+	ctx->polling = 1;
+	ctx->inflight++;
+}
+
+/* o_uringPollOut : Wait for the socket to take data again before the send queue is flushed any further. The completion
+					flushes it (O_URING_OP_POLLOUT) */
+static ret_e o_uringPollOut(osa_uring_t *r, osa_uringSock_t *ctx)
+{
+	struct io_uring_sqe *sqe = o_uringGetSqe(r);
+
+	if(NULL == sqe)
+		return OSA_ERR_QFULL;
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = ctx->fd;
+	sqe->poll32_events = POLLOUT;
+	sqe->user_data = (u64_t)(uintptr_t)ctx | O_URING_OP_POLLOUT;
+
+	ctx->txBusy = 1;
+	ctx->inflight++;
+	return OSA_SUCCESS;
+}
+
+/* o_uringRecvDirect : Read the socket itself, like ::recvfrom. 'addr' may be NULL, then 'addrLen' is left alone */
+static i32_t o_uringRecvDirect(int fd, void *buf, i32_t bufSize, i32_t flags, void *addr, u32_t *addrLen, u32_t addrSz)
+{
+	socklen_t len = addrSz;
+	ssize_t result = ::recvfrom(fd, buf, bufSize, flags, (struct sockaddr *)addr, (NULL != addr) ? &len : NULL);
+
+	if(NULL != addr && NULL != addrLen)
+		*addrLen = (0 <= result) ? len : 0;
+
+	return (i32_t)result;
+}
+
+/* o_uringFeedStarved : Restart the recv of the sockets which ran out of buffers, now that there are free ones again */
+static void o_uringFeedStarved(osa_uring_t *r)
+{
+	while(0 < r->bufFree && NULL != r->starved)
+	{
+		osa_uringSock_t *ctx = r->starved;
+
+		r->starved = ctx->starvedNext;
+		ctx->starved = 0;
+		if(0 == ctx->armed && 0 == ctx->rxPaused && 0 == ctx->rxEof && 0 == ctx->rxErr)
+			o_uringArm(r, ctx);
+	}
+}
+
+/* o_uringFree : Unmap and close everything uringCreate has set up (so far) */
+static void o_uringFree(osa_uring_t *r)
+{
+	if(NULL != r->bufs)
+		munmap(r->bufs, (size_t)OSA_URING_NUM_BUFS * OSA_URING_BUF_SZ);
+	if(NULL != r->bufRing)
+		munmap(r->bufRing, OSA_URING_NUM_BUFS * sizeof(struct io_uring_buf));
+	if(NULL != r->sqes)
+		munmap(r->sqes, r->sqesSz);
+	if(NULL != r->cqRing && r->cqRing != r->sqRing)
+		munmap(r->cqRing, r->cqRingSz);
+	if(NULL != r->sqRing)
+		munmap(r->sqRing, r->sqRingSz);
+	if(-1 != r->ringFd)
+		::close(r->ringFd);
+
+	free(r);
+}
+
+static void o_uringFreeSock(osa_uring_t *r, osa_uringSock_t *ctx)
+{
+	if(NULL != ctx->prev)
+		ctx->prev->next = ctx->next;
+	else
+		r->socks = ctx->next;
+	if(NULL != ctx->next)
+		ctx->next->prev = ctx->prev;
+
+	free(ctx);
+}
+
+/* o_uringReleaseRx : Give back the buffers and connections the socket is still holding */
+static void o_uringReleaseRx(osa_uring_t *r, osa_uringSock_t *ctx)
+{
+	osa_uringSock_t **pp;
+
+	while(-1 != ctx->rxHead)
+	{
+		i32_t bid = ctx->rxHead;
+		ctx->rxHead = r->bufNext[bid];
+		o_uringPutBuf(r, bid);
+	}
+	ctx->rxTail = -1;
+	ctx->rxOff = 0;
+	ctx->rxCnt = 0;
+
+	for(; 0 < ctx->acceptCnt; ctx->acceptCnt--)
+	{
+		::close(ctx->acceptFds[ctx->acceptHead]);
+		ctx->acceptHead = (ctx->acceptHead + 1) % OSA_URING_ACCEPT_STASH;
+	}
+
+	if(1 == ctx->starved)
+	{
+		for(pp = &r->starved; *pp != ctx; pp = &(*pp)->starvedNext)
+			;
+		*pp = ctx->starvedNext;
+		ctx->starved = 0;
+	}
+}
+
+ret_e osa_eventLoop :: uringCreate()
+{
+	char * func = "osa_eventLoop::uringCreate";
+	struct io_uring_params p;
+	struct io_uring_buf_reg reg;
+	osa_uring_t *r;
+	i32_t i;
+
+	r = (osa_uring_t *)calloc(1, sizeof(osa_uring_t));
+	if(NULL == r)
+	{
+		osa_loge("%s:error: no memory for the rings", func);
+		return OSA_ERR_INSUFFMEM;
+	}
+
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+	p.cq_entries = 4 * OSA_URING_SQ_ENTRIES;		/* Multishot requests post many completions per submission */
+
+	r->ringFd = o_uringSetup(OSA_URING_SQ_ENTRIES, &p);
+	if(0 > r->ringFd)
+	{
+		osa_loge("%s:error: io_uring_setup failed. errno=%s (%d)", func, strerror(errno), errno);
+		r->ringFd = -1;
+		o_uringFree(r);
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	if(0 == (p.features & IORING_FEAT_EXT_ARG) || 0 == (p.features & IORING_FEAT_NODROP))
+	{
+		osa_loge("%s:error: kernel io_uring is too old. features=0x%x", func, p.features);
+		o_uringFree(r);
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	r->sqRingSz = p.sq_off.array + p.sq_entries * sizeof(u32_t);
+	r->cqRingSz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if(p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if(r->cqRingSz > r->sqRingSz)
+			r->sqRingSz = r->cqRingSz;
+		r->cqRingSz = r->sqRingSz;
+	}
+
+	r->sqRing = mmap(NULL, r->sqRingSz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->ringFd, IORING_OFF_SQ_RING);
+	if(MAP_FAILED == r->sqRing)
+	{
+		osa_loge("%s:error: mmap of the submission ring failed. errno=%s (%d)", func, strerror(errno), errno);
+		r->sqRing = NULL;
+		o_uringFree(r);
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	if(p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		r->cqRing = r->sqRing;
+	}
+	else
+	{
+		r->cqRing = mmap(NULL, r->cqRingSz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->ringFd,
+			IORING_OFF_CQ_RING);
+		if(MAP_FAILED == r->cqRing)
+		{
+			osa_loge("%s:error: mmap of the completion ring failed. errno=%s (%d)", func, strerror(errno), errno);
+			r->cqRing = NULL;
+			o_uringFree(r);
+			return OSA_ERR_COREFUNCFAIL;
+		}
+	}
+
+	r->sqesSz = p.sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes = (struct io_uring_sqe *)mmap(NULL, r->sqesSz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->ringFd,
+		IORING_OFF_SQES);
+	if(MAP_FAILED == (void *)r->sqes)
+	{
+		osa_loge("%s:error: mmap of the sqes failed. errno=%s (%d)", func, strerror(errno), errno);
+		r->sqes = NULL;
+		o_uringFree(r);
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	r->sqHead = (u32_t *)((u8_t *)r->sqRing + p.sq_off.head);
+	r->sqTail = (u32_t *)((u8_t *)r->sqRing + p.sq_off.tail);
+	r->sqMask = *(u32_t *)((u8_t *)r->sqRing + p.sq_off.ring_mask);
+	r->sqEntries = p.sq_entries;
+	r->sqLocalTail = *r->sqTail;
+
+	r->cqHead = (u32_t *)((u8_t *)r->cqRing + p.cq_off.head);
+	r->cqTail = (u32_t *)((u8_t *)r->cqRing + p.cq_off.tail);
+	r->cqMask = *(u32_t *)((u8_t *)r->cqRing + p.cq_off.ring_mask);
+	r->cqEntries = p.cq_entries;
+	r->cqes = (struct io_uring_cqe *)((u8_t *)r->cqRing + p.cq_off.cqes);
+
+	/* sqe 'i' always goes into slot 'i', so the index array is filled only once */
+	for(i=0; i<(i32_t)p.sq_entries; i++)
+		((u32_t *)((u8_t *)r->sqRing + p.sq_off.array))[i] = (u32_t)i;
+
+	/* Receive buffers */
+	r->bufRing = (struct io_uring_buf_ring *)mmap(NULL, OSA_URING_NUM_BUFS * sizeof(struct io_uring_buf),
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	r->bufs = (u8_t *)mmap(NULL, (size_t)OSA_URING_NUM_BUFS * OSA_URING_BUF_SZ, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(MAP_FAILED == (void *)r->bufRing || MAP_FAILED == (void *)r->bufs)
+	{
+		osa_loge("%s:error: no memory for %d receive buffers", func, OSA_URING_NUM_BUFS);
+		if(MAP_FAILED == (void *)r->bufRing)
+			r->bufRing = NULL;
+		if(MAP_FAILED == (void *)r->bufs)
+			r->bufs = NULL;
+		o_uringFree(r);
+		return OSA_ERR_INSUFFMEM;
+	}
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (u64_t)(uintptr_t)r->bufRing;
+	reg.ring_entries = OSA_URING_NUM_BUFS;
+	reg.bgid = O_URING_BGID;
+	if(0 != o_uringRegister(r->ringFd, IORING_REGISTER_PBUF_RING, &reg, 1))
+	{
+		osa_loge("%s:error: registering the buffer ring failed (needs linux 5.19). errno=%s (%d)", func, strerror(errno),
+			errno);
+		o_uringFree(r);
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	for(i=0; i<OSA_URING_NUM_BUFS; i++)
+		o_uringPutBuf(r, i);
+
+	if(OSA_SUCCESS != o_uringPollWake(r, wakeFd))
+	{
+		o_uringFree(r);
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	uring = r;
+
+	osa_logi("%s: ringFd=%d, sq=%u, cq=%u, %d receive buffers of %d bytes", func, r->ringFd, p.sq_entries,
+		p.cq_entries, OSA_URING_NUM_BUFS, OSA_URING_BUF_SZ);
+	return OSA_SUCCESS;
+}
+
+void osa_eventLoop :: uringDestroy()
+{
+	osa_uring_t *r = uring;
+
+	if(NULL == r)
+		return;
+
+	/* Detach the sockets still in the loop. Closing the ring cancels whatever the kernel still has */
+	while(NULL != r->socks)
+	{
+		osa_uringSock_t *ctx = r->socks;
+
+		if(NULL != ctx->sock)
+		{
+			ctx->sock->ioCtx = NULL;
+			ctx->sock->evLoop = NULL;
+			ctx->sock->txScheduled.store(0, std::memory_order_relaxed);
+		}
+		o_uringReleaseRx(r, ctx);
+		o_uringFreeSock(r, ctx);
+	}
+
+	o_uringFree(r);
+	uring = NULL;
+}
+
+ret_e osa_eventLoop :: uringAdd(osa_socket &sock)
+{
+	char * func = "osa_eventLoop::uringAdd";
+	osa_uringSock_t *ctx;
+	int type = 0, listening = 0;
+	socklen_t optLen;
+
+	optLen = sizeof(type);
+	if(0 != getsockopt(sock.sockFd, SOL_SOCKET, SO_TYPE, &type, &optLen))
+	{
+		osa_loge("%s:error: sockFd=%d, getsockopt(SO_TYPE) failed. errno=%s (%d)", func, sock.sockFd, strerror(errno),
+			errno);
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	optLen = sizeof(listening);
+	if(0 != getsockopt(sock.sockFd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &optLen))
+		listening = 0;
+
+	ctx = (osa_uringSock_t *)calloc(1, sizeof(osa_uringSock_t));
+	if(NULL == ctx)
+	{
+		osa_loge("%s:error: sockFd=%d, no memory", func, sock.sockFd);
+		return OSA_ERR_INSUFFMEM;
+	}
+
+	ctx->sock = &sock;
+	ctx->fd = sock.sockFd;
+	ctx->rxHead = -1;
+	ctx->rxTail = -1;
+	if(listening)
+		ctx->op = O_URING_OP_ACCEPT;
+	else if(SOCK_STREAM == type)
+		ctx->op = O_URING_OP_RECV;
+	else
+		ctx->op = O_URING_OP_POLL;
+
+	if(OSA_SUCCESS != o_uringArm(uring, ctx))
+	{
+		free(ctx);
+		return OSA_ERR_COREFUNCFAIL;
+	}
+
+	ctx->next = uring->socks;
+	if(NULL != ctx->next)
+		ctx->next->prev = ctx;
+	uring->socks = ctx;
+
+	sock.ioCtx = ctx;
+
+	osa_logd("%s: sockFd=%d, op=%d", func, sock.sockFd, ctx->op);
+	return OSA_SUCCESS;
+}
+
+void osa_eventLoop :: uringRemove(osa_socket &sock)
+{
+	osa_uringSock_t *ctx = sock.ioCtx;
+	struct io_uring_sqe *sqe;
+
+	if(NULL == ctx)
+		return;
+
+	sock.ioCtx = NULL;
+	ctx->sock = NULL;
+	o_uringReleaseRx(uring, ctx);
+
+	if(0 == ctx->inflight)
+	{
+		o_uringFreeSock(uring, ctx);
+		return;
+	}
+
+	/* Cancel by fd and submit right away: the caller is about to close the fd and the number can be reused.
+	   ctx is freed when the last cancelled request completes */
+	sqe = o_uringGetSqe(uring);
+	if(NULL != sqe)
+	{
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = ctx->fd;
+		sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+		sqe->user_data = O_URING_OP_CANCEL;
+	}
+	else
+	{
+		osa_loge("osa_eventLoop::uringRemove:error: submission ring is full. Requests of fd=%d are not cancelled", ctx->fd);
+	}
+
+	o_uringSubmit(uring, 0, 0);
+}
+
+/* uringFlush : Submit the next packet of the send queue. Only one send per socket is in flight, so that the bytes of a
+				stream go out in order. The completion submits the next one. */
+void osa_eventLoop :: uringFlush(osa_socket &sock)
+{
+	char * func = "osa_eventLoop::uringFlush";
+	osa_uringSock_t *ctx = sock.ioCtx;
+	struct io_uring_sqe *sqe;
+	struct sockaddr *rAddr = NULL;
+	socklen_t addrLen = 0;
+	pktData_t *pkt;
+
+	if(NULL == ctx || 1 == ctx->txBusy)
+		return;
+
+	/* io_uring can't send a file without a pipe in between. sendFile packets go out with sendfile() right here and when
+	   the socket is full, a poll tells when it takes data again */
+	while(NULL != (pkt = sock.txHead()) && pkt->isFile)
+	{
+		ssize_t result = osa_pktSendFile(sock.sockFd, pkt, sock.txOff);
+
+		if(-1 == result)
+		{
+			if(EINTR == errno)
+				continue;
+			if(EAGAIN == errno || EWOULDBLOCK == errno)
+			{
+				if(OSA_SUCCESS != o_uringPollOut(uring, ctx))
+				{
+					osa_loge("%s:error: sockFd=%d, submission ring is full. Dropping the send queue", func, sock.sockFd);
+					sock.dropSendQ(1);
+				}
+				return;
+			}
+
+			osa_loge("%s:error: sockFd=%d, sendfile failed. errno=%s (%d). Dropping the send queue", func, sock.sockFd, 
+				strerror(errno), errno);
+			sock.dropSendQ(1);
+			return;
+		}
+
+		/* sendCompleteCb may remove the socket. The extra count keeps ctx alive till we know */
+		ctx->inflight++;
+		sock.txAdvance((i32_t)result);
+		ctx->inflight--;
+		if(NULL == ctx->sock)
+		{
+			if(0 == ctx->inflight)
+				o_uringFreeSock(uring, ctx);
+			return;
+		}
+	}
+
+	if(NULL == pkt)
+		return;
+
+	if(pkt->isSendTo)
+		rAddr = osa_pktSockAddr(pkt, addrLen);
+
+	sqe = o_uringGetSqe(uring);
+	if(NULL == sqe)
+	{
+		osa_loge("%s:error: sockFd=%d, submission ring is full. Dropping the send queue", func, sock.sockFd);
+		sock.dropSendQ(1);
+		return;
+	}
+
+	sqe->fd = sock.sockFd;
+	sqe->msg_flags = pkt->flags | MSG_NOSIGNAL;
+	sqe->user_data = (u64_t)(uintptr_t)ctx | O_URING_OP_SEND;
+
+	if(NULL == rAddr && 1 == pkt->iovCnt)
+	{
+		sqe->opcode = IORING_OP_SEND;
+		sqe->addr = (u64_t)(uintptr_t)((u8_t *)pkt->iov[0].buf + sock.txOff);
+		sqe->len = pkt->len - sock.txOff;
+	}
+	else
+	{
+		memset(&ctx->txMsg, 0, sizeof(ctx->txMsg));
+		ctx->txMsg.msg_name = rAddr;
+		ctx->txMsg.msg_namelen = addrLen;
+		ctx->txMsg.msg_iov = ctx->txIov;
+		ctx->txMsg.msg_iovlen = osa_pktIov(pkt, sock.txOff, ctx->txIov);
+
+		sqe->opcode = IORING_OP_SENDMSG;
+		sqe->addr = (u64_t)(uintptr_t)&ctx->txMsg;
+		sqe->len = 1;
+	}
+
+	ctx->txBusy = 1;
+	ctx->inflight++;
+}
+
+/* uringHandleCqe : Process one completion. Calls the socket callbacks, which may remove (and destroy) the socket: after
+					a callback only ctx (never the socket) is looked at, till ctx->sock says the socket is still there */
+void osa_eventLoop :: uringHandleCqe(u64_t userData, i32_t res, u32_t flags)
+{
+	char * func = "osa_eventLoop::uringHandleCqe";
+	osa_uringSock_t *ctx = (osa_uringSock_t *)(uintptr_t)(userData & ~(u64_t)O_URING_OP_MASK);
+	int op = (int)(userData & O_URING_OP_MASK);
+	int ended = (0 == (flags & IORING_CQE_F_MORE));
+	int rearm = 0;
+	osa_socket *sock;
+
+	if(O_URING_OP_WAKE == op)
+	{
+		u64_t cnt;
+		while(sizeof(cnt) == ::read(wakeFd, &cnt, sizeof(cnt)))
+			;
+		if(ended)
+			o_uringPollWake(uring, wakeFd);
+		return;
+	}
+
+	if(O_URING_OP_CANCEL == op || NULL == ctx)
+		return;
+
+	sock = ctx->sock;
+	curSock = sock;
+
+	switch(op)
+	{
+		case O_URING_OP_ACCEPT:
+			if(0 <= res)
+			{
+				if(NULL != sock && OSA_URING_ACCEPT_STASH > ctx->acceptCnt)
+				{
+					ctx->acceptFds[(ctx->acceptHead + ctx->acceptCnt) % OSA_URING_ACCEPT_STASH] = res;
+					ctx->acceptCnt++;
+				}
+				else
+				{
+					if(NULL != sock)
+						osa_loge("%s:error: listener fd=%d has %d connections not accepted. Closing the new one", func,
+							ctx->fd, ctx->acceptCnt);
+					::close(res);
+				}
+				rearm = 1;
+			}
+			else if(-ECANCELED != res)
+			{
+				/* Not re-armed here (e.g. EMFILE would fail again right away). accept() reports it and re-arms */
+				osa_loge("%s:error: accept on fd=%d failed. errno=%s (%d)", func, ctx->fd, strerror(-res), -res);
+				ctx->acceptErr = -res;
+			}
+
+			if(NULL != sock && -ECANCELED != res)
+				sock->onReadable();
+			break;
+
+		case O_URING_OP_RECV:
+			if(0 < res && (flags & IORING_CQE_F_BUFFER))
+			{
+				i32_t bid = (i32_t)(flags >> IORING_CQE_BUFFER_SHIFT);
+
+				uring->bufFree--;
+				if(NULL == sock)
+				{
+					o_uringPutBuf(uring, bid);
+				}
+				else
+				{
+					uring->bufLen[bid] = res;
+					uring->bufNext[bid] = -1;
+					if(-1 == ctx->rxTail)
+						ctx->rxHead = bid;
+					else
+						uring->bufNext[ctx->rxTail] = bid;
+					ctx->rxTail = bid;
+					ctx->rxCnt++;
+
+					/* Socket isn't read fast enough. Stop taking buffers the other sockets need, the kernel keeps
+					   the rest of the data in the socket (and tcp slows the sender down) */
+					if(OSA_URING_SOCK_MAX_BUFS <= ctx->rxCnt && 0 == ctx->rxPaused)
+					{
+						struct io_uring_sqe *sqe = o_uringGetSqe(uring);
+						if(NULL != sqe)
+						{
+							sqe->opcode = IORING_OP_ASYNC_CANCEL;
+							sqe->addr = (u64_t)(uintptr_t)ctx | O_URING_OP_RECV;
+							sqe->user_data = O_URING_OP_CANCEL;
+							ctx->rxPaused = 1;
+						}
+					}
+				}
+				rearm = (0 == ctx->rxPaused);
+			}
+			else if(0 == res)
+			{
+				ctx->rxEof = 1;
+			}
+			else if(-ENOBUFS == res)
+			{
+				/* Re-armed when some socket gives buffers back. Till then recv() reads the socket directly */
+				if(NULL != sock && 0 == ctx->starved)
+				{
+					ctx->starved = 1;
+					ctx->starvedNext = uring->starved;
+					uring->starved = ctx;
+				}
+				if(NULL != sock && 0 == ctx->polling && 0 == ctx->rxCnt)
+					o_uringPollOnce(uring, ctx);
+			}
+			else if(-ECANCELED == res)
+			{
+				/* recv() has already resumed a paused socket while the cancel was on its way */
+				rearm = (0 == ctx->rxPaused);
+			}
+			else
+			{
+				ctx->rxErr = -res;
+			}
+
+			if(NULL != sock && -ENOBUFS != res && -ECANCELED != res)
+				sock->onReadable();
+			break;
+
+		case O_URING_OP_POLL:
+			if(O_URING_OP_RECV == ctx->op)
+			{
+				ctx->polling = 0;
+				if(NULL != sock && 0 <= res)
+					sock->onReadable();
+				if(NULL != ctx->sock && 0 == ctx->armed && 1 == ctx->starved && 0 == ctx->rxCnt && -ECANCELED != res)
+					o_uringPollOnce(uring, ctx);
+				break;
+			}
+
+			if(0 <= res)
+			{
+				rearm = 1;
+				if(NULL != sock)
+					sock->onReadable();
+			}
+			else if(-ECANCELED != res)
+			{
+				osa_loge("%s:error: poll on fd=%d failed. errno=%s (%d)", func, ctx->fd, strerror(-res), -res);
+			}
+			break;
+
+		case O_URING_OP_SEND:
+			ctx->txBusy = 0;
+			if(NULL == sock)
+				break;
+
+			if(0 <= res)
+			{
+				sock->txAdvance(res);
+			}
+			else if(-EAGAIN == res)
+			{
+				/* Socket buffer is full. Sending again right away would only spin till it drains */
+				if(OSA_SUCCESS != o_uringPollOut(uring, ctx))
+				{
+					osa_loge("%s:error: sockFd=%d, submission ring is full. Dropping the send queue", func, ctx->fd);
+					sock->dropSendQ(1);
+				}
+				break;
+			}
+			else if(-EINTR != res)
+			{
+				osa_loge("%s:error: sockFd=%d, async send failed. errno=%s (%d). Dropping the send queue", func, ctx->fd,
+					strerror(-res), -res);
+				sock->dropSendQ(1);
+			}
+
+			if(NULL != ctx->sock)
+				uringFlush(*ctx->sock);
+			break;
+
+		case O_URING_OP_POLLOUT:
+			ctx->txBusy = 0;
+			if(NULL != sock)
+				uringFlush(*sock);
+			break;
+	}
+
+	if(op == ctx->op && ended)
+	{
+		ctx->armed = 0;
+		if(rearm && NULL != ctx->sock)
+			o_uringArm(uring, ctx);
+	}
+
+	curSock = NULL;
+	if(O_URING_OP_SEND == op || ended)
+		ctx->inflight--;
+
+	if(NULL == ctx->sock && 0 == ctx->inflight)
+		o_uringFreeSock(uring, ctx);
+}
+
+ret_e osa_eventLoop :: uringRunOnce(i32_t timeoutMs)
+{
+	char * func = "osa_eventLoop::uringRunOnce";
+	osa_uring_t *r = uring;
+	u32_t head, n;
+
+	if(0 > o_uringSubmit(r, 1, timeoutMs))
+	{
+		/* ETIME: timed out, EBUSY: completions must be reaped first */
+		if(ETIME != errno && EINTR != errno && EAGAIN != errno && EBUSY != errno)
+		{
+			osa_loge("%s:error: io_uring_enter failed. errno=%s (%d)", func, strerror(errno), errno);
+			return OSA_ERR_COREFUNCFAIL;
+		}
+	}
+
+	/* At most one ring worth, so that pending flushes are not held back by a flood of completions */
+	head = *r->cqHead;
+	for(n=0; n<r->cqEntries && head != __atomic_load_n(r->cqTail, __ATOMIC_ACQUIRE); n++)
+	{
+		struct io_uring_cqe *cqe = &r->cqes[head & r->cqMask];
+		u64_t userData = cqe->user_data;
+		i32_t res = cqe->res;
+		u32_t flags = cqe->flags;
+
+		head++;
+		__atomic_store_n(r->cqHead, head, __ATOMIC_RELEASE);
+
+		uringHandleCqe(userData, res, flags);
+	}
+
+	o_uringFeedStarved(r);
+	return OSA_SUCCESS;
+}
+
+/* uringAccept : accept() of a socket in an io_uring loop. Works like ::accept on a non-blocking socket */
+int osa_eventLoop :: uringAccept(osa_socket &sock)
+{
+	osa_uringSock_t *ctx = sock.ioCtx;
+	int fd;
+
+	if(O_URING_OP_ACCEPT != ctx->op)
+		return ::accept(sock.sockFd, NULL, NULL);
+
+	if(0 < ctx->acceptCnt)
+	{
+		fd = ctx->acceptFds[ctx->acceptHead];
+		ctx->acceptHead = (ctx->acceptHead + 1) % OSA_URING_ACCEPT_STASH;
+		ctx->acceptCnt--;
+		return fd;
+	}
+
+	if(0 != ctx->acceptErr)
+	{
+		errno = ctx->acceptErr;
+		ctx->acceptErr = 0;
+		if(0 == ctx->armed)
+			o_uringArm(uring, ctx);
+		return -1;
+	}
+
+	errno = EAGAIN;
+	return -1;
+}
+
+/* uringRecv : recv()/recvfrom() of a socket in an io_uring loop. Works like ::recvfrom on a non-blocking socket: copies
+			   what the multishot recv has collected, then reports end of stream (0) or the error. Data of a stream socket
+			   has no source address: '*addrLen' is set to 0 then, like the kernel does for a connected stream */
+i32_t osa_eventLoop :: uringRecv(osa_socket &sock, void *buf, i32_t bufSize, i32_t flags, void *addr, u32_t *addrLen)
+{
+	osa_uringSock_t *ctx = sock.ioCtx;
+	osa_uring_t *r = uring;
+	u32_t addrSz = (NULL != addrLen) ? *addrLen : 0;
+	i32_t copied = 0;
+
+	if(O_URING_OP_RECV != ctx->op)
+		return o_uringRecvDirect(sock.sockFd, buf, bufSize, flags, addr, addrLen, addrSz);
+
+	if(NULL != addrLen)
+		*addrLen = 0;
+
+	while(copied < bufSize && -1 != ctx->rxHead)
+	{
+		i32_t bid = ctx->rxHead;
+		i32_t n = r->bufLen[bid] - ctx->rxOff;
+
+		if(n > bufSize - copied)
+			n = bufSize - copied;
+
+		memcpy((u8_t *)buf + copied, r->bufs + (size_t)bid * OSA_URING_BUF_SZ + ctx->rxOff, n);
+		copied += n;
+		ctx->rxOff += n;
+
+		if(ctx->rxOff == r->bufLen[bid])
+		{
+			ctx->rxHead = r->bufNext[bid];
+			if(-1 == ctx->rxHead)
+				ctx->rxTail = -1;
+			ctx->rxOff = 0;
+			ctx->rxCnt--;
+			o_uringPutBuf(r, bid);
+		}
+	}
+
+	if(1 == ctx->rxPaused && OSA_URING_SOCK_MAX_BUFS / 2 > ctx->rxCnt)
+	{
+		ctx->rxPaused = 0;
+		if(0 == ctx->armed && 0 == ctx->rxEof && 0 == ctx->rxErr)
+			o_uringArm(r, ctx);
+	}
+
+	o_uringFeedStarved(r);
+
+	if(0 < copied)
+		return copied;
+
+	if(0 != ctx->rxErr)
+	{
+		errno = ctx->rxErr;
+		return -1;
+	}
+
+	if(1 == ctx->rxEof)
+		return 0;
+
+	/* No recv request in the kernel (out of buffers or paused) and all it has received is copied out: what is left is
+	   still in the socket, read it directly. Bytes stay in order */
+	if(0 == ctx->armed)
+		return o_uringRecvDirect(sock.sockFd, buf, bufSize, flags, addr, addrLen, addrSz);
+
+	errno = EAGAIN;
+	return -1;
+}
+
+/* uringOwnsRx : 1 if the loop receives the data of the socket itself (stream sockets). Their data must be read with
+				 uringRecv, anything reading the socket directly would take bytes out of order */
+int osa_eventLoop :: uringOwnsRx(osa_socket &sock)
+{
+	return (NULL != sock.ioCtx && O_URING_OP_RECV == sock.ioCtx->op) ? 1 : 0;
+}
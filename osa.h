@@ -5,9 +5,12 @@
 #include <stdio.h>
 #include <cstdint>  /* for cpp;  In case you are using c, the parallel header is stdint.h */
 #include <stdlib.h>
+#include <string.h>
+#include <type_traits>
 
 /* TO DO: Include in platform independent manner */ 
 #include <thread>
+#include <atomic>
 #include "osa_threads.h"
 //#endif
 
@@ -21,12 +24,47 @@
 #define LOGLVL_DEBUG 	2
 #define LOGLVL_VERBOSE 	3
 
+/* LOG_LEVEL : Compile time ceiling. Log calls above this level are compiled out entirely (arguments are never
+			  evaluated). Override from the build, e.g. -DLOG_LEVEL=LOGLVL_INFO for release builds */
+#ifndef LOG_LEVEL
 #define LOG_LEVEL		LOGLVL_VERBOSE
+#endif
 
-#define osa_logv printf;
-#define osa_logd printf;
-#define osa_loge printf;
-#define osa_logi printf;
+/* osa_logLevel : Runtime level. Calls that survive LOG_LEVEL are emitted only when their level is <= this value.
+				  Checked before the arguments are evaluated, so a disabled osa_logd() costs one load and a branch */
+extern std::atomic<int> osa_logLevel;
+
+/* osa_logSetLevel : Sets the runtime level, clamped to LOGLVL_ERROR..LOGLVL_VERBOSE. The default is LOGLVL_ERROR, so only
+				  osa_loge() is printed until this is called */
+void osa_logSetLevel(int level);
+int  osa_logGetLevel();
+
+/* osa_logPrint : printf style entry for formats that are not string literals. Formats on the calling thread.
+				  The osa_logX macros are cheaper: they only copy the raw arguments (check L O G G I N G below) */
+void osa_logPrint(int level, const char * fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/* osa_logRegister : Give the format of a call site an id. Done once per call site by the osa_logX macros */
+uint32_t osa_logRegister(const char * fmt);
+
+#define OSA_LOG_FMT_(fmt, ...)	fmt
+#define OSA_LOG_FMT(...)		OSA_LOG_FMT_(__VA_ARGS__, 0)
+
+/* The sizeof() is never evaluated. It only lets the compiler check the arguments against the format */
+#define osa_log(level, ...)																		\
+	do																								\
+	{																								\
+		if((level) <= LOG_LEVEL && (level) <= osa_logLevel.load(std::memory_order_relaxed))		\
+		{																							\
+			static const u32_t osa_logFmtId = osa_logRegister(OSA_LOG_FMT(__VA_ARGS__));			\
+			(void)sizeof((osa_logPrint((level), __VA_ARGS__), 0));									\
+			osa_logWrite((level), osa_logFmtId, __VA_ARGS__);										\
+		}																							\
+	}while(0)
+
+#define osa_logv(...)	osa_log(LOGLVL_VERBOSE, __VA_ARGS__)
+#define osa_logd(...)	osa_log(LOGLVL_DEBUG, __VA_ARGS__)
+#define osa_loge(...)	osa_log(LOGLVL_ERROR, __VA_ARGS__)
+#define osa_logi(...)	osa_log(LOGLVL_INFO, __VA_ARGS__)
 
 /****************************************************
 * 		D A T A    T Y P E   W R A P E R S 
@@ -53,6 +91,9 @@ typedef enum
 	OSA_ERR_INSUFFMEM,
 	OSA_ERR_COREFUNCFAIL,	/* OSA functions will usually call some OS provided core function. This error value tells that that 
 							   function returned an error. You need to check platform specific error details */
+	OSA_ERR_QFULL,			/* Queue has no free slot for the element being pushed */
+	OSA_ERR_QEMPTY,			/* Queue has no element to be popped/peeked */
+	OSA_ERR_TIMEDOUT,		/* Blocking call gave up after the given timeout */
 }ret_e;
 
 #define osa_assert assert /* TO DO: FIXME. Needs to be define per platform/OS */
@@ -112,6 +153,228 @@ void * osa_realloc(void * buf, u32_t sz);						/* Allocates a new buffer of size
 																	less than old, only new sz bytes of data will be copied. */
 void osa_free(void * buf);										/* Free the buffer */
 
+/* Allocation statistics : Build osa with -DOSA_MEM_STATS and osa_malloc/osa_calloc/osa_realloc/osa_free keep count of
+	the allocations: per size class, bytes in use and its peak, and the allocations still outstanding per call site (the
+	code that called osa_malloc). The counters are per thread, so the threads don't contend on them. Every block gets a
+	16 byte header holding its size and call site. osa_free reports a pointer whose header is not valid (most double
+	frees, pointers that osa_malloc never gave out) instead of passing it to free().
+	Without OSA_MEM_STATS osa_malloc is plain malloc and the functions below report nothing */
+
+#define OSA_MEM_CLASSES		24			/* Size class c counts the sizes up to (16 << c) bytes. The last one all bigger */
+#define OSA_MEM_SITES		1024		/* Call sites tracked. Allocations from more sites are counted in site 0 */
+#define OSA_MEM_PEAK_STEP	65536		/* A thread adds its bytes to the process wide in-use count in steps of this */
+
+typedef struct osa_memStats_t
+{
+	u64_t allocs; 						/* osa_malloc and osa_calloc calls (osa_realloc of NULL too) */
+	u64_t frees;
+	u64_t reallocs;
+	u64_t bytesAlloc; 					/* Bytes asked for since the start */
+	u64_t bytesInUse;					/* Bytes not freed yet */
+	u64_t peakInUse; 					/* Highest bytesInUse seen. May be short by OSA_MEM_PEAK_STEP per thread */
+	u64_t classAllocs[OSA_MEM_CLASSES];	/* Per size class. osa_realloc counts as an allocation of the new size */
+	u64_t classBytes[OSA_MEM_CLASSES];
+}osa_memStats_t;
+
+/* osa_memGetStats : Totals of all the threads. OSA_ERR_BADPARAM if osa is built without OSA_MEM_STATS */
+ret_e osa_memGetStats(osa_memStats_t &stats);
+
+/* osa_memReport : Print the totals, the size classes and the 'maxSites' call sites with the most bytes outstanding.
+	The sites are printed as <binary>+<offset>. 'addr2line -f -e <binary> <offset>' gives the source line.
+	Call it before exit to see what leaked. 'out' NULL means stdout */
+void osa_memReport(FILE * out = NULL, u32_t maxSites = 20);
+
+/* Large buffers : osa_mallocLarge maps memory straight from the kernel, for big long lived buffers (socket rings, queue
+	storage, file caches). It can ask for huge pages, where one TLB entry covers 2MB instead of 4KB, and place the memory
+	on one NUMA node (the node of the cpus that use it). The memory is zeroed and the size is rounded up to a multiple of
+	the page size (OSA_MEM_HUGE_PAGE_SZ with huge pages). Free it with osa_freeLarge. Not counted by OSA_MEM_STATS */
+
+#define OSA_MEM_HUGE_PAGE_SZ	(2 * 1024 * 1024)
+#define OSA_MEM_NODE_ANY		-1			/* No NUMA placement. Pages come from the node of the thread that first touches them */
+
+typedef enum osa_memLarge_e
+{
+	OSA_MEM_THP 		= 0x1,			/* Transparent huge pages. The kernel backs the buffer with huge pages when it can */
+	OSA_MEM_HUGETLB 	= 0x2,			/* Pages from the reserved huge page pool (vm.nr_hugepages). Falls back to
+										   OSA_MEM_THP when the pool has too few free pages */
+	OSA_MEM_NODE_STRICT = 0x4, 			/* Fail rather than take pages from another node than 'numaNode' */
+	OSA_MEM_POPULATE 	= 0x8 			/* Fault in all the pages now instead of on first use */
+}osa_memLarge_e;
+
+/* osa_mallocLarge :
+	IN sz 		: Bytes needed
+	IN flags 	: osa_memLarge_e values or'ed together
+	IN numaNode : Node to take the pages from (osa_memNumaNode() for the calling thread's node) or OSA_MEM_NODE_ANY.
+				  Without OSA_MEM_NODE_STRICT it is only a preference
+	Returns NULL on failure */
+void * osa_mallocLarge(u64_t sz, u32_t flags = OSA_MEM_THP, int numaNode = OSA_MEM_NODE_ANY);
+
+/* osa_freeLarge : Unmap a buffer from osa_mallocLarge. NULL is ignored */
+void osa_freeLarge(void * buf);
+
+/* osa_memNumaNode : NUMA node of the cpu the calling thread runs on. 0 if it can't be had */
+int osa_memNumaNode();
+
+/* osa_arena : Region (bump pointer) allocator. alloc() only moves a pointer forward inside a chunk of memory. Allocations
+			   are never freed one by one: reset() frees all of them at once. Meant for request scoped memory: allocate
+			   everything a request needs from its arena and reset() the arena when the request is done.
+			   Not thread safe. An arena must be used by one thread at a time */
+
+#define OSA_ARENA_CHUNK_SZ	65536	/* Default chunk size of osa_arena */
+#define OSA_ARENA_ALIGN		16		/* Default alignment of osa_arena::alloc(). Same as malloc */
+
+typedef enum osa_arena_mode_e
+{
+	OSA_ARENA_GROW,		/* A new chunk is added when the current one is full (default) */
+	OSA_ARENA_FIXED,	/* Only the chunk allocated by create(). alloc() returns NULL once it is full */
+}osa_arena_mode_e;
+
+typedef struct osa_arenaChunk_t osa_arenaChunk_t;
+
+class osa_arena
+{
+public:
+	osa_arena();
+	~osa_arena();
+
+	/* create : Allocate the first chunk.
+		IN chunkSz : Size of a chunk. Allocations bigger than this get a chunk of their own (OSA_ARENA_GROW only)
+		IN mode    : OSA_ARENA_GROW or OSA_ARENA_FIXED. Check #osa_arena_mode_e
+	*/
+	ret_e create(u32_t chunkSz = OSA_ARENA_CHUNK_SZ, osa_arena_mode_e mode = OSA_ARENA_GROW);
+
+	/* destroy : Give all the chunks back. Every pointer handed out by the arena becomes invalid */
+	ret_e destroy();
+
+	/* alloc : 'sz' bytes aligned to 'align' (a power of 2). Returns NULL if the memory could not be had */
+	void * alloc(u32_t sz, u32_t align = OSA_ARENA_ALIGN);
+
+	/* calloc : Same as alloc() but the memory is zeroed */
+	void * calloc(u32_t sz, u32_t align = OSA_ARENA_ALIGN);
+
+	/* reset : Free every allocation at once. Chunks are kept for reuse, except the ones made for big allocations */
+	void reset();
+
+	/* release : Same as reset() but also gives back all the chunks except one */
+	void release();
+
+	/* used : Bytes handed out since create()/reset(), alignment padding included */
+	u64_t used();
+
+	/* reserved : Bytes of chunks held by the arena */
+	u64_t reserved();
+
+private:
+	osa_arena(const osa_arena &);		/* Not copyable. The chunks are owned by exactly one arena */
+	osa_arena & operator=(const osa_arena &);
+
+	u8_t * 				cur;			/* Next free byte of the current chunk */
+	u8_t * 				end;			/* End of the current chunk */
+	osa_arenaChunk_t *	chunks;			/* Chunks in use. The current one first */
+	osa_arenaChunk_t *	spare;			/* Chunks kept by reset() */
+	u32_t 				chunkSz;
+	osa_arena_mode_e 	mode;
+	int 				isAlive;
+	u64_t 				usedDone;		/* used() of the chunks other than the current one */
+	u64_t 				reservedSz;
+
+	void * allocSlow(u32_t sz, u32_t align);
+};
+
+/* Fast path is inline: an allocation that fits in the current chunk is a few instructions */
+inline void * osa_arena :: alloc(u32_t sz, u32_t align)
+{
+	uintptr_t p = ((uintptr_t)cur + align - 1) & ~(uintptr_t)(align - 1);
+
+	if(0 != align && 0 == (align & (align - 1)) && p < (uintptr_t)end && p + sz <= (uintptr_t)end)
+	{
+		cur = (u8_t *)(p + sz);
+		return (void *)p;
+	}
+
+	return allocSlow(sz, align);
+}
+
+/* osa_pool : Allocator for objects of one size (connection contexts, request descriptors, ...). Thread safe.
+			  Every thread keeps its own cache of free objects: two magazines of OSA_POOL_MAG_SZ object pointers each.
+			  alloc() and free() work on the cache of the calling thread without any lock or atomic operation. Only when
+			  the cache runs empty (or full) a whole magazine is exchanged with the depot of the pool, under a short lock.
+			  New objects are carved from slabs allocated by the thread that needs them, and a freed object goes back to
+			  the cache of the thread that frees it. So objects mostly stay in the caches (and NUMA node) of the cpu that
+			  uses them.
+			  IMP: destroy() only when no thread uses the pool anymore. All the objects become invalid */
+
+#define OSA_POOL_MAG_SZ		64			/* Object pointers in a magazine */
+#define OSA_POOL_SLAB_SZ	65536		/* Memory asked from osa_malloc at a time (at least one magazine worth of objects) */
+#define OSA_POOL_MAX		64			/* Max pools alive at the same time in the process */
+#define OSA_POOL_ALIGN		16			/* Default alignment of the objects. Same as malloc */
+
+typedef struct osa_poolMag_t osa_poolMag_t;
+typedef struct osa_poolCache_t osa_poolCache_t;
+
+class osa_pool
+{
+public:
+	osa_pool();
+	~osa_pool();
+
+	/* create :
+		IN objSz   : Size of an object. Rounded up to a multiple of 'align' (and to at least a pointer)
+		IN maxObjs : Max objects the pool will carve. 0 means no limit. Once reached alloc() returns NULL until
+					 some object is freed. Objects sitting in the caches of other threads are not counted as free
+		IN align   : Alignment of the objects (a power of 2). Use OSA_CACHELINE_SZ for objects written by different
+					 threads at the same time
+	*/
+	ret_e create(u32_t objSz, u32_t maxObjs = 0, u32_t align = OSA_POOL_ALIGN);
+
+	/* destroy : Give all the slabs back to the system */
+	ret_e destroy();
+
+	/* alloc : One object. Returns NULL if the pool is at maxObjs or the memory could not be had. Not zeroed */
+	void * alloc();
+
+	/* free : Return an object got from alloc() of this pool. NULL is ignored */
+	void free(void * obj);
+
+	/* objSize : Size of an object after rounding */
+	u32_t objSize();
+
+	/* reserved : Bytes of slabs held by the pool */
+	u64_t reserved();
+
+private:
+	osa_pool(const osa_pool &);			/* Not copyable. The thread caches refer to the pool by its slot */
+	osa_pool & operator=(const osa_pool &);
+
+	u32_t 				objSz;
+	u32_t 				align;
+	u32_t 				maxObjs;
+	int 				isAlive;
+	u32_t 				id;				/* Slot of the pool in the cache table of every thread */
+	u32_t 				gen;			/* Tells the caches of this pool from the ones of an older pool in the same slot */
+
+	/* Depot. Everything below is protected by depotLock */
+	std::atomic<u32_t>	depotLock;
+	osa_poolMag_t *		fullMags;		/* Magazines holding objects, given back by the threads */
+	osa_poolMag_t *		emptyMags;
+	void *				loose;			/* Objects freed while the thread had no cache. Linked through their first word */
+	void *				slabs;			/* All the slabs. Linked through their first word */
+	u8_t *				slabCur;		/* Part of the current slab not carved yet */
+	u8_t *				slabEnd;
+	u64_t 				numObjs;		/* Objects carved so far */
+	u64_t 				reservedSz;
+
+	osa_poolCache_t * cacheGet();
+	void cacheFlush(osa_poolCache_t * c);
+	void * carve();
+	void * allocDirect();
+	void freeDirect(void * obj);
+	void * allocSlow(osa_poolCache_t * c);
+	void freeSlow(osa_poolCache_t * c, void * obj);
+
+	friend struct o_poolTls_t;
+};
+
 
 
 /********************************************************
@@ -120,10 +383,22 @@ void osa_free(void * buf);										/* Free the buffer */
 
 /* Queues are important data structures for asynchronous io. When different threads that are waiting on different devices
    want to communicate, queue is the best data structure. The sender thread can push the data to the queue and receiver
-   thread will read the data from the queue. The Queue API will internally implement mutex based access control so that
-   there is no race condition.
+   thread will read the data from the queue. 
+
+   osa_q is a bounded ring buffer that can be shared by any number of producer and consumer threads. It does not use a
+   mutex. Every slot of the ring carries a sequence number which tells whether the slot is free (for the producer whose 
+   turn it is) or holds data (for the consumer whose turn it is). Producers and consumers claim their turn with a single 
+   compare-and-swap on the tail/head index, so threads never sleep on each other and one slow thread doesn't stall 
+   the others.
+   The queue only stores the q_data_t (pointer + size) by value. Memory pointed to by 'obj' is owned by the caller.
+
+   If exactly one thread pushes and exactly one thread pops (e.g. socket thread -> worker thread), create the queue as
+   OSA_Q_SPSC. Then head and tail each have a single writer, so push/pop are plain loads and stores without any 
+   compare-and-swap or per-slot sequence numbers. This gives the lowest latency per message.
 */
 
+#define OSA_CACHELINE_SZ	64
+#define OSA_Q_SPIN_COUNT	2000		/* Blocking pop retries this many times before going to sleep (multi cpu only) */
 
 typedef struct q_data_t
 {
@@ -131,26 +406,122 @@ typedef struct q_data_t
 	uint32_t size;
 }q_data_t;
 
+/* osa_qCell_t : One slot of the ring (internal). 
+	seq  : == position			-> slot is free, the producer pushing at 'position' may fill it.
+		   == position + 1		-> slot has data, the consumer popping at 'position' may take it.
+*/
+typedef struct osa_qCell_t
+{
+	std::atomic<u64_t> 	seq;
+	q_data_t 			data;
+}osa_qCell_t;
+
+/* osa_q_type_e : Who is allowed to use the queue concurrently */
+typedef enum osa_q_type_e
+{
+	OSA_Q_MPMC,			/* Any number of producer and consumer threads (default) */
+	OSA_Q_SPSC,			/* One producer thread and one consumer thread only. Using it from more threads corrupts the queue */
+}osa_q_type_e;
+
+/* osa_q_wait_e : Behaviour of pop() when the queue is empty */
+typedef enum osa_q_wait_e
+{
+	OSA_Q_NOWAIT,		/* Return OSA_ERR_QEMPTY immediately */
+	OSA_Q_WAIT,			/* Block until an element is pushed */
+}osa_q_wait_e;
+
 class osa_q
 {
 public:
 
+	/* osa_q() : Constructs an empty queue. create() must be called before it can be used */
 	osa_q();
-	osa_q(uint32_t maxSize);
 
+	/* osa_q(maxSize, type) : Constructs and creates the queue in one go. Same as osa_q() followed by create(maxSize, type) */
+	osa_q(uint32_t maxSize, osa_q_type_e type = OSA_Q_MPMC);
+
+	~osa_q();
+
+	/* create : Allocate the ring. 
+		IN maxSize : Maximum number of elements the queue can hold. It is rounded up to the next power of 2.
+		IN type    : OSA_Q_MPMC or OSA_Q_SPSC. Check #osa_q_type_e
+	*/
+	ret_e create(uint32_t maxSize, osa_q_type_e type = OSA_Q_MPMC);
+
+	/* destroy : Free the ring. Elements still in the queue are dropped (memory they point to is not touched) */
+	ret_e destroy();
+
+	/* flush : Remove all the elements from the queue */
 	ret_e flush();
 
-	/* Push the element to the tail of the queue */
+	/* Push the element to the tail of the queue. Returns OSA_ERR_QFULL if there is no free slot */
 	ret_e push(q_data_t &obj);
 
-	/* Get the element at the head. Element is removed from the queue */
+	/* Get the element at the head. Element is removed from the queue. Returns OSA_ERR_QEMPTY if there is nothing to pop */
 	ret_e pop(q_data_t &obj);
 
-	/* Get the top element but don't remove it from the queue */
+	/* pop : Same as above. With OSA_Q_WAIT, the caller is blocked till an element is available.
+			 The waiting thread first spins for a short while (so data arriving soon is picked up in microseconds) and then
+			 sleeps in the kernel without using any cpu. Every push wakes up exactly one sleeping thread.
+			 IMP: Don't destroy the queue while threads are blocked on it. Push a 'stop' element for each of them instead.
+	*/
+	ret_e pop(q_data_t &obj, osa_q_wait_e wait);
+
+	/* popTimed : Same as pop(obj, OSA_Q_WAIT) but gives up after 'timeoutUs' micro seconds and returns OSA_ERR_TIMEDOUT */
+	ret_e popTimed(q_data_t &obj, u32_t timeoutUs);
+
+	/* pushBatch : Push 'n' elements with a single claim on the tail. Either all the 'n' elements are pushed (in order) or 
+				   none is, in which case OSA_ERR_QFULL is returned.
+		IN objs  : Array of at least 'n' elements
+	*/
+	ret_e pushBatch(q_data_t *objs, u32_t n);
+
+	/* popBatch : Pop up to 'max' elements with a single claim on the head. Never blocks. 
+		IN max   : Must be at least 1, OSA_ERR_BADPARAM otherwise
+		OUT objs : Array of at least 'max' elements. Filled in queue order.
+		OUT got  : Number of elements actually popped, 0 on any error. OSA_ERR_QEMPTY is returned if it is 0.
+	*/
+	ret_e popBatch(q_data_t *objs, u32_t max, u32_t &got);
+
+	/* Get the top element but don't remove it from the queue. With multiple consumers, the element may be popped by
+	   another thread right after peek returns */
 	ret_e peek(q_data_t &obj);
 
-	/* returns -1 on error, number of elements in the queue otherwise */
+	/* returns -1 on error, number of elements in the queue otherwise. With concurrent push/pop the value is a snapshot */
 	i32_t curSize();	
+
+private:
+	osa_q(const osa_q &);				/* Not copyable. The ring is owned by exactly one osa_q */
+	osa_q & operator=(const osa_q &);
+
+	osa_qCell_t *		cells;
+	u64_t 				mask;			/* capacity - 1 */
+	osa_q_type_e 		type;
+	int 				isAlive;
+
+	/* head (consumers) and tail (producers) are kept on separate cache lines so that pushing threads and popping threads
+	   don't keep stealing the line from each other. 
+	   SPSC only: each side keeps its last seen copy of the other side's index on its own line and reloads it only when 
+	   the ring looks full (producer) or empty (consumer). */
+	char 				pad0[OSA_CACHELINE_SZ];
+	std::atomic<u64_t> 	tail;			/* Next position to push at */
+	u64_t 				headCache;		/* SPSC: producer's copy of head */
+	char 				pad1[OSA_CACHELINE_SZ - sizeof(std::atomic<u64_t>) - sizeof(u64_t)];
+	std::atomic<u64_t> 	head;			/* Next position to pop from */
+	u64_t 				tailCache;		/* SPSC: consumer's copy of tail */
+	char 				pad2[OSA_CACHELINE_SZ - sizeof(std::atomic<u64_t>) - sizeof(u64_t)];
+
+	/* Sleeping consumers. 'waiters' is read by every push, 'wakeSeq' is the futex word the consumers sleep on */
+	std::atomic<u32_t> 	waiters;
+	std::atomic<u32_t> 	wakeSeq;
+	char 				pad3[OSA_CACHELINE_SZ - 2*sizeof(std::atomic<u32_t>)];
+
+	ret_e waitPop(q_data_t &obj, i64_t timeoutUs);
+	void wakeWaiters(u32_t count);
+
+	ret_e spscPush(q_data_t *objs, u32_t n);
+	ret_e spscPop(q_data_t *objs, u32_t max, u32_t &got);
+	ret_e spscPeek(q_data_t &obj);
 };
 
 
@@ -161,8 +532,15 @@ public:
 
 #ifdef __linux__
 typedef int32_t  				osa_ioHd_t; 	/** TO DO: int32_t or int ?? **/
+typedef FILE  					osa_fileHd_t; 	/* Check F I L E    P R O C E S S I N G. Here for osa_socket::sendFile */
 #endif
 
+#define OSA_SOCK_Q_SIZE		1024	/* Max packets waiting in the asynchronous send queue of a socket */
+#define OSA_SOCK_TX_BATCH	32		/* Packets taken out of the send queue at once by the event loop */
+#define OSA_SOCK_MMSG_MAX	64		/* Datagrams handed to the kernel in one sendmmsg/recvmmsg call by sendBatch/recvBatch */
+#define OSA_SOCK_IOV_MAX	8		/* Max segments of one sendv/recvv */
+#define OSA_SOCK_ZC_MIN		16384	/* setZeroCopy: smaller packets are copied anyway. Pinning their pages costs more */
+
 #define SOCKADDR_MAX_STR_SZ 108		/* IPV4 text representation takes 16 bytes, IPV6 45 at max, For unix domain sockets, linux's
 										equivalent structure uses 108. Hences using the maximum value available */
 
@@ -193,6 +571,8 @@ typedef enum osa_sockErr_e
 	OSA_SOCKERR_TIMEDOUT, 			/* connect timed out. */
 	OSA_SOCKERR_FAULTADDR, 			/* Socket address provided doesn't match socket type */
 	OSA_SOCKERR_NODESTSET,			/* Remote address not set on socket */
+	OSA_SOCKERR_WOULDBLOCK, 		/* Asynchronous socket: nothing more to recv/accept right now. Wait for next recvReadyCb */
+	OSA_SOCKERR_CONNCLOSED, 		/* Remote side has closed the connection (recv returned 0 bytes) */
 	OSA_SOCKERR_UNKNOWN
 
 }osa_sockErr_e;
@@ -249,12 +629,74 @@ typedef struct osa_sockAddrGeneric_t
 	u32_t 			 addrLen;
 }osa_sockAddrGeneric_t;
 
+/* osa_sockAddr_t : IP socket address in binary form, as the kernel takes it (struct sockaddr_in/sockaddr_in6).
+					Resolve it once from the text form with osa_sockAddrResolve and reuse it for every sendto/connect: no
+					inet_pton/inet_ntop runs per packet. recvfrom fills it straight from the kernel.
+					Unused bytes are always zero, so two handles of the same address compare equal byte by byte and can
+					be used as keys (osa_sockAddrEqual, osa_sockAddrHash).
+	len : Bytes of 'bin' in use. 0 means the handle doesn't hold an address
+*/
+#define OSA_SOCKADDR_BIN_SZ 	28 		/* sizeof(struct sockaddr_in6) */
+
+typedef struct osa_sockAddr_t
+{
+	u32_t 	len;
+	union
+	{
+		u8_t 	bin[OSA_SOCKADDR_BIN_SZ];
+		u32_t 	align; 					/* sockaddr_in/in6 need 4 byte alignment */
+	};
+}osa_sockAddr_t;
+
+/* osa_sockAddrResolve : Convert a text address (OSA_AF_INET/OSA_AF_INET6) to the binary handle. 
+						 Returns OSA_ERR_BADPARAM if the address is not valid */
+ret_e osa_sockAddrResolve(osa_sockAddrIn_t &src, osa_sockAddr_t &dst);
+
+/* osa_sockAddrToStr : Convert the binary handle back to text form (e.g. for logs). Not meant for the per packet path */
+ret_e osa_sockAddrToStr(osa_sockAddr_t &src, osa_sockAddrIn_t &dst);
+
+/* osa_sockAddrEqual : Same family, address and port */
+bool osa_sockAddrEqual(const osa_sockAddr_t &a, const osa_sockAddr_t &b);
+
+/* osa_sockAddrHash : Hash of the address, for hash tables keyed by peer (FNV-1a) */
+u32_t osa_sockAddrHash(const osa_sockAddr_t &addr);
+
+/* osa_iovec_t : One segment of a scattered buffer (sendv/recvv). e.g. protocol header and payload kept in separate 
+				 buffers go out as one message without copying them together */
+typedef struct osa_iovec_t
+{
+	void *	buf;
+	i32_t 	len;
+}osa_iovec_t;
+
+/* osa_sockMsg_t : One datagram of osa_socket::sendBatch/recvBatch.
+	buf 	 : sendBatch: data to be sent. recvBatch: buffer where the datagram is copied
+	len 	 : sendBatch: bytes to be sent. recvBatch: size of 'buf'
+	bytes 	 : OUT. Bytes actually sent/received
+	msgFlags : OUT. recvBatch only. e.g. MSG_TRUNC when the datagram was bigger than 'len' (rest of it is lost)
+*/
+typedef struct osa_sockMsg_t
+{
+	void *	buf;
+	i32_t 	len;
+	i32_t 	bytes;
+	i32_t 	msgFlags;
+}osa_sockMsg_t;
+
 
 class osa_socket;
+class osa_eventLoop;
+struct pktData_t;
+struct osa_uring_t;
+struct osa_uringSock_t;
+struct epoll_event;
 
 /* osa_sendCompleteCb : Send complete indication callback for non-blocking (asynchronous) io send (e.g. socket send).
 					 This function will be called by osa-lib after data is sent on fd. User can do any post-processing
 					 needed (freeing memory etc) in this callback.
+					 It is called once per send/sendto, in the same order as the sends, from the event loop thread.
+					 If the socket failed (e.g. connection reset), it is still called for every queued packet so that
+					 the caller can release its buffers.
 
    IN hd 		   : Handle for which this callback is called.
    IN appData	   : Caller provided pointer. This could point to a structure/buffer in caller  memory.
@@ -267,6 +709,9 @@ typedef void (*osa_sendCompleteCb)(osa_socket &sock, void * appData);
 					This function will be called by osa-lib when fd is ready for recv operation i.e. there is data 
 					available to be read on this handle (e.g. packet available on a socket). Caller should call recv() 
 					(e.g. osa_recv/recvfrom) inside this callback.
+					IMP: The event loop is edge triggered. The callback is called once when new data arrives, not as long 
+					as there is data. So keep calling recv/recvfrom/accept till it fails with OSA_SOCKERR_WOULDBLOCK (or 
+					OSA_SOCKERR_CONNCLOSED), otherwise the remaining data will be noticed only when more data arrives.
 					
    IN osa_ioHd_t  : The handle on which data is ready.
    IN appData	  : Caller provided pointer. This could point to a structure/buffer in caller  memory.
@@ -280,6 +725,8 @@ class osa_socket
 
 public:
 
+	osa_socket();
+
 /* create 	: Create a socket. (This creates an empty socket. It needs to be configured with further 
 				  API calls before it can be used)
 
@@ -292,7 +739,11 @@ public:
 */
 	ret_e create(osa_sockDomain_e domain, osa_sockType_e type, i32_t protocol, osa_sockErr_e &sockErr);
 
-/* Set the socket for asynchronous io. Refer Asynchronous IO section for details */
+/* Set the socket for asynchronous io. Refer Asynchronous IO section for details.
+   The socket needs to be added to an osa_eventLoop (osa_eventLoop::add) after this, for the callbacks to be called.
+   The descriptors of queued packets come from one osa_pool shared by all the sockets of the process. It grows a slab
+   (OSA_POOL_SLAB_SZ) at a time when the thread caches run dry and is never freed, so after warm up asynchronous
+   send/sendto don't touch the heap. Listening sockets get no send queue */
 	ret_e makeAsynchronous(osa_sendCompleteCb sendCompleteCb, osa_recvReadyCb recvReadyCb, void * appData);
 
 
@@ -312,6 +763,9 @@ public:
 */
 	ret_e bind(osa_sockAddrGeneric_t &addr, osa_sockErr_e &sockErr);
 
+/* bind		: Bind a resolved address (check #osa_sockAddr_t) to the empty socket */
+	ret_e bind(osa_sockAddr_t &addr, osa_sockErr_e &sockErr);
+
 
 /* listen	: Start listening for new connections. This tells the operating systems that we are now ready to accept
 				  new connections. Only valid for TCP sockets (SOCK_STREAM/SEQPACKET) and UDP (SOCK_DGRAM) doesn't have a 
@@ -344,6 +798,7 @@ public:
 */
    ret_e connect(osa_sockAddrIn_t &rAddr, osa_sockErr_e &sockErr);
    ret_e connect(osa_sockAddrGeneric_t &rAddr, osa_sockErr_e &sockErr);
+   ret_e connect(osa_sockAddr_t &rAddr, osa_sockErr_e &sockErr);
 
 
 /* send	: Send data on a socket. Can be used for a connected (tcp) socket.
@@ -369,6 +824,31 @@ public:
 */
 	ret_e sendto(void *buf, i32_t len, i32_t flags, osa_sockAddrIn_t &rAddr, osa_sockErr_e &sockErr);
 	ret_e sendto(void *buf, i32_t len, i32_t flags, osa_sockAddrGeneric_t &rAddr, osa_sockErr_e &sockErr);
+	ret_e sendto(void *buf, i32_t len, i32_t flags, osa_sockAddr_t &rAddr, osa_sockErr_e &sockErr); /* Fastest, check #osa_sockAddr_t */
+
+
+/* sendv	: Same as send, but the data is gathered from 'iovCnt' segments (sendmsg). Nothing is copied together.
+			  On an asynchronous socket the segment list is copied into the send queue, the buffers themselves must stay
+			  valid till sendCompleteCb (once for the whole message).
+
+	IN iov 			: Segments in the order they are to be sent
+	IN iovCnt 		: Number of segments. 1 to OSA_SOCK_IOV_MAX
+	IN flags 		: Same as send
+*/
+	ret_e sendv(osa_iovec_t *iov, i32_t iovCnt, i32_t flags, osa_sockErr_e &sockErr);
+
+
+/* sendFile : Send a range of a file on a connected (tcp) socket. The kernel moves the data from the page cache to the 
+			  socket (sendfile), it is never copied through user space. The file position of 'hd' is not used or moved.
+			  If socket has been configured for asynchronous io, the range is added to the send queue like a send and 
+			  sendCompleteCb() is called once all of it is sent. The file must stay open till then.
+
+	IN hd 		: File opened for reading (osa_file_open)
+	IN offset 	: Byte offset in the file to start from
+	IN len 		: Number of bytes to send. At most 2 GB per call on an asynchronous socket. If the file ends before,
+				  the send fails (and on an asynchronous socket the send queue is dropped like on any send error)
+*/
+	ret_e sendFile(osa_fileHd_t &hd, i64_t offset, i64_t len, osa_sockErr_e &sockErr);
 
 
 /* recv 	: Receive data from socket. Can be used with connected (tcp) sockets.
@@ -383,6 +863,14 @@ public:
 	ret_e recv(void *buf, i32_t bufSize, i32_t *bytesRead, i32_t flags, osa_sockErr_e &sockErr);
 
 
+/* recvv 	: Same as recv, but the data is scattered over 'iovCnt' segments (recvmsg). A segment is filled completely 
+			  before the next one is used. 'bytesRead' is the total over all segments.
+			  e.g. read a fixed size header and the payload behind it into separate buffers with one call.
+	IN iovCnt 	: Number of segments. 1 to OSA_SOCK_IOV_MAX
+*/
+	ret_e recvv(osa_iovec_t *iov, i32_t iovCnt, i32_t *bytesRead, i32_t flags, osa_sockErr_e &sockErr);
+
+
 /* recvfrom: Receive data from socket. Can be used with connected and datagram (tcp/udp) sockets.
 					  If socket has been configured for asynchronous io (with osa_io_makeASynchronous), this function 
 					  should be called in osa_recvReadyCb callback.
@@ -399,15 +887,78 @@ public:
 	ret_e recvfrom(void * buf, i32_t bufSize, i32_t *bytesRead, i32_t flags, 
 		osa_sockAddrGeneric_t &rAddr, osa_sockErr_e &sockErr);
 
+	/* Fastest for IP sockets. rAddr is filled without any text conversion. Check #osa_sockAddr_t */
+	ret_e recvfrom(void * buf, i32_t bufSize, i32_t *bytesRead, i32_t flags, 
+		osa_sockAddr_t &rAddr, osa_sockErr_e &sockErr);
+
+
+/* sendBatch : Send many datagrams with one system call per OSA_SOCK_MMSG_MAX of them (sendmmsg). For datagram (udp) 
+			   sockets. The datagrams are sent right away, even on an asynchronous socket (they don't go through the send 
+			   queue and sendCompleteCb is not called). So don't mix it with queued sendto on the same socket.
+
+	IN  msgs 	: Datagrams to be sent. 'bytes' of each sent datagram is filled
+	IN  count 	: Number of entries in 'msgs'
+	IN  flags 	: Same as sendto, applied to every datagram
+	IN  rAddrs 	: Destination of each datagram ('count' entries), in text or binary (faster) form. A connected socket uses 
+				  the overload without it
+	OUT sent 	: Number of datagrams sent. Can be less than 'count' if the socket is non blocking and its buffer got 
+				  full. OSA_SUCCESS is returned if at least one datagram went out
+*/
+	ret_e sendBatch(osa_sockMsg_t *msgs, u32_t count, i32_t flags, osa_sockAddrIn_t *rAddrs, u32_t *sent, 
+		osa_sockErr_e &sockErr);
+	ret_e sendBatch(osa_sockMsg_t *msgs, u32_t count, i32_t flags, osa_sockAddr_t *rAddrs, u32_t *sent, 
+		osa_sockErr_e &sockErr);
+	ret_e sendBatch(osa_sockMsg_t *msgs, u32_t count, i32_t flags, u32_t *sent, osa_sockErr_e &sockErr);
+
+
+/* recvBatch : Receive many datagrams with one system call per OSA_SOCK_MMSG_MAX of them (recvmmsg). For datagram (udp)
+			   sockets. A blocking socket waits for the first datagram only, then takes whatever else is already queued.
+			   In recvReadyCb, keep calling it till it fails with OSA_SOCKERR_WOULDBLOCK.
+			   Not for a stream socket in an io_uring loop (OSA_SOCKERR_OPNOTSUPP): its data is with the loop, use recv.
+
+	IN  msgs 	 : Buffers to receive into. 'bytes' and 'msgFlags' of each received datagram are filled
+	IN  count 	 : Number of entries in 'msgs'
+	IN  flags 	 : Same as recvfrom, applied to every datagram
+	OUT rAddrs 	 : Source of each received datagram ('count' entries), in text or binary (faster) form. Use the overload
+				   without it if the sources are not needed
+	OUT received : Number of datagrams received
+*/
+	ret_e recvBatch(osa_sockMsg_t *msgs, u32_t count, i32_t flags, osa_sockAddrIn_t *rAddrs, u32_t *received,
+		osa_sockErr_e &sockErr);
+	ret_e recvBatch(osa_sockMsg_t *msgs, u32_t count, i32_t flags, osa_sockAddr_t *rAddrs, u32_t *received,
+		osa_sockErr_e &sockErr);
+	ret_e recvBatch(osa_sockMsg_t *msgs, u32_t count, i32_t flags, u32_t *received, osa_sockErr_e &sockErr);
+
 
 	ret_e getSockAddr(osa_sockAddrIn_t &sAddrOsa);
 
 	ret_e getsockPeerAddr(osa_sockAddrIn_t &peerAddrOsa);
 
-/* destroy 	: Close the socket. This call closes the socket and frees the socket context inside kernel */
+/* setReusePort : Allow several sockets (usually one per thread) to bind the same address and port. The kernel spreads the
+				  incoming connections/datagrams over them. Must be called before bind. */
+	ret_e setReusePort(osa_sockErr_e &sockErr);
+
+/* setZeroCopy : Send large packets of this asynchronous socket straight from the caller's buffers, without copying them
+				 into the kernel (SO_ZEROCOPY/MSG_ZEROCOPY, tcp on linux 4.14 or later).
+				 Packets of OSA_SOCK_ZC_MIN bytes or more are sent this way. sendCompleteCb of such a packet is called only 
+				 when the kernel is done with its buffer (usually once the peer acknowledged the data), so the buffer
+				 can be reused or freed in the callback and not before. Smaller packets are copied and completed as soon as
+				 they are written. sendCompleteCb still comes once per packet, in order.
+				 Only the epoll backend sends zero copy, an io_uring loop copies every packet.
+*/
+	ret_e setZeroCopy(osa_sockErr_e &sockErr);
+
+/* destroy 	: Close the socket. This call closes the socket and frees the socket context inside kernel.
+				  An asynchronous socket is removed from its event loop first. Packets still waiting in the send queue are
+				  dropped without calling sendCompleteCb. */
 	ret_e destroy();
 
+/* getEventLoop : Event loop the socket is added to. NULL if it is not added to any */
+	osa_eventLoop * getEventLoop();
+
 private:
+	friend class osa_eventLoop;
+
 	int sockFd;
 	int isAsync;
 	osa_q sockQ;
@@ -415,6 +966,32 @@ private:
 	osa_recvReadyCb recvReadyCb;
 	void * appData;
 	void setSockFd(int newSockFd);
+
+	/* Asynchronous send state. Only touched by the event loop thread (except txScheduled) */
+	osa_eventLoop *		evLoop;
+	osa_socket *		evPrev; 					/* List of the sockets in evLoop */
+	osa_socket *		evNext;
+	std::atomic<int> 	txScheduled;				/* Socket is already queued in evLoop for a flush */
+	q_data_t 			txBatch[OSA_SOCK_TX_BATCH]; /* Packets taken out of sockQ and not yet completely sent */
+	u32_t 				txCnt; 
+	u32_t 				txIdx;
+	i32_t 				txOff; 						/* Bytes of txBatch[txIdx] already sent */
+	osa_uringSock_t *	ioCtx;						/* io_uring backend: per socket state, owned by evLoop */
+	int 				zcMode; 					/* setZeroCopy was called */
+	u32_t 				zcSeq;						/* Id the kernel gives to the next zero copy send call */
+	u32_t 				zcDone;						/* Zero copy calls before this id are completed by the kernel */
+	pktData_t *			zcHead;						/* Written zero copy packets waiting for their completion. Oldest first */
+	pktData_t *			zcTail;
+
+	pktData_t * pktGet(osa_sockErr_e &sockErr);
+	void pktPut(pktData_t *pkt);
+	ret_e queuePkt(pktData_t *pkt, osa_sockErr_e &sockErr);
+	pktData_t * txHead();
+	void txAdvance(i32_t sent);
+	void flushSendQ();
+	void dropSendQ(int notify);
+	void zcReap();
+	void onReadable();
 };
 
 
@@ -450,6 +1027,202 @@ private:
 */
 ret_e osa_io_makeASynchronous(osa_ioHd_t fd, osa_sendCompleteCb sendCompleteCb, osa_recvReadyCb recvReadyCb);
 
+/* osa_eventLoop : Reactor which drives asynchronous sockets. 
+					One thread calls run() and, from then on, all the callbacks of the sockets added to this loop are called
+					from that thread:
+					- recvReadyCb when the socket becomes readable (or a listening socket has new connections)
+					- the send queue (filled by send/sendto from any thread) is written out when the socket is writable,
+					  and sendCompleteCb is called for every packet sent.
+					Internally it uses edge triggered epoll, so one thread can serve tens of thousands of sockets. Threads 
+					which queue packets wake the loop up through an eventfd.
+
+					With OSA_EVLOOP_IOURING the loop drives the same sockets and the same callbacks through io_uring 
+					instead (linux 5.19 or later). Nothing changes for the user of the socket, so both backends can be 
+					compared in the same binary:
+					- listening sockets run one multishot accept. Connections accepted by the kernel wait in the socket
+					  till accept() picks them up.
+					- stream sockets run one multishot recv which fills buffers from a ring owned by the loop 
+					  (OSA_URING_NUM_BUFS x OSA_URING_BUF_SZ). recv() copies out of these buffers and gives them back 
+					  to the kernel. recv flags (e.g. MSG_PEEK) are ignored. A socket which is not read stops its recv
+					  once it holds OSA_URING_SOCK_MAX_BUFS buffers. While a socket's recv is stopped (held back, or the
+					  ring ran dry) recv() reads the socket directly once its buffers are used up, so one slow reader
+					  never stalls the others. Connect the socket (or start connecting) before adding it.
+					- other sockets (e.g. UDP) get a multishot poll and are read with the normal recvfrom().
+					- send/sendto are submitted as IORING_OP_SEND/SENDMSG, one request in flight per socket.
+
+   Typical usage:
+		osa_eventLoop loop;
+		loop.create();				// or loop.create(OSA_EVLOOP_IOURING)
+		sock.makeAsynchronous(sendDone, readable, ctx);
+		loop.add(sock);
+		loop.run();				// In the io thread. Returns after loop.stop()
+*/
+
+#define OSA_EVLOOP_MAX_EVENTS		256		/* Events picked from the kernel in one wake up */
+#define OSA_EVLOOP_PEND_Q_SIZE		65536 	/* Max sockets with a pending flush request */
+
+#define OSA_URING_SQ_ENTRIES		4096	/* io_uring backend: submission ring size. Completion ring is 4 times bigger */
+#define OSA_URING_NUM_BUFS			1024	/* io_uring backend: receive buffers shared by the sockets of a loop (power of 2) */
+#define OSA_URING_BUF_SZ			4096	/* io_uring backend: size of one receive buffer */
+#define OSA_URING_SOCK_MAX_BUFS		64		/* io_uring backend: receive buffers one socket may hold. Its recv pauses above this */
+#define OSA_URING_ACCEPT_STASH		64		/* io_uring backend: accepted connections a listener holds for accept() */
+
+/* osa_evLoopBackend_e : Kernel interface used by an osa_eventLoop */
+typedef enum osa_evLoopBackend_e
+{
+	OSA_EVLOOP_EPOLL,		/* Readiness notification with edge triggered epoll (default) */
+	OSA_EVLOOP_IOURING,		/* Completion based io with io_uring. Needs linux 5.19 or later */
+}osa_evLoopBackend_e;
+
+class osa_eventLoop
+{
+public:
+	osa_eventLoop();
+	~osa_eventLoop();
+
+	/* create : Create the kernel objects for the loop.
+		IN backend : Check #osa_evLoopBackend_e. If the kernel doesn't support io_uring, OSA_ERR_COREFUNCFAIL is returned
+					 and the caller can fall back to OSA_EVLOOP_EPOLL.
+	*/
+	ret_e create(osa_evLoopBackend_e backend = OSA_EVLOOP_EPOLL);
+
+	/* getBackend : Backend the loop was created with */
+	osa_evLoopBackend_e getBackend();
+
+	/* destroy : Close the loop. Sockets are not closed, they are only detached from the loop. Packets still in their send
+				 queues are dropped without sendCompleteCb. Must not be called while the loop runs */
+	ret_e destroy();
+
+	/* add : Start watching an asynchronous socket (makeAsynchronous must have been called on it).
+			 A socket can be in only one loop at a time. Same threading rule as remove() */
+	ret_e add(osa_socket &sock);
+
+	/* remove : Stop watching the socket. Must be called from the loop thread (e.g. from a callback) or when the loop is not
+				running. osa_socket::destroy calls it internally. */
+	ret_e remove(osa_socket &sock);
+
+	/* run : Process events till stop() is called. Should be called by exactly one thread */
+	ret_e run();
+
+	/* runOnce : Wait up to 'timeoutMs' milliseconds (-1: forever) for events and process them. Useful if the caller 
+				 wants to do other work in the same thread */
+	ret_e runOnce(i32_t timeoutMs);
+
+	/* stop : Ask run() to return. Can be called from any thread */
+	ret_e stop();
+
+private:
+	friend class osa_socket;
+
+	osa_eventLoop(const osa_eventLoop &);
+	osa_eventLoop & operator=(const osa_eventLoop &);
+
+	int 				epFd;
+	int 				wakeFd; 		/* eventfd used by other threads to wake the loop up */
+	int 				isAlive;
+	std::atomic<int> 	stopReq;
+	osa_q 				pendQ;			/* Sockets which have new packets in their send queue */
+	std::atomic<int> 	pendOverflow; 	/* pendQ was full. The sockets with txScheduled set are not all in it */
+	osa_evLoopBackend_e backend;
+	osa_uring_t *		uring;			/* io_uring backend only */
+	osa_socket *		socks; 			/* Sockets in the loop (osa_socket::evNext) */
+	osa_socket *		socksNext; 		/* Next socket of a walk over 'socks'. unlink() moves it on */
+
+	/* Callbacks may remove and free any socket, also the one they are called for. remove() clears curSock and the
+	   not yet processed events of the socket, so the loop knows not to touch it any more */
+	osa_socket *		curSock;		/* Socket whose callbacks are running */
+	struct epoll_event *curEvents;		/* Batch returned by epoll_wait */
+	int 				curNext; 		/* Next event of curEvents to process */
+	int 				curNum;
+
+	void scheduleFlush(osa_socket &sock);
+	void handlePending();
+	bool isCurrent(osa_socket &sock);
+	void link(osa_socket &sock);
+	void unlink(osa_socket &sock);
+
+	/* io_uring backend (linux/osa_uring.cc) */
+	ret_e uringCreate();
+	void uringDestroy();
+	ret_e uringAdd(osa_socket &sock);
+	void uringRemove(osa_socket &sock);
+	ret_e uringRunOnce(i32_t timeoutMs);
+	void uringHandleCqe(u64_t userData, i32_t res, u32_t flags);
+	void uringFlush(osa_socket &sock);
+	int uringAccept(osa_socket &sock);
+	i32_t uringRecv(osa_socket &sock, void *buf, i32_t bufSize, i32_t flags, void *addr = NULL, u32_t *addrLen = NULL);
+	int uringOwnsRx(osa_socket &sock);
+};
+
+/* osa_eventLoopGroup : Multi-reactor. Runs one osa_eventLoop per thread, one thread per cpu (pinned to it). The loops
+					take one cpu of every core before any SMT sibling (osa_topology_spread).
+					Each loop has its own listening socket, all bound to the same address with SO_REUSEPORT, so the kernel 
+					spreads new connections over the loops. The connection is accepted in the loop (and on the cpu) which
+					owns the listener and should be added to that same loop, so all its io stays on one core and no socket
+					is ever handed over between threads.
+
+   Typical usage:
+		void onAccept(osa_socket &lsn, void *appData)
+		{
+			osa_socket *conn = newConnection();
+			while(OSA_SUCCESS == lsn.accept(*conn, err))
+			{
+				conn->makeAsynchronous(sendDone, readable, conn);
+				lsn.getEventLoop()->add(*conn);
+				conn = newConnection();
+			}
+		}
+
+		osa_eventLoopGroup grp;
+		grp.start(0, lAddr, 1024, onAccept, ctx);		// 0 : one loop per online cpu
+		...
+		grp.stop();
+*/
+
+typedef struct osa_evLoopSlot_t
+{
+	osa_eventLoop 		loop;
+	osa_socket 			listener;
+	osa_ThreadHandle_t 	thr;
+	i32_t 				cpu;
+	int 				thrAlive;
+}osa_evLoopSlot_t;
+
+class osa_eventLoopGroup
+{
+public:
+	osa_eventLoopGroup();
+	~osa_eventLoopGroup();
+
+	/* start : Create the loops, the listeners and the threads.
+		IN numLoops : Number of loops/threads. 0 means one per online cpu.
+		IN lAddr 	: Local address to listen on (TCP).
+		IN maxCon 	: Listen backlog of each listener.
+		IN acceptCb : recvReadyCb of the listeners. Called in the loop thread when new connections are waiting. 
+					  It should accept() till OSA_SOCKERR_WOULDBLOCK and add the new sockets to listener.getEventLoop().
+		IN appData 	: Passed to acceptCb
+	*/
+	ret_e start(u32_t numLoops, osa_sockAddrIn_t &lAddr, i32_t maxCon, osa_recvReadyCb acceptCb, void * appData);
+
+	/* stop : Stop all the loops, wait for the threads to exit and close the listeners. The connections still in the loops
+			  are detached (check osa_eventLoop::destroy), the application destroys them afterwards as usual */
+	ret_e stop();
+
+	u32_t getNumLoops();
+
+	/* getLoop : Loop number 'idx' (0 .. getNumLoops()-1). Handy for client sockets which should be spread over the loops */
+	osa_eventLoop * getLoop(u32_t idx);
+
+private:
+	osa_eventLoopGroup(const osa_eventLoopGroup &);
+	osa_eventLoopGroup & operator=(const osa_eventLoopGroup &);
+
+	osa_evLoopSlot_t * 	slots;
+	u32_t 				numLoops;
+
+	static void * loopThread(void * arg);
+};
+
 /** TO DO : Do we add inotify type api here?? **/
 
 
@@ -459,9 +1232,7 @@ ret_e osa_io_makeASynchronous(osa_ioHd_t fd, osa_sendCompleteCb sendCompleteCb,
 *			F I L E    P R O C E S S I N G
 *********************************************************/
 
-#ifdef __linux__
-typedef FILE  				osa_fileHd_t;
-#endif
+/* osa_fileHd_t is defined in the socket section */
 
 typedef struct osa_fileErr_e
 {
@@ -582,6 +1353,41 @@ typedef struct osa_thread_stack_t
 	u8_t  *buf;
 }osa_thread_stack_t;
 
+/* CPU SETS : Set of logical cpus a thread may run on (its affinity). Cpu numbers are the ones of the OS (0 .. OSA_CPU_MAX-1).
+			  Check #CPU TOPOLOGY below to find which cpus share a core, a cache or a NUMA node */
+
+#define OSA_CPU_MAX 		1024
+
+typedef struct osa_cpuSet_t
+{
+	u64_t bits[OSA_CPU_MAX / 64];
+}osa_cpuSet_t;
+
+inline void osa_cpuSet_zero(osa_cpuSet_t &set)
+{
+	memset(&set, 0, sizeof(set));
+}
+
+inline void osa_cpuSet_add(osa_cpuSet_t &set, i32_t cpu)
+{
+	if(0 <= cpu && cpu < OSA_CPU_MAX)
+		set.bits[cpu / 64] |= 1ull << (cpu % 64);
+}
+
+inline bool osa_cpuSet_has(const osa_cpuSet_t &set, i32_t cpu)
+{
+	return 0 <= cpu && cpu < OSA_CPU_MAX && 0 != (set.bits[cpu / 64] & (1ull << (cpu % 64)));
+}
+
+inline u32_t osa_cpuSet_count(const osa_cpuSet_t &set)
+{
+	u32_t n = 0;
+
+	for(u32_t i = 0; i < OSA_CPU_MAX / 64; i++)
+		n += (u32_t)__builtin_popcountll(set.bits[i]);
+	return n;
+}
+
 
 /* osa_thread_create :: Create a new thread
 		OUT t 		:: Thread handle. After the call returns, 't' will be populated with thread handle which should be used in
@@ -596,9 +1402,51 @@ typedef struct osa_thread_stack_t
 		IN arg 		:: Argument to ThreadFunc-Func. This can be used to share data from calling thread to called thread
 		IN stack    :: User can provide where thread stack should reside. This should be used only if user has specialized
 					   requirements. Otherwise it should be set to NULL.
+		IN cpus 	:: Cpus the thread may run on. The thread starts on one of them, it is never moved to another cpu
+					   first. NULL means any cpu (as the creating thread).
 */
 ret_e osa_thread_create(osa_threadHd_t &t, ThreadFunc func, osa_thread_priority_e &prio, char thrName[15], void * arg,
-			osa_thread_stack_t *stack);
+			osa_thread_stack_t *stack, const osa_cpuSet_t * cpus = NULL);
+
+/* osa_thread_setAffinity :: Restrict the calling thread to the cpus in 'cpus'. E.g. for the main thread, which is not created
+							 with osa_thread_create */
+ret_e osa_thread_setAffinity(const osa_cpuSet_t &cpus);
+
+/* CPU TOPOLOGY : How the online cpus are laid out. Read from /sys/devices/system at the time of the call.
+				  Threads that share data run best on cpus sharing a cache (same l2Id / l3Id). Threads that don't share data
+				  run best on different cores: two SMT siblings (same core) share one core's execution units and caches.
+				  Memory is fastest from the NUMA node of the cpu (check osa_mallocLarge) */
+
+typedef struct osa_cpuInfo_t
+{
+	i32_t cpu; 				/* Number of the logical cpu in the OS */
+	i32_t core; 			/* Physical core, 0 .. numCores-1. Cpus with the same core are SMT siblings */
+	i32_t package; 			/* Socket, as numbered by the OS */
+	i32_t node; 			/* NUMA node */
+	i32_t l2Id; 			/* Cpus with the same l2Id share a L2 cache. It is the lowest cpu sharing it. -1 if unknown */
+	i32_t l3Id; 			/* Same for the L3 (last level) cache */
+}osa_cpuInfo_t;
+
+typedef struct osa_topology_t
+{
+	u32_t 			numCpus; 			/* Online cpus. Entries of 'cpus' */
+	u32_t 			numCores;
+	u32_t 			numPackages;
+	u32_t 			numNodes;
+	osa_cpuInfo_t 	cpus[OSA_CPU_MAX]; 	/* Sorted by cpu number */
+}osa_topology_t;
+
+/* osa_topology_get :: Fill 'topo'. Missing information (e.g. no NUMA support in the kernel) is reported as one node,
+					   one package and one core per cpu */
+ret_e osa_topology_get(osa_topology_t &topo);
+
+/* osa_topology_nodeCpus :: Cpus of NUMA node 'node' */
+void osa_topology_nodeCpus(const osa_topology_t &topo, i32_t node, osa_cpuSet_t &cpus);
+
+/* osa_topology_spread :: Order in which to place threads that should not disturb each other (one per cpu): first one cpu
+						  of every core, taking the nodes in turn, then the SMT siblings. Only cpus the calling thread may
+						  run on (sched_getaffinity) are taken. Returns the number of cpus written to 'order' (at most 'max') */
+u32_t osa_topology_spread(const osa_topology_t &topo, i32_t * order, u32_t max);
 	
 
 
@@ -634,6 +1482,12 @@ ret_e osa_thread_create(osa_threadHd_t &t, ThreadFunc func, osa_thread_priority_
 */
 ret_e osa_thread_exit(void * retVal);
 
+/* osa_thread_join :: Wait for thread 't' to exit.
+		IN t 		:: Thread to wait for. A thread can be joined only once.
+		OUT retVal 	:: Value returned by the thread function (or given to osa_thread_exit). Can be NULL.
+*/
+ret_e osa_thread_join(osa_threadHd_t &t, void ** retVal);
+
 
 /* osa_thread_kill :: Kill another thread  (TO DO)
 					  Not sure how this API should behave, at this point. Or should there even be such API. Threads can
@@ -666,8 +1520,33 @@ ret_e osa_thread_cleanup_pop(int execute);
 		   TO DO: Should the mutex be recursive by default??
 		   Right now additional mutex parameters such as 'recursive-mutex' are not supported (deliberately). Simply because I
 		   haven't seen the need for it in my experience. If there is a real need, this feature can be added.
+
+		   A thread that finds the mutex locked goes to sleep in the kernel right away. With OSA_MUTEX_ADAPTIVE it first
+		   spins for a short while: critical sections are mostly short, and the owner often unlocks before a sleep plus
+		   wake up (a few micro seconds) would be over. Use it for short critical sections, on multi cpu machines (there
+		   is no spinning on a single cpu).
+		   With OSA_MUTEX_STATS the mutex counts its contention (check osa_mutexStats_t). Each lock/unlock then reads the
+		   clock, so keep it for finding the hot locks, e.g. enabled by a config switch in production.
 */
 
+#define OSA_MUTEX_SPIN 		1000 	/* Max pause instructions an adaptive mutex spins for, before sleeping */
+
+typedef enum osa_mutex_flags_e
+{
+	OSA_MUTEX_ADAPTIVE 	= 0x1, 		/* Spin before sleeping */
+	OSA_MUTEX_STATS 	= 0x2 		/* Count contention */
+}osa_mutex_flags_e;
+
+typedef struct osa_mutexStats_t
+{
+	u64_t acquisitions; 		/* Successful locks */
+	u64_t contended; 			/* Locks that found the mutex locked */
+	u64_t spinAcquired; 		/* Contended locks that got the mutex while spinning, without sleeping */
+	u64_t waitNs; 				/* Total time spent waiting in contended locks */
+	u64_t maxWaitNs; 			/* Longest wait */
+	u64_t holdNs; 				/* Total time the mutex was held (lock to unlock). holdNs / elapsed time is its utilization */
+	u64_t maxHoldNs; 			/* Longest critical section */
+}osa_mutexStats_t;
 
 class osa_mutex
 {
@@ -678,7 +1557,10 @@ public:
 
 	~osa_mutex();
 
-	ret_e create();
+	/* create :
+		IN flags : OR of osa_mutex_flags_e. 0 is a plain mutex
+	*/
+	ret_e create(u32_t flags = 0);
 	/* osa_mutex_destroy : Destroy a mutex. After this API is called, this mutex should not be used. Or there will be undefined behaviour
 		*/
 	ret_e destroy();
@@ -701,10 +1583,26 @@ public:
 	/* getNativeMutex: Returns the platform specific object. This is needed for example in case of using conditional variables */
 	void * getNativeMutex();
 
+	/* getStats : Counters since create(). Can be called any time, by any thread (also the one holding the mutex).
+				  Take two snapshots and subtract them to get the numbers of an interval. 
+				  Returns OSA_ERR_BADPARAM if the mutex was not created with OSA_MUTEX_STATS */
+	ret_e getStats(osa_mutexStats_t &stats);
+
 private:
 	pthread_mutex_t mutex;
 	int isAlive;
+	u32_t flags;
 
+	/* Written only by the owner of the mutex, read by getStats */
+	std::atomic<u64_t> nAcq, nContended, nSpinAcq, waitNs, maxWaitNs, holdNs, maxHoldNs;
+	i64_t lockedAt;
+
+	void holdStart();
+	void holdEnd();
+	friend class osa_cond;
+
+	osa_mutex(const osa_mutex &);
+	osa_mutex & operator=(const osa_mutex &);
 };
 
 
@@ -817,6 +1715,342 @@ private:
 };
 
 
+/********************************************************
+*			T H R E A D P O O L
+*********************************************************/
+
+/* osa_threadpool : A set of worker threads that run tasks (a function and its argument).
+					Every worker has its own deque of tasks (Chase-Lev work stealing deque). A task submitted by a worker
+					goes to the bottom of that worker's deque and the worker takes it back from the bottom (last in, first
+					out, so the data it touches is still in the cache). A worker with nothing to do steals from the top of
+					another worker's deque. Tasks submitted by other threads go to a shared osa_q which all the workers
+					poll. So workers don't contend on one lock/condition variable and throughput grows with the cores.
+					Idle workers spin a short while and then sleep on a futex. A submit makes a system call only if
+					some worker sleeps.
+					A worker that waits for a task (a task doing fork/join) runs pending tasks meanwhile instead of just
+					blocking. So does a thread in waitAll().
+
+					Priorities : Every task has a priority class (osa_thread_priority_e) and optionally a deadline. Whenever
+					a worker is done with a task it picks the next one in this order:
+						1. CRITICAL tasks 			(shared queue, first in first out)
+						2. Tasks with a deadline 	(earliest deadline first, whatever their class other than CRITICAL)
+						3. HIGH tasks 				(shared queue)
+						4. DEFAULT tasks 			(own deque, shared queue, stealing. As described above)
+						5. LOW tasks 				(shared queue) 	Bulk work. Runs only when nothing else is waiting
+					A running task is never interrupted. A control plane message submitted as CRITICAL waits at most for one
+					task on every worker. Tasks that start after their deadline are still run, and counted in
+					getMissedDeadlines().
+
+	Example:
+		osa_threadpool tp;
+		osa_task_t * task;
+
+		tp.create(0);							// 0 : one worker per online cpu
+		tp.submit(parseRequest, req, &task); 	// Handle only if you want to wait for this very task
+		tp.submit(writeLog, entry);
+		...
+		tp.wait(task);							// parseRequest(req) has returned
+		tp.waitAll(); 							// Everything submitted so far has returned
+		tp.destroy();
+*/
+
+#define OSA_TP_DEQUE_SZ		4096		/* Tasks a worker's deque holds (power of 2). Further tasks go to the shared queue */
+#define OSA_TP_QUEUE_SZ		65536		/* Size of the shared queue for tasks submitted by other threads */
+#define OSA_TP_SPIN 		200			/* An idle worker looks for tasks this many times before it goes to sleep */
+#define OSA_TP_HELP_DEPTH	16			/* A waiting worker runs tasks of other workers nested this deep at most */
+#define OSA_TP_URGENT_SZ	4096		/* Size of the CRITICAL and HIGH queues and max number of pending deadline tasks.
+										   When full, deadline tasks go to the HIGH queue */
+
+typedef void (*osa_taskFunc)(void * arg);
+
+typedef struct osa_task_t osa_task_t;			/* Handle of a submitted task */
+typedef struct osa_tpWorker_t osa_tpWorker_t;
+typedef struct osa_tpDeadline_t osa_tpDeadline_t;
+
+class osa_threadpool
+{
+public:
+	osa_threadpool();
+	~osa_threadpool();
+
+	/* create : Start the workers.
+		IN numThreads : Number of workers. 0 means one per online cpu (one per cpu in 'cpus' if given)
+		IN cpus 	  : NULL lets the OS place (and move) the workers. Otherwise each worker is pinned to one cpu of the set,
+						one per core before using SMT siblings. E.g. the cpus of a NUMA node (osa_topology_nodeCpus)
+	*/
+	ret_e create(u32_t numThreads = 0, const osa_cpuSet_t * cpus = NULL);
+
+	/* destroy : Wait for all the submitted tasks (waitAll), then stop the workers. Task handles not waited for are lost */
+	ret_e destroy();
+
+	/* submit : Run taskFunc(arg) on one of the workers.
+		OUT task 		: If not NULL, gets a handle for wait(). Every handle must be given to wait() exactly once.
+		IN prio 		: Priority class of the task. Check T H R E A D P O O L above
+		IN deadlineUs 	: The task should start within this many micro seconds. 0 for no deadline
+		If the queue is full, the task is run by the calling thread before submit() returns.
+	*/
+	ret_e submit(osa_taskFunc taskFunc, void * arg, osa_task_t ** task = NULL,
+				 osa_thread_priority_e prio = OSA_THREAD_PRIO_DEFAULT, u32_t deadlineUs = 0);
+
+	/* wait : Wait till the task of the handle has returned. The handle is released.
+			  From a task, wait only for tasks submitted by that task (or its children) */
+	ret_e wait(osa_task_t * task);
+
+	/* waitAll : Wait till all the tasks submitted so far (and the ones they submit) have returned.
+				 IMP: Not from inside a task. The task itself would never be done */
+	ret_e waitAll();
+
+	u32_t getNumThreads();
+
+	/* getWorkerIdx : 0 .. getNumThreads()-1 when called from a worker of this pool (i.e. from a task), -1 otherwise */
+	i32_t getWorkerIdx();
+
+	/* getMissedDeadlines : Tasks started after their deadline since create() */
+	u64_t getMissedDeadlines();
+
+private:
+	osa_threadpool(const osa_threadpool &);			/* Not copyable. The workers point to their pool */
+	osa_threadpool & operator=(const osa_threadpool &);
+
+	osa_tpWorker_t *	workers;
+	u32_t 				numThreads;
+	int 				isAlive;
+	osa_q 				injectQ;		/* DEFAULT tasks submitted by threads that are not workers */
+	osa_q 				critQ;
+	osa_q 				highQ;
+	osa_q 				lowQ;
+	osa_tpDeadline_t * 	dlHeap;			/* Tasks with a deadline. Binary min heap on the deadline, protected by dlLock */
+	std::atomic<u32_t> 	dlNum;
+	std::atomic<u32_t> 	dlLock;
+	osa_pool 			tasks;			/* Memory of the osa_task_t */
+
+	/* Written by every submit/finish, kept away from the read-mostly fields above */
+	char 				pad0[OSA_CACHELINE_SZ];
+	std::atomic<u32_t> 	pending;		/* Tasks submitted and not returned yet */
+	std::atomic<u32_t> 	idleSeq;		/* Futex word of waitAll(). Goes up whenever pending drops to 0 */
+	std::atomic<u32_t> 	allWaiters;		/* Threads in waitAll() */
+	char 				pad1[OSA_CACHELINE_SZ - 3*sizeof(std::atomic<u32_t>)];
+	std::atomic<u32_t> 	sleepers;		/* Workers asleep (or going to sleep) on wakeSeq */
+	std::atomic<u32_t> 	wakeSeq;
+	std::atomic<u32_t> 	stopping;
+	std::atomic<u32_t> 	urgent;			/* Tasks in critQ, highQ and dlHeap. Workers look there only if not 0 */
+	std::atomic<u64_t> 	missed;
+	char 				pad2[OSA_CACHELINE_SZ - 4*sizeof(std::atomic<u32_t>) - sizeof(std::atomic<u64_t>)];
+
+	static void * workerThread(void * arg);
+	osa_tpWorker_t * self();
+	osa_task_t * findTask(osa_tpWorker_t * me);
+	osa_task_t * findUrgent();
+	bool deadlinePush(osa_task_t * t);
+	bool hasWork();
+	void wake();
+	void run(osa_task_t * t);
+};
+
+/* Parallel loops : Run a loop over [begin, end) on the workers of a pool. The range is split in halves till the parts
+					are at most 'grain' long. One half is submitted as a task (another worker steals it if it is idle),
+					the other is split further by the same thread. The call returns when the whole range is done.
+					They can be called from any thread, also from inside a task of the same pool.
+					'grain' 0 picks a size giving about 8 parts per worker. Use a bigger grain when the body is cheap.
+
+	Example: checksum of a big buffer in 64KB parts
+		static void sumPart(u64_t begin, u64_t end, void * acc, void * arg)
+		{
+			for(u64_t i = begin; i < end; i++)
+				*(u64_t *)acc += ((u8_t *)arg)[i];
+		}
+		static void addSums(void * acc, const void * other, void * arg)
+		{
+			*(u64_t *)acc += *(const u64_t *)other;
+		}
+
+		u64_t sum = 0;
+		osa_parallel_reduce(tp, 0, len, 65536, &sum, sizeof(sum), sumPart, addSums, buf);
+*/
+
+#define OSA_PAR_ACC_MAX		256			/* Max size of the accumulator of osa_parallel_reduce */
+
+/* osa_rangeFunc : Body of osa_parallel_for. Does the iterations begin .. end-1 */
+typedef void (*osa_rangeFunc)(u64_t begin, u64_t end, void * arg);
+
+/* osa_reduceFunc : Body of osa_parallel_reduce. Adds the iterations begin .. end-1 into 'acc' */
+typedef void (*osa_reduceFunc)(u64_t begin, u64_t end, void * acc, void * arg);
+
+/* osa_joinFunc : Adds the accumulator 'other' (of the part right after) into 'acc' */
+typedef void (*osa_joinFunc)(void * acc, const void * other, void * arg);
+
+/* osa_parallel_for : Call fn on parts of [begin, end) in parallel */
+ret_e osa_parallel_for(osa_threadpool &tp, u64_t begin, u64_t end, u64_t grain, osa_rangeFunc fn, void * arg);
+
+/* osa_parallel_reduce : Same as osa_parallel_for, with a result.
+	IN/OUT acc : Holds the identity of 'join' (0 for a sum, 1 for a product, ...) when called and the result when it
+				 returns. Every part starts with a copy of the identity. Parts are joined in order: join(acc of a part,
+				 acc of the part right after it), so 'join' need not be commutative
+	IN accSz   : Size of 'acc'. At most OSA_PAR_ACC_MAX
+*/
+ret_e osa_parallel_reduce(osa_threadpool &tp, u64_t begin, u64_t end, u64_t grain, void * acc, u32_t accSz,
+						  osa_reduceFunc fn, osa_joinFunc join, void * arg);
+
+
+/********************************************************
+* 		L O G G I N G
+*********************************************************/
+
+/* An osa_logX() call does not format anything on the calling thread. It writes a binary record: the id of the format (each call
+   site registers its format once, so the format must be a string literal), a timestamp and the raw arguments (%s arguments are
+   copied).
+
+   Until osa_logAsyncStart() is called, the record is formatted and written right away by the calling thread.
+   After it, each thread appends its records to its own ring buffer (single producer, single consumer, no locks) and a
+   background thread formats and writes them out. When a ring is full the record is dropped and counted. The caller never blocks.
+   The number of dropped records is reported in the log.
+
+   With OSA_LOG_BINARY the background thread writes the records as they are, without formatting them. Each format is written
+   once per file, the first time it is used. Use tools/osa_logdecode to turn such a file into text */
+
+#define OSA_LOG_RING_SZ		65536	/* Per thread ring buffer of the async backend, in bytes (power of 2) */
+#define OSA_LOG_REC_MAX		2048	/* Max size of one record. Arguments that do not fit are logged as <?> */
+#define OSA_LOG_STR_MAX		256		/* %s arguments are cut to this many bytes */
+#define OSA_LOG_FLUSH_US	1000	/* The background thread sleeps this long when all the rings are empty */
+#define OSA_LOG_FMT_MAX		4096	/* Max number of osa_logX call sites (formats) in the process */
+
+/* osa_logFormat_e : What osa_logAsyncStart() writes to its file */
+typedef enum
+{
+	OSA_LOG_TEXT, 		/* Formatted lines */
+	OSA_LOG_BINARY, 	/* Binary records. Check tools/osa_logdecode.cc */
+}osa_logFormat_e;
+
+/* Type of an argument in a record. Each argument is a one byte tag followed by 8 bytes of value.
+   OSA_LOGARG_STR is followed by a 2 byte length and the characters instead */
+typedef enum
+{
+	OSA_LOGARG_I32,
+	OSA_LOGARG_U32,
+	OSA_LOGARG_I64,
+	OSA_LOGARG_U64,
+	OSA_LOGARG_DBL,
+	OSA_LOGARG_PTR,
+	OSA_LOGARG_STR,
+}osa_logArg_e;
+
+/* osa_logAsyncStart : Start the background thread. Records are written to 'out' (stdout if NULL) as text or binary.
+					   'out' must stay open till osa_logAsyncStop() */
+ret_e osa_logAsyncStart(osa_fileHd_t * out, osa_logFormat_e format = OSA_LOG_TEXT);
+
+/* osa_logAsyncStop : Write out everything logged so far and stop the background thread. Logging becomes synchronous again */
+ret_e osa_logAsyncStop();
+
+/* osa_logBegin/osa_logEnd : Used by osa_logWrite(). osa_logBegin() returns where the arguments go (NULL to drop the record)
+							 and sets 'end' to the end of the space. osa_logEnd() gets the pointer past the last argument */
+u8_t * osa_logBegin(int level, u32_t fmtId, u8_t *&end);
+void osa_logEnd(u8_t * argEnd);
+
+inline void osa_logArgRaw(u8_t *&p, u8_t * end, osa_logArg_e tag, u64_t val)
+{
+	if(end - p < 9)
+	{
+		p = end;
+		return;
+	}
+	*p++ = (u8_t)tag;
+	memcpy(p, &val, 8);
+	p += 8;
+}
+
+inline void osa_logArgStr(u8_t *&p, u8_t * end, const char * str, size_t maxLen)
+{
+	size_t len;
+
+	if(NULL == str)
+		str = "(null)";
+	if(end - p < 3)
+	{
+		p = end;
+		return;
+	}
+
+	len = strnlen(str, maxLen);
+	if(len > (size_t)(end - p - 3))
+		len = end - p - 3;
+
+	*p++ = OSA_LOGARG_STR;
+	*p++ = len & 0xff;
+	*p++ = len >> 8;
+	memcpy(p, str, len);
+	p += len;
+}
+
+inline void osa_logArgPut(u8_t *&p, u8_t * end, const char * str)
+{
+	osa_logArgStr(p, end, str, OSA_LOG_STR_MAX);
+}
+
+inline void osa_logArgPut(u8_t *&p, u8_t * end, char * str)
+{
+	osa_logArgStr(p, end, str, OSA_LOG_STR_MAX);
+}
+
+template<typename T, bool isEnum = std::is_enum<T>::value> struct osa_logArgInt { typedef T type; };
+template<typename T> struct osa_logArgInt<T, true> { typedef typename std::underlying_type<T>::type type; };
+
+template<typename T>
+inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+osa_logArgPut(u8_t *&p, u8_t * end, T val)
+{
+	typedef typename osa_logArgInt<T>::type I;
+
+	if(std::is_signed<I>::value)
+		osa_logArgRaw(p, end, sizeof(I) > 4 ? OSA_LOGARG_I64 : OSA_LOGARG_I32, (u64_t)(i64_t)(I)val);
+	else
+		osa_logArgRaw(p, end, sizeof(I) > 4 ? OSA_LOGARG_U64 : OSA_LOGARG_U32, (u64_t)(I)val);
+}
+
+template<typename T>
+inline typename std::enable_if<std::is_floating_point<T>::value>::type
+osa_logArgPut(u8_t *&p, u8_t * end, T val)
+{
+	double d = val;
+	u64_t bits;
+
+	memcpy(&bits, &d, 8);
+	osa_logArgRaw(p, end, OSA_LOGARG_DBL, bits);
+}
+
+template<typename T>
+inline typename std::enable_if<std::is_pointer<T>::value>::type
+osa_logArgPut(u8_t *&p, u8_t * end, T val)
+{
+	osa_logArgRaw(p, end, OSA_LOGARG_PTR, (u64_t)(uintptr_t)val);
+}
+
+inline void osa_logArgsPut(u8_t *&, u8_t *)
+{
+}
+
+template<typename T, typename... Rest>
+inline void osa_logArgsPut(u8_t *&p, u8_t * end, T val, Rest... rest)
+{
+	osa_logArgPut(p, end, val);
+	osa_logArgsPut(p, end, rest...);
+}
+
+/* osa_logWrite : Body of the osa_logX macros. Level filtering is done by the macro. The format string is only there because it comes
+				  with the arguments. The record refers to it by 'fmtId' */
+template<typename... Args>
+inline void osa_logWrite(int level, u32_t fmtId, const char *, Args... args)
+{
+	u8_t * end = NULL;
+	u8_t * p = osa_logBegin(level, fmtId, end);
+
+	if(NULL == p)
+		return;
+
+	osa_logArgsPut(p, end, args...);
+	osa_logEnd(p);
+}
+
+
 
 
 
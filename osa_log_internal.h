@@ -0,0 +1,65 @@
+#ifndef __O_S_ABS_LOG_INTERNAL__
+#define __O_S_ABS_LOG_INTERNAL__
+
+/* Log record layout shared by the logging backends. Not part of the public API */
+
+#ifdef __linux__
+#include <cstdint>  /* for cpp;  In case you are using c, the parallel header is stdint.h */
+#endif
+
+#ifdef _WIN32
+
+#endif
+
+#define OSA_LOG_LINE_SZ		1024	/* Max length of one formatted log line */
+
+/* A record is this header followed by argSz bytes of arguments (check osa_logArg_e). 'size' covers both, rounded up to 8 */
+typedef struct osa_logRec_t
+{
+	u32_t size;
+	u8_t level;
+	u8_t isPad; 		/* Filler up to the end of a ring buffer. Only 'size' is valid */
+	u16_t argSz;
+	u32_t fmtId; 		/* Check osa_logRegister() */
+	i32_t tid;
+	u64_t ts; 			/* Nano seconds since the epoch */
+}osa_logRec_t;
+
+/* Binary log file (OSA_LOG_BINARY). 'var' is an unsigned LEB128 varint, 'zvar' a zigzag encoded signed varint.
+	File header : OSA_LOGBIN_MAGIC (8 bytes). Written by every osa_logAsyncStart(), so it is found again in a file that
+				  was appended to. The decoder then forgets the formats and the previous timestamp
+	Then entries, each starting with a one byte osa_logBin_e:
+	OSA_LOGBIN_FMT  : var fmtId, var len, len bytes of format. Written before the first record using the format
+	OSA_LOGBIN_REC  : u8 level, var bodyLen, body (check osa_logBinEncode)
+	OSA_LOGBIN_DROP : var tid, var count. Records of the thread lost because its ring buffer was full
+*/
+#define OSA_LOGBIN_MAGIC	"OSALOG1"
+#define OSA_LOGBIN_BODY_MAX	(2 * OSA_LOG_REC_MAX) 	/* Max encoded size of a record body */
+
+typedef enum
+{
+	OSA_LOGBIN_FMT = 1,
+	OSA_LOGBIN_REC,
+	OSA_LOGBIN_DROP,
+}osa_logBin_e;
+
+/* osa_logFmt : printf() the format with arguments taken from a record. Returns the length written to 'out' (at most outSz-1).
+				Missing or unusable arguments are printed as <?> */
+int osa_logFmt(char * out, int outSz, const char * fmt, const u8_t * args, u32_t argSz);
+
+/* osa_logBinEncode : Encode a record body to 'out' (OSA_LOGBIN_BODY_MAX bytes). Returns its length.
+					  Body : var fmtId, zvar ts - prevTs, var tid, then the arguments. Each argument is its osa_logArg_e tag
+					  followed by zvar (I32, I64), var (U32, U64, PTR), 8 raw bytes (DBL) or var len + bytes (STR).
+					  'prevTs' is the timestamp of the previous record of the file (0 for the first one). It is updated */
+u32_t osa_logBinEncode(u8_t * out, const osa_logRec_t * rec, u64_t &prevTs);
+
+/* osa_logBinDecode : Reverse of osa_logBinEncode. 'rec' must have room for OSA_LOG_REC_MAX bytes of arguments after it.
+					  level is not part of the body and is left alone. Returns false if the body is corrupt */
+bool osa_logBinDecode(const u8_t * in, u32_t len, osa_logRec_t * rec, u64_t &prevTs);
+
+void osa_logVarPut(u8_t *&p, u64_t val);
+
+/* osa_logLine : Format a record as one text line: "date time.usec level tid message\n". Returns the length of the line */
+int osa_logLine(char * line, int sz, const osa_logRec_t * rec, const char * fmt);
+
+#endif
@@ -3,6 +3,8 @@
 
 #ifdef __linux__
 #include <cstdint>  /* for cpp;  In case you are using c, the parallel header is stdint.h */
+#include <sys/socket.h>
+#include <sys/uio.h>
 #endif
 
 #ifdef _WIN32
@@ -11,17 +13,36 @@
 
 typedef struct pktData_t
 {
-	void * buf;
-	i32_t len;
+	osa_iovec_t iov[OSA_SOCK_IOV_MAX]; 	/* Segments of the packet. send/sendto use only the first one */
+	i32_t iovCnt;
+	i32_t len; 							/* Total of all the segments */
 	i32_t flags;
 	bool isSendTo;
+	bool isGenAddr; 					/* sendto destination is genAddr (else binAddr) */
+	bool isZc; 							/* Sent (at least partly) with MSG_ZEROCOPY */
+	bool isFile; 						/* 'len' bytes of fileFd from fileOff (sendFile), no iov */
+	int fileFd;
+	i64_t fileOff;
+	u32_t zcId; 						/* Id of the last zero copy send call of the packet */
+	struct pktData_t * zcNext; 			/* osa_socket::zcHead list */
 	union
 	{
-		osa_sockAddrIn_t ipAddr;
+		osa_sockAddr_t binAddr; 		/* IP destinations are resolved when the packet is queued */
 		osa_sockAddrGeneric_t genAddr;
 	};
 
 }pktData_t;
 
+/* osa_pktIov : Kernel iovecs of what is left of a packet after its first 'off' bytes (linux/osa_sock.cc). 'iov' needs 
+				OSA_SOCK_IOV_MAX entries. Returns the number of iovecs filled */
+i32_t osa_pktIov(pktData_t *pkt, i32_t off, struct iovec *iov);
+
+/* osa_pktSendFile : Send what is left of a sendFile packet after its first 'off' bytes (linux/osa_sock.cc). Returns
+					 what sendfile returns. A file shorter than the packet fails with ENODATA */
+ssize_t osa_pktSendFile(int sockFd, pktData_t *pkt, i32_t off);
+
+/* osa_pktSockAddr : Destination of a sendto packet in kernel format (linux/osa_sock.cc). It points into the packet */
+struct sockaddr * osa_pktSockAddr(pktData_t *pkt, socklen_t &addrLen);
+
 
 #endif
\ No newline at end of file
@@ -0,0 +1,123 @@
+#ifndef __O_S_ABS_THREADS_INTERNAL__
+#define __O_S_ABS_THREADS_INTERNAL__
+
+/* Helpers shared by the osa synchronization primitives (queues, pools, mutexes). Not part of the public API */
+
+#ifdef __linux__
+#include <cstdint>  /* for cpp;  In case you are using c, the parallel header is stdint.h */
+#include <atomic>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#ifdef _WIN32
+
+#endif
+
+/* o_cpuRelax : Hint to the cpu that we are in a spin-wait loop. Saves power and gives the sibling hyperthread a chance */
+static inline void o_cpuRelax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+/* o_spinCount : How many times a waiter should spin before sleeping. Spinning only helps if the thread we wait for can
+				 run at the same time on another cpu. On a single cpu machine it just steals time from that thread */
+static inline int o_spinCount(int count)
+{
+	static std::atomic<int> numCpu(0);
+	int n = numCpu.load(std::memory_order_relaxed);
+
+	if(0 == n)
+	{
+		n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+		numCpu.store(n, std::memory_order_relaxed);
+	}
+
+	return (1 < n) ? count : 0;
+}
+
+/* o_futexWait : Sleep as long as '*addr' == 'val'. 
+	IN timeoutUs : Max time to sleep in micro seconds. Negative value means wait forever.
+	Returns 0 when woken up (or *addr already changed), ETIMEDOUT on timeout. Spurious wake ups are possible, caller must 
+	re-check its condition. */
+static inline int o_futexWait(void *addr, uint32_t val, int64_t timeoutUs)
+{
+	struct timespec ts, *pTs = NULL;
+
+	if(0 <= timeoutUs)
+	{
+		ts.tv_sec  = timeoutUs / 1000000;
+		ts.tv_nsec = (timeoutUs % 1000000) * 1000;
+		pTs = &ts;
+	}
+
+	if(0 != syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, pTs, NULL, 0))
+	{
+		return (ETIMEDOUT == errno) ? ETIMEDOUT : 0;
+	}
+
+	return 0;
+}
+
+/* o_futexWake : Wake up at most 'count' threads sleeping in o_futexWait() on 'addr' */
+static inline void o_futexWake(void *addr, int count)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+/* o_lock/o_unlock : Small lock for short internal critical sections (futex mutex of U. Drepper's "Futexes Are Tricky").
+					 'lk' is 0 when free, 1 when locked, 2 when locked and somebody may be sleeping on it. Unlock makes a
+					 syscall only in the last case. The locker spins for a short while before going to sleep */
+static inline void o_lock(std::atomic<uint32_t> &lk)
+{
+	uint32_t c = 0;
+
+	if(lk.compare_exchange_strong(c, 1, std::memory_order_acquire))
+		return;
+
+	for(int i = o_spinCount(100); i > 0; i--)
+	{
+		o_cpuRelax();
+		c = 0;
+		if(0 == lk.load(std::memory_order_relaxed) && lk.compare_exchange_weak(c, 1, std::memory_order_acquire))
+			return;
+	}
+
+	c = lk.exchange(2, std::memory_order_acquire);
+	while(0 != c)
+	{
+		o_futexWait(&lk, 2, -1);
+		c = lk.exchange(2, std::memory_order_acquire);
+	}
+}
+
+static inline void o_unlock(std::atomic<uint32_t> &lk)
+{
+	if(2 == lk.exchange(0, std::memory_order_release))
+		o_futexWake(&lk, 1);
+}
+
+/* o_monotonicUs : Monotonic clock in micro seconds. Used for timeouts */
+static inline int64_t o_monotonicUs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* o_monotonicNs : Same in nano seconds. Used to time short intervals such as lock waits */
+static inline int64_t o_monotonicNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#endif
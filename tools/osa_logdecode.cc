@@ -0,0 +1,115 @@
+/* osa_logdecode : Print a binary log (osa_logAsyncStart(out, OSA_LOG_BINARY)) as text, the same way OSA_LOG_TEXT would have.
+	Build : g++ -std=c++11 -I. -Ilinux tools/osa_logdecode.cc linux/osa_logfmt.cc -o osa_logdecode
+	Usage : osa_logdecode <binary log file>     ('-' reads stdin)
+	The file must come from a machine with the same byte order. Check osa_log_internal.h for the format */
+
+#include "osa.h"
+#include "osa_log_internal.h"
+#include <string.h>
+
+static bool o_read(FILE * in, void * buf, size_t len)
+{
+	return (0 == len) || (1 == fread(buf, len, 1, in));
+}
+
+static bool o_readVar(FILE * in, u64_t &val)
+{
+	int b;
+
+	val = 0;
+	for(int shift = 0; shift < 64; shift += 7)
+	{
+		if(EOF == (b = fgetc(in)))
+			return false;
+		val |= (u64_t)(b & 0x7f) << shift;
+		if(0 == (b & 0x80))
+			return true;
+	}
+	return false;
+}
+
+int main(int argc, char ** argv)
+{
+	static char * fmts[OSA_LOG_FMT_MAX];
+	static u8_t body[OSA_LOGBIN_BODY_MAX];
+	char magic[sizeof(OSA_LOGBIN_MAGIC)], line[OSA_LOG_LINE_SZ];
+	u64_t recBuf[(sizeof(osa_logRec_t) + OSA_LOG_REC_MAX) / sizeof(u64_t) + 1];
+	osa_logRec_t * rec = (osa_logRec_t *)recBuf;
+	u64_t prevTs = 0, id, len, tid, count;
+	FILE * in;
+	int type, level, n;
+	bool ok = true;
+
+	if(2 != argc)
+	{
+		fprintf(stderr, "usage: %s <binary log file>\n", argv[0]);
+		return 1;
+	}
+
+	in = (0 == strcmp(argv[1], "-")) ? stdin : fopen(argv[1], "rb");
+	if(NULL == in)
+	{
+		perror(argv[1]);
+		return 1;
+	}
+
+	if(OSA_LOGBIN_MAGIC[0] != fgetc(in))
+	{
+		fprintf(stderr, "%s: not an osa binary log\n", argv[1]);
+		return 1;
+	}
+	type = OSA_LOGBIN_MAGIC[0];
+
+	do
+	{
+		switch(type)
+		{
+			case OSA_LOGBIN_MAGIC[0]: 	/* Start of a session */
+				magic[0] = type;
+				ok = o_read(in, magic + 1, sizeof(magic) - 1) && 0 == memcmp(magic, OSA_LOGBIN_MAGIC, sizeof(magic));
+				prevTs = 0;
+				for(id = 0; id < OSA_LOG_FMT_MAX; id++)
+				{
+					free(fmts[id]);
+					fmts[id] = NULL;
+				}
+			break;
+			case OSA_LOGBIN_FMT:
+				ok = o_readVar(in, id) && o_readVar(in, len) && id < OSA_LOG_FMT_MAX && len < 0x10000;
+				if(ok)
+				{
+					free(fmts[id]);
+					fmts[id] = (char *)calloc(1, len + 1);
+					ok = (NULL != fmts[id]) && o_read(in, fmts[id], len);
+				}
+			break;
+			case OSA_LOGBIN_REC:
+				ok = (EOF != (level = fgetc(in))) && o_readVar(in, len) && len <= sizeof(body) && o_read(in, body, len)
+					&& osa_logBinDecode(body, len, rec, prevTs);
+				if(ok)
+				{
+					rec->level = level;
+					n = osa_logLine(line, sizeof(line), rec,
+								(rec->fmtId < OSA_LOG_FMT_MAX && NULL != fmts[rec->fmtId]) ? fmts[rec->fmtId] : "<unknown format>");
+					fwrite(line, 1, n, stdout);
+				}
+			break;
+			case OSA_LOGBIN_DROP:
+				ok = o_readVar(in, tid) && o_readVar(in, count);
+				if(ok)
+					printf("osa_log: thread %d dropped %u records. Its ring buffer was full\n", (i32_t)tid, (u32_t)count);
+			break;
+			default:
+				ok = false;
+			break;
+		}
+	}while(ok && EOF != (type = fgetc(in)));
+
+	if(!ok)
+	{
+		fprintf(stderr, "%s: truncated or corrupt at offset %ld\n", argv[1], ftell(in));
+		return 1;
+	}
+
+	return 0;
+}